@@ -0,0 +1,510 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Minimal CMSIS-DAP server for the OpenOCD cmsis-dap TCP backend.
+ *
+ * Speaks the packet framing of src/jtag/drivers/cmsis_dap_tcp.c and emulates
+ * an SW-DP with a single AHB-AP in front of 64 KiB of RAM at 0x20000000.
+ * There is no CPU, but the DAP is enough to exercise the backend, the
+ * request pipelining and the DAP_Transfer queue, e.g. with a mem_ap target.
+ *
+ * To compile run:
+ * gcc -Wall -O2 -o cmsis_dap_server cmsis_dap_server.c
+ *
+ * Usage:
+ * ./cmsis_dap_server [-c packet_count] [port | /path/to/unix/socket]
+ *
+ * and in OpenOCD:
+ * adapter driver cmsis-dap
+ * cmsis-dap backend tcp
+ * transport select swd
+ * swd newdap chip cpu -enable
+ * dap create chip.dap -chain-position chip.cpu
+ * target create chip.mem mem_ap -dap chip.dap -ap-num 0
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SIGNATURE		0x00504144
+#define TYPE_REQUEST	0x01
+#define TYPE_RESPONSE	0x02
+#define HEADER_SIZE		8
+#define PACKET_SIZE		1024
+
+#define RAM_BASE		0x20000000u
+#define RAM_SIZE		0x10000u
+
+#define ACK_OK			0x01
+#define ACK_FAULT		0x04
+
+#define DP_IDR			0x2ba01477u
+#define AP_IDR			0x24770011u
+
+/* CTRL/STAT */
+#define STICKYERR		(1u << 5)
+#define CDBGPWRUPREQ	(1u << 28)
+#define CSYSPWRUPREQ	(1u << 30)
+
+static unsigned int packet_count = 64;
+
+static uint8_t ram[RAM_SIZE];
+
+static struct {
+	uint32_t ctrl_stat;
+	uint32_t select;
+	uint32_t rdbuff;
+	uint32_t match_mask;
+	uint32_t csw;
+	uint32_t tar;
+} dap;
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+/* Access the memory behind the AP, returns an ACK */
+static int mem_access(uint32_t addr, unsigned int size, int is_read, uint32_t *data)
+{
+	unsigned int lane = addr & 3;
+
+	if (addr < RAM_BASE || addr - RAM_BASE + size > RAM_SIZE) {
+		dap.ctrl_stat |= STICKYERR;
+		return ACK_FAULT;
+	}
+
+	uint8_t *p = &ram[addr - RAM_BASE];
+	if (is_read) {
+		*data = 0;
+		for (unsigned int i = 0; i < size; i++)
+			*data |= (uint32_t)p[i] << (8 * (lane + i));
+	} else {
+		for (unsigned int i = 0; i < size; i++)
+			p[i] = *data >> (8 * (lane + i));
+	}
+	return ACK_OK;
+}
+
+static int ap_access(unsigned int reg, int is_read, uint32_t *data)
+{
+	/* Only AP #0 exists */
+	if (dap.select >> 24) {
+		if (is_read)
+			*data = 0;
+		return ACK_OK;
+	}
+
+	switch (reg) {
+	case 0x00:	/* CSW */
+		if (is_read)
+			*data = dap.csw | (1u << 6);	/* DeviceEn */
+		else
+			dap.csw = *data;
+		return ACK_OK;
+	case 0x04:	/* TAR */
+		if (is_read)
+			*data = dap.tar;
+		else
+			dap.tar = *data;
+		return ACK_OK;
+	case 0x0c: {	/* DRW */
+		unsigned int size = 1u << (dap.csw & 3);
+		if (size > 4)
+			size = 4;
+		int ack = mem_access(dap.tar & ~(size - 1), size, is_read, data);
+		if (ack == ACK_OK && (dap.csw >> 4 & 3))
+			dap.tar += size;
+		return ack;
+	}
+	case 0x10:	/* BD0..BD3 */
+	case 0x14:
+	case 0x18:
+	case 0x1c:
+		return mem_access((dap.tar & ~0xfu) + (reg & 0xc), 4, is_read, data);
+	case 0xfc:	/* IDR */
+		if (is_read)
+			*data = AP_IDR;
+		return ACK_OK;
+	case 0xf8:	/* BASE, no ROM table */
+		if (is_read)
+			*data = 0xffffffff;
+		return ACK_OK;
+	default:
+		if (is_read)
+			*data = 0;
+		return ACK_OK;
+	}
+}
+
+static int dp_access(unsigned int a, int is_read, uint32_t *data)
+{
+	switch (a) {
+	case 0x0:
+		if (is_read) {
+			*data = DP_IDR;
+		} else if (*data & 0x1e) {	/* ABORT, clear sticky flags */
+			dap.ctrl_stat &= ~STICKYERR;
+		}
+		return ACK_OK;
+	case 0x4:
+		if (dap.select & 0xf) {
+			if (is_read)
+				*data = 0;
+			return ACK_OK;
+		}
+		if (is_read) {
+			/* power up requests are acknowledged at once */
+			*data = dap.ctrl_stat | (dap.ctrl_stat & (CDBGPWRUPREQ | CSYSPWRUPREQ)) << 1;
+		} else {
+			dap.ctrl_stat = (*data & ~STICKYERR) | (dap.ctrl_stat & STICKYERR);
+			if (*data & STICKYERR)
+				dap.ctrl_stat &= ~STICKYERR;
+		}
+		return ACK_OK;
+	case 0x8:
+		if (is_read)
+			*data = dap.rdbuff;	/* RESEND */
+		else
+			dap.select = *data;
+		return ACK_OK;
+	default:	/* RDBUFF, TARGETSEL */
+		if (is_read)
+			*data = dap.rdbuff;
+		return ACK_OK;
+	}
+}
+
+/* One DP or AP access from a DAP_Transfer request byte */
+static int transfer(uint8_t request, uint32_t *data)
+{
+	int is_ap = request & 0x01;
+	int is_read = request & 0x02;
+	unsigned int a = request & 0x0c;
+
+	if (!is_ap)
+		return dp_access(a, is_read, data);
+
+	int ack = ap_access((dap.select & 0xf0) | a, is_read, data);
+	if (ack == ACK_OK && is_read)
+		dap.rdbuff = *data;
+	return ack;
+}
+
+static unsigned int cmd_transfer(const uint8_t *cmd, unsigned int len, uint8_t *resp)
+{
+	unsigned int count = cmd[2];
+	unsigned int in = 3, out = 3, done = 0;
+	int ack = ACK_OK;
+
+	for (; done < count && in < len; done++) {
+		uint8_t request = cmd[in++];
+		uint32_t data = 0;
+
+		if (request & 0x20) {	/* write match mask */
+			dap.match_mask = get_u32(&cmd[in]);
+			in += 4;
+			continue;
+		}
+		if (!(request & 0x02) || (request & 0x10)) {
+			data = get_u32(&cmd[in]);
+			in += 4;
+		}
+
+		uint32_t match = data;
+		ack = transfer(request, &data);
+		if (ack != ACK_OK)
+			break;
+
+		if (request & 0x10) {	/* read with value match */
+			if ((data & dap.match_mask) != match) {
+				ack |= 0x10;
+				break;
+			}
+		} else if (request & 0x02) {
+			put_u32(&resp[out], data);
+			out += 4;
+		}
+	}
+
+	resp[1] = done;
+	resp[2] = ack;
+	return out;
+}
+
+static unsigned int cmd_transfer_block(const uint8_t *cmd, unsigned int len, uint8_t *resp)
+{
+	unsigned int count = cmd[2] | cmd[3] << 8;
+	uint8_t request = cmd[4];
+	unsigned int in = 5, out = 4, done = 0;
+	int ack = ACK_OK;
+
+	for (; done < count; done++) {
+		uint32_t data = 0;
+
+		if (!(request & 0x02)) {
+			if (in + 4 > len)
+				break;
+			data = get_u32(&cmd[in]);
+			in += 4;
+		}
+
+		ack = transfer(request, &data);
+		if (ack != ACK_OK)
+			break;
+
+		if (request & 0x02) {
+			put_u32(&resp[out], data);
+			out += 4;
+		}
+	}
+
+	put_u16(&resp[1], done);
+	resp[3] = ack;
+	return out;
+}
+
+static unsigned int info_string(uint8_t *resp, const char *s)
+{
+	unsigned int len = strlen(s) + 1;
+	resp[1] = len;
+	memcpy(&resp[2], s, len);
+	return 2 + len;
+}
+
+static unsigned int cmd_info(const uint8_t *cmd, uint8_t *resp)
+{
+	switch (cmd[1]) {
+	case 0x01:
+		return info_string(resp, "OpenOCD");
+	case 0x02:
+		return info_string(resp, "CMSIS-DAP TCP server stub");
+	case 0x03:
+		return info_string(resp, "0001");
+	case 0x04:
+		return info_string(resp, "2.1.1");
+	case 0xf0:	/* capabilities: SWD */
+		resp[1] = 1;
+		resp[2] = 0x01;
+		return 3;
+	case 0xfe:
+		resp[1] = 1;
+		resp[2] = packet_count;
+		return 3;
+	case 0xff:
+		resp[1] = 2;
+		put_u16(&resp[2], PACKET_SIZE);
+		return 4;
+	default:
+		resp[1] = 0;
+		return 2;
+	}
+}
+
+static unsigned int cmd_swd_sequence(const uint8_t *cmd, unsigned int len, uint8_t *resp)
+{
+	unsigned int count = cmd[1];
+	unsigned int in = 2, out = 2;
+
+	for (unsigned int i = 0; i < count && in < len; i++) {
+		uint8_t info = cmd[in++];
+		unsigned int bytes = ((info & 0x3f) ? (info & 0x3f) : 64) + 7;
+		bytes /= 8;
+
+		if (info & 0x80) {	/* input, the line floats high */
+			memset(&resp[out], 0xff, bytes);
+			out += bytes;
+		} else {
+			in += bytes;
+		}
+	}
+
+	resp[1] = 0;
+	return out;
+}
+
+/* Handle one request, returns the response length */
+static unsigned int process(const uint8_t *cmd, unsigned int len, uint8_t *resp)
+{
+	resp[0] = cmd[0];
+	resp[1] = 0;	/* DAP_OK */
+
+	switch (cmd[0]) {
+	case 0x00:	/* DAP_Info */
+		return cmd_info(cmd, resp);
+	case 0x02:	/* DAP_Connect */
+		resp[1] = (cmd[1] == 0 || cmd[1] == 1) ? 1 : 0;
+		return 2;
+	case 0x05:	/* DAP_Transfer */
+		return cmd_transfer(cmd, len, resp);
+	case 0x06:	/* DAP_TransferBlock */
+		return cmd_transfer_block(cmd, len, resp);
+	case 0x0a:	/* DAP_ResetTarget */
+		resp[2] = 0;
+		return 3;
+	case 0x10:	/* DAP_SWJ_Pins */
+		resp[1] = 0x82;	/* nRESET and SWDIO high */
+		return 2;
+	case 0x1d:	/* DAP_SWD_Sequence */
+		return cmd_swd_sequence(cmd, len, resp);
+	case 0x01:	/* DAP_HostStatus */
+	case 0x03:	/* DAP_Disconnect */
+	case 0x04:	/* DAP_TransferConfigure */
+	case 0x08:	/* DAP_WriteABORT */
+	case 0x09:	/* DAP_Delay */
+	case 0x11:	/* DAP_SWJ_Clock */
+	case 0x12:	/* DAP_SWJ_Sequence */
+	case 0x13:	/* DAP_SWD_Configure */
+		return 2;
+	default:
+		resp[0] = 0xff;	/* DAP_Invalid */
+		return 1;
+	}
+}
+
+static int read_all(int fd, uint8_t *buf, unsigned int len)
+{
+	while (len) {
+		ssize_t n = read(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int write_all(int fd, const uint8_t *buf, unsigned int len)
+{
+	while (len) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void serve(int fd)
+{
+	static uint8_t cmd[HEADER_SIZE + 65536 + 8];
+	static uint8_t resp[HEADER_SIZE + PACKET_SIZE];
+	unsigned long requests = 0;
+
+	memset(&dap, 0, sizeof(dap));
+
+	while (read_all(fd, cmd, HEADER_SIZE) == 0) {
+		unsigned int len = cmd[4] | cmd[5] << 8;
+
+		if (get_u32(cmd) != SIGNATURE || cmd[6] != TYPE_REQUEST) {
+			fprintf(stderr, "cmsis_dap_server: bad packet header\n");
+			break;
+		}
+		if (read_all(fd, &cmd[HEADER_SIZE], len))
+			break;
+
+		memset(&cmd[HEADER_SIZE + len], 0, 8);
+		unsigned int resp_len = process(&cmd[HEADER_SIZE], len, &resp[HEADER_SIZE]);
+
+		put_u32(resp, SIGNATURE);
+		put_u16(&resp[4], resp_len);
+		resp[6] = TYPE_RESPONSE;
+		resp[7] = 0;
+		if (write_all(fd, resp, HEADER_SIZE + resp_len))
+			break;
+		requests++;
+	}
+
+	printf("cmsis_dap_server: connection closed after %lu requests\n", requests);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *where = "4441";
+	int fd;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-c") && i + 1 < argc)
+			packet_count = atoi(argv[++i]);
+		else
+			where = argv[i];
+	}
+	if (packet_count < 1 || packet_count > 255) {
+		fprintf(stderr, "cmsis_dap_server: packet count must be 1..255\n");
+		return 1;
+	}
+
+	if (where[0] >= '0' && where[0] <= '9') {
+		struct sockaddr_in addr = {
+			.sin_family = AF_INET,
+			.sin_port = htons(atoi(where)),
+			.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+		};
+		int one = 1;
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			perror("cmsis_dap_server: bind");
+			return 1;
+		}
+	} else {
+		struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+		strncpy(addr.sun_path, where, sizeof(addr.sun_path) - 1);
+		unlink(where);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			perror("cmsis_dap_server: bind");
+			return 1;
+		}
+	}
+
+	if (listen(fd, 1) < 0) {
+		perror("cmsis_dap_server: listen");
+		return 1;
+	}
+	printf("cmsis_dap_server: listening on %s, %u packets in flight\n", where, packet_count);
+
+	for (;;) {
+		int conn = accept(fd, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("cmsis_dap_server: accept");
+			return 1;
+		}
+
+		int one = 1;
+		setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		serve(conn);
+		close(conn);
+	}
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// JTAG master for the OpenOCD jtag_dpi driver.
+//
+// Drives the TAP pins from the reference DPI server in jtag_dpi_server.c.
+// Every TCK cycle takes at least three cycles of clk: set TMS/TDI with TCK
+// low, sample TDO and raise TCK, then lower TCK again. While OpenOCD has
+// nothing queued TCK stays low and the simulation keeps running.
+
+module jtag_dpi #(
+	parameter int PORT = 5555
+) (
+	input  logic clk,
+	output logic tck,
+	output logic tms,
+	output logic tdi,
+	output logic trst_n,
+	input  logic tdo
+);
+
+	import "DPI-C" function int jtag_dpi_init(input int port);
+	import "DPI-C" function int jtag_dpi_next(output byte unsigned tms,
+			output byte unsigned tdi, output byte unsigned trst, input int block);
+	import "DPI-C" function void jtag_dpi_tdo(input byte unsigned tdo);
+
+	logic pending;
+
+	initial begin
+		tck = 1'b0;
+		tms = 1'b1;
+		tdi = 1'b0;
+		trst_n = 1'b1;
+		pending = 1'b0;
+		if (jtag_dpi_init(PORT) != 0)
+			$fatal(1, "jtag_dpi: can't start the server on port %0d", PORT);
+	end
+
+	always @(posedge clk) begin
+		byte unsigned n_tms, n_tdi, n_trst;
+
+		if (tck) begin
+			tck <= 1'b0;
+		end else if (pending) begin
+			// TDO was driven on the previous falling edge
+			jtag_dpi_tdo(tdo);
+			tck <= 1'b1;
+			pending <= 1'b0;
+		end else if (jtag_dpi_next(n_tms, n_tdi, n_trst, 0) != 0) begin
+			tms <= n_tms[0];
+			tdi <= n_tdi[0];
+			trst_n <= !n_trst[0];
+			pending <= 1'b1;
+		end
+	end
+
+endmodule
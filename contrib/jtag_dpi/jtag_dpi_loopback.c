@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Loopback test server for the OpenOCD jtag_dpi driver.
+ *
+ * Runs the reference server without a simulator, with TDO wired straight to
+ * TDI: every scan captures exactly the bits it shifted in. This is enough to
+ * check both protocols end to end and to measure the driver overhead.
+ *
+ * To compile run:
+ * gcc -Wall -O2 -o jtag_dpi_loopback jtag_dpi_loopback.c jtag_dpi_server.c
+ *
+ * Usage:
+ * ./jtag_dpi_loopback [-l] [port]
+ *   -l    only speak the line protocol, like servers predating the framed one
+ *
+ * and in OpenOCD:
+ * adapter driver jtag_dpi
+ * jtag newtap loop tap -irlen 8 -ircapture 0 -irmask 0 -expected-id 0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jtag_dpi_server.h"
+
+int main(int argc, char *argv[])
+{
+	unsigned long long cycles = 0;
+	unsigned char tms, tdi, trst;
+	int port = 5555;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-l"))
+			jtag_dpi_framed_enabled = 0;
+		else
+			port = atoi(argv[i]);
+	}
+
+	if (jtag_dpi_init(port))
+		return 1;
+
+	while (!jtag_dpi_closed()) {
+		if (!jtag_dpi_next(&tms, &tdi, &trst, 1))
+			continue;
+		jtag_dpi_tdo(tdi);
+		cycles++;
+	}
+
+	printf("jtag_dpi: connection closed after %llu TCK cycles\n", cycles);
+	return 0;
+}
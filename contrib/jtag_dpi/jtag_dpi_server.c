@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Reference server for the OpenOCD jtag_dpi driver.
+ *
+ * The simulator side is a small SystemVerilog module (jtag_dpi.sv) that asks
+ * jtag_dpi_next() for the pin values of every TCK cycle and reports the
+ * sampled TDO back through jtag_dpi_tdo(). This file keeps the socket, decodes
+ * both protocols spoken by the driver and turns them into TCK cycles.
+ *
+ * Line protocol (version 1), one request at a time:
+ *   "reset\n"             pulse TRST, end in Run-Test/Idle
+ *   "ib <n>\n" <bytes>    IR scan of n bits, the captured bytes are sent back
+ *   "db <n>\n" <bytes>    same for a DR scan
+ *
+ * Framed protocol (version 2), offered by the driver with "vers 2\n" and
+ * acknowledged with "OK2\n". A batch is a sequence of records, all integers
+ * little endian:
+ *   'S' <flags:u8> <n:u32> <bytes>   scan, flags bit 0: IR, bit 1: capture
+ *   'T' <n:u32> <bytes>              n TMS bits, TDI low
+ *   'R' <n:u32>                      n cycles in Run-Test/Idle
+ *   'Z' <0:u32>                      pulse TRST, end in Run-Test/Idle
+ *   'F'                              end of batch
+ * The answer to a batch is the captured bytes of every scan with the capture
+ * flag set, in order, followed by a single 'K'.
+ *
+ * Scans always start and end in Run-Test/Idle, which is where the driver
+ * keeps the TAP between commands.
+ *
+ * Build into the simulation together with jtag_dpi.sv, or stand-alone with
+ * jtag_dpi_loopback.c for testing the driver without a simulator.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "jtag_dpi_server.h"
+
+int jtag_dpi_framed_enabled = 1;
+
+struct job {
+	struct job *next;
+	/* TMS bits clocked before the shift, LSB first */
+	unsigned int pre_tms, pre_len;
+	/* TDI bits to shift, or the TMS bits of a 'T' record */
+	uint8_t *data;
+	uint32_t len;
+	bool tms_seq;
+	/* captured TDO, NULL if the scan doesn't want it back */
+	uint8_t *tdo;
+	unsigned int post_tms, post_len;
+	uint32_t idle;
+	bool trst;
+	/* send the output and an ack once this job is reached */
+	bool ack;
+	/* progress through pre, shift, post and idle */
+	uint64_t pos;
+};
+
+static int listen_fd = -1, client_fd = -1;
+static bool framed;
+
+static struct job *head, *tail;
+
+static uint8_t *in_buf, *out_buf;
+static size_t in_len, in_size, out_len, out_size;
+
+/* where jtag_dpi_tdo() stores the bit of the current cycle */
+static uint8_t *tdo_dst;
+static uint32_t tdo_bit;
+
+static int get_bit(const uint8_t *buf, uint32_t bit)
+{
+	return (buf[bit / 8] >> (bit % 8)) & 1;
+}
+
+static void set_bit(uint8_t *buf, uint32_t bit, int value)
+{
+	if (value)
+		buf[bit / 8] |= 1 << (bit % 8);
+	else
+		buf[bit / 8] &= ~(1 << (bit % 8));
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static void *grow(void *buf, size_t *size, size_t need)
+{
+	if (need <= *size)
+		return buf;
+	size_t n = *size ? *size : 4096;
+	while (n < need)
+		n *= 2;
+	buf = realloc(buf, n);
+	if (!buf) {
+		fprintf(stderr, "jtag_dpi: out of memory\n");
+		exit(1);
+	}
+	*size = n;
+	return buf;
+}
+
+static void disconnect(void)
+{
+	if (client_fd >= 0)
+		close(client_fd);
+	client_fd = -1;
+}
+
+static void out_append(const void *data, size_t len)
+{
+	out_buf = grow(out_buf, &out_size, out_len + len);
+	memcpy(out_buf + out_len, data, len);
+	out_len += len;
+}
+
+static void out_flush(void)
+{
+	size_t done = 0;
+
+	while (client_fd >= 0 && done < out_len) {
+		ssize_t n = write(client_fd, out_buf + done, out_len - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			perror("jtag_dpi: write");
+			disconnect();
+			break;
+		}
+		done += n;
+	}
+	out_len = 0;
+}
+
+static struct job *job_new(void)
+{
+	struct job *job = calloc(1, sizeof(*job));
+	if (!job) {
+		fprintf(stderr, "jtag_dpi: out of memory\n");
+		exit(1);
+	}
+	if (tail)
+		tail->next = job;
+	else
+		head = job;
+	tail = job;
+	return job;
+}
+
+static void job_scan(bool ir, uint32_t bits, const uint8_t *tdi, bool capture)
+{
+	struct job *job = job_new();
+	size_t bytes = (bits + 7) / 8;
+
+	if (bits == 0) {
+		/* nothing to shift, stay in Run-Test/Idle */
+		return;
+	}
+
+	/* Idle -> Select-DR [-> Select-IR] -> Capture -> Shift */
+	job->pre_tms = ir ? 0x3 : 0x1;
+	job->pre_len = ir ? 4 : 3;
+	job->data = malloc(bytes);
+	memcpy(job->data, tdi, bytes);
+	job->len = bits;
+	if (capture)
+		job->tdo = calloc(1, bytes);
+	/* Exit1 -> Update -> Idle, the last shift bit leaves Shift */
+	job->post_tms = 0x1;
+	job->post_len = 2;
+}
+
+static void job_tms(uint32_t bits, const uint8_t *tms)
+{
+	struct job *job = job_new();
+	size_t bytes = (bits + 7) / 8;
+
+	job->data = malloc(bytes ? bytes : 1);
+	memcpy(job->data, tms, bytes);
+	job->len = bits;
+	job->tms_seq = true;
+}
+
+static void job_reset(void)
+{
+	struct job *job = job_new();
+
+	/* five TMS high cycles with TRST asserted, then into Run-Test/Idle */
+	job->pre_tms = 0x1f;
+	job->pre_len = 6;
+	job->trst = true;
+}
+
+/* Parse one request of the line protocol, returns the bytes consumed or 0. */
+static size_t parse_line(void)
+{
+	uint8_t *nl = memchr(in_buf, '\n', in_len);
+	char line[64];
+	unsigned int bits;
+
+	if (!nl)
+		return in_len >= sizeof(line) ? in_len : 0;
+
+	size_t len = nl - in_buf + 1;
+	snprintf(line, sizeof(line), "%.*s", (int)(len - 1), (char *)in_buf);
+
+	if (!strcmp(line, "reset")) {
+		job_reset();
+		return len;
+	}
+
+	if (!strcmp(line, "vers 2")) {
+		if (jtag_dpi_framed_enabled) {
+			out_append("OK2\n", 4);
+			out_flush();
+			framed = true;
+		}
+		return len;
+	}
+
+	if ((line[0] == 'i' || line[0] == 'd') && sscanf(line + 1, "b %u", &bits) == 1) {
+		size_t bytes = (bits + 7) / 8;
+		if (in_len < len + bytes)
+			return 0;
+		job_scan(line[0] == 'i', bits, in_buf + len, true);
+		/* the driver waits for every scan, answer it as soon as it's done */
+		tail->ack = true;
+		return len + bytes;
+	}
+
+	fprintf(stderr, "jtag_dpi: ignoring unknown request '%s'\n", line);
+	return len;
+}
+
+/* Parse one record of the framed protocol, returns the bytes consumed or 0. */
+static size_t parse_record(void)
+{
+	uint32_t n;
+	size_t bytes;
+
+	switch (in_buf[0]) {
+	case 'S':
+		if (in_len < 6)
+			return 0;
+		n = get_u32(in_buf + 2);
+		bytes = (n + 7) / 8;
+		if (in_len < 6 + bytes)
+			return 0;
+		job_scan(in_buf[1] & 1, n, in_buf + 6, in_buf[1] & 2);
+		return 6 + bytes;
+	case 'T':
+		if (in_len < 5)
+			return 0;
+		n = get_u32(in_buf + 1);
+		bytes = (n + 7) / 8;
+		if (in_len < 5 + bytes)
+			return 0;
+		job_tms(n, in_buf + 5);
+		return 5 + bytes;
+	case 'R':
+		if (in_len < 5)
+			return 0;
+		job_new()->idle = get_u32(in_buf + 1);
+		return 5;
+	case 'Z':
+		if (in_len < 5)
+			return 0;
+		job_reset();
+		return 5;
+	case 'F':
+		job_new()->ack = true;
+		return 1;
+	default:
+		fprintf(stderr, "jtag_dpi: bad record 0x%02x, dropping the connection\n", in_buf[0]);
+		disconnect();
+		return in_len;
+	}
+}
+
+static void parse(void)
+{
+	while (in_len > 0 && client_fd >= 0) {
+		size_t used = framed ? parse_record() : parse_line();
+		if (!used)
+			break;
+		memmove(in_buf, in_buf + used, in_len - used);
+		in_len -= used;
+	}
+}
+
+/* Read whatever the driver has sent, waiting for it if @wait is set. */
+static void receive(bool wait)
+{
+	struct timeval tv = { 0, 0 };
+	fd_set rfds;
+
+	if (client_fd < 0)
+		return;
+
+	FD_ZERO(&rfds);
+	FD_SET(client_fd, &rfds);
+	if (select(client_fd + 1, &rfds, NULL, NULL, wait ? NULL : &tv) <= 0)
+		return;
+
+	in_buf = grow(in_buf, &in_size, in_len + 65536);
+	ssize_t n = read(client_fd, in_buf + in_len, in_size - in_len);
+	if (n <= 0) {
+		if (n < 0)
+			perror("jtag_dpi: read");
+		disconnect();
+		return;
+	}
+	in_len += n;
+	parse();
+}
+
+static void job_done(struct job *job)
+{
+	if (job->tdo)
+		out_append(job->tdo, (job->len + 7) / 8);
+	if (job->ack) {
+		if (framed)
+			out_append("K", 1);
+		out_flush();
+	}
+
+	head = job->next;
+	if (!head)
+		tail = NULL;
+	free(job->data);
+	free(job->tdo);
+	free(job);
+}
+
+int jtag_dpi_next(unsigned char *tms, unsigned char *tdi, unsigned char *trst, int block)
+{
+	tdo_dst = NULL;
+
+	for (;;) {
+		struct job *job = head;
+
+		if (!job) {
+			if (client_fd < 0)
+				return 0;
+			receive(block);
+			if (!head && !block)
+				return 0;
+			continue;
+		}
+
+		uint64_t pos = job->pos++;
+
+		*trst = 0;
+		*tdi = 0;
+		if (pos < job->pre_len) {
+			*tms = (job->pre_tms >> pos) & 1;
+			*trst = job->trst && pos + 1 < job->pre_len;
+			return 1;
+		}
+		pos -= job->pre_len;
+
+		if (pos < job->len) {
+			if (job->tms_seq) {
+				*tms = get_bit(job->data, pos);
+			} else {
+				*tms = pos + 1 == job->len;
+				*tdi = get_bit(job->data, pos);
+				tdo_dst = job->tdo;
+				tdo_bit = pos;
+			}
+			return 1;
+		}
+		pos -= job->len;
+
+		if (pos < job->post_len) {
+			*tms = (job->post_tms >> pos) & 1;
+			return 1;
+		}
+		pos -= job->post_len;
+
+		if (pos < job->idle) {
+			*tms = 0;
+			return 1;
+		}
+
+		job_done(job);
+	}
+}
+
+void jtag_dpi_tdo(unsigned char tdo)
+{
+	if (tdo_dst)
+		set_bit(tdo_dst, tdo_bit, tdo);
+}
+
+int jtag_dpi_closed(void)
+{
+	return client_fd < 0 && !head;
+}
+
+int jtag_dpi_init(int port)
+{
+	struct sockaddr_in addr;
+	int flag = 1;
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0) {
+		perror("jtag_dpi: socket");
+		return -1;
+	}
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| listen(listen_fd, 1) < 0) {
+		perror("jtag_dpi: bind");
+		close(listen_fd);
+		return -1;
+	}
+
+	printf("jtag_dpi: waiting for OpenOCD on port %d\n", port);
+	fflush(stdout);
+	client_fd = accept(listen_fd, NULL, NULL);
+	if (client_fd < 0) {
+		perror("jtag_dpi: accept");
+		return -1;
+	}
+	setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+	printf("jtag_dpi: OpenOCD connected\n");
+
+	return 0;
+}
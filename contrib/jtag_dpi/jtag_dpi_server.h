@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Reference server for the OpenOCD jtag_dpi driver, see jtag_dpi_server.c.
+ */
+
+#ifndef JTAG_DPI_SERVER_H
+#define JTAG_DPI_SERVER_H
+
+/* Answer the framed protocol handshake, set to 0 to act as a line protocol server. */
+extern int jtag_dpi_framed_enabled;
+
+/* Listen on @port and wait for OpenOCD to connect. Returns 0 on success. */
+int jtag_dpi_init(int port);
+
+/*
+ * Fetch the pin values for the next TCK cycle. Returns 1 and fills in
+ * @tms, @tdi and @trst (active high) if a cycle has to be clocked, or 0 if
+ * OpenOCD has nothing queued. Never blocks unless @block is set.
+ */
+int jtag_dpi_next(unsigned char *tms, unsigned char *tdi, unsigned char *trst, int block);
+
+/* Report TDO as sampled on the rising TCK edge of the cycle just clocked. */
+void jtag_dpi_tdo(unsigned char tdo);
+
+/* Returns 1 once OpenOCD has disconnected. */
+int jtag_dpi_closed(void);
+
+#endif /* JTAG_DPI_SERVER_H */
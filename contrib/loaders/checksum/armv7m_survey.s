@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+	Compute the CRC32 and the erase state of an array of memory regions
+	in a single run.
+
+	parameters:
+	r0 - pointer to array of struct {
+		uint32_t address;
+		uint32_t size;			(0 terminates the array)
+		uint32_t crc_out;
+		uint32_t blank_out;		(offset of first non-erased byte, size if erased)
+	}
+	r1 - erased byte value
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+BLOCK_ADDRESS		= 0
+BLOCK_SIZE			= 4
+BLOCK_CRC			= 8
+BLOCK_BLANK			= 12
+SIZEOF_STRUCT_BLOCK	= 16
+
+start:
+block_loop:
+	ldr		r2, [r0, #BLOCK_ADDRESS]	/* current pointer */
+	ldr		r3, [r0, #BLOCK_SIZE]
+	cmp		r3, #0
+	beq		done
+	adds	r3, r2, r3					/* end pointer */
+	mov		r7, r3						/* first non-erased byte */
+	movs	r5, #0
+	mvns	r5, r5						/* crc = ~0 */
+
+byte_loop:
+	ldrb	r4, [r2]
+	cmp		r4, r1
+	beq		crc_byte
+	cmp		r7, r3
+	bne		crc_byte
+	mov		r7, r2
+
+crc_byte:
+	lsls	r4, r4, #24
+	eors	r5, r5, r4
+	movs	r6, #8
+	ldr		r4, CRC32XOR
+bit_loop:
+	lsls	r5, r5, #1
+	bcc		no_xor
+	eors	r5, r5, r4
+no_xor:
+	subs	r6, r6, #1
+	bne		bit_loop
+
+	adds	r2, r2, #1
+	cmp		r2, r3
+	bne		byte_loop
+
+	str		r5, [r0, #BLOCK_CRC]
+	ldr		r4, [r0, #BLOCK_ADDRESS]
+	subs	r7, r7, r4
+	str		r7, [r0, #BLOCK_BLANK]
+	adds	r0, r0, #SIZEOF_STRUCT_BLOCK
+	b		block_loop
+
+done:
+	bkpt	#0
+
+	.align	2
+
+CRC32XOR:	.word	0x04c11db7
+
+	.end
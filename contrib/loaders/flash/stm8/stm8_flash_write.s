@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+;;
+;; stm8 flash/eeprom block programming loader
+;;
+;; Blocks are streamed by OpenOCD into a double buffer in RAM while this
+;; code programs the other half. OpenOCD fills buf0/buf1 alternately and
+;; increments wp; the loader programs block rp from buf[rp & 1], waits for
+;; EOP and increments rp. The loader stops at the break instruction once
+;; rp == wp and done is set, or when a block failed (status = IAPSR).
+;;
+ .org 0x0
+;; parameter block, SP must point to iapsr on entry
+ iapsr: .word 0x505f
+ cr2: .word 0x505b	;0 if there is no FLASH_CR2
+ ncr2: .word 0x505c	;0 if there is no FLASH_NCR2
+ cr2_val: .byte 0x01	;PRG
+ ncr2_val: .byte 0xfe
+ block_size: .byte 0x80
+;; flash address of block rp, OpenOCD patches the ldf below to point here
+ dest: .byte 0x00
+       .word 0x8000
+ buf0: .word 0x0000
+ buf1: .word 0x0000
+ wp: .byte 0x00
+ rp: .byte 0x00
+ done: .byte 0x00
+ status: .byte 0x00
+;
+start:
+	sim
+;
+; wait for the next block, or for the end of the stream
+.wait:
+	ld A,(rp,SP)
+	cp A,(wp,SP)
+	jrne .program
+	tnz (done,SP)
+	jreq .wait
+	jra .exit
+;
+; select the buffer half of block rp
+.program:
+	ldw Y,(buf0,SP)
+	bcp A,#0x01
+	jreq .cr2
+	ldw Y,(buf1,SP)
+;
+; enable block programming
+.cr2:
+	ldw X,(cr2,SP)
+	tnzw X
+	jreq .ncr2
+	ld A,(cr2_val,SP)
+	ld (X),A
+.ncr2:
+	ldw X,(ncr2,SP)
+	tnzw X
+	jreq .fill
+	ld A,(ncr2_val,SP)
+	ld (X),A
+;
+; write the whole block
+.fill:
+	clrw X
+.copy:
+	ld A,(Y)
+.ldf:
+	ldf ([dest.e],X),A
+	incw Y
+	incw X
+	ld A,XL
+	cp A,(block_size,SP)
+	jrne .copy
+;
+; wait for end of programming (EOP) or write protection (WR_PG_DIS)
+	ldw X,(iapsr,SP)
+.eop:
+	ld A,(X)
+	bcp A,#0x05
+	jreq .eop
+	bcp A,#0x01
+	jrne .fail
+;
+; advance dest to the next block
+	ld A,(dest+2,SP)
+	add A,(block_size,SP)
+	ld (dest+2,SP),A
+	ld A,(dest+1,SP)
+	adc A,#0x00
+	ld (dest+1,SP),A
+	ld A,(dest,SP)
+	adc A,#0x00
+	ld (dest,SP),A
+	inc (rp,SP)
+	jra .wait
+;
+.fail:
+	ld (status,SP),A
+.exit:
+	break
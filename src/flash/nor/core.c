@@ -26,11 +26,34 @@
 
 static struct flash_bank *flash_banks;
 
+/**
+ * Sector-granular write-combining cache of a flash bank.
+ * Writes are applied to host copies of the sectors and every modified
+ * sector is erased and programmed once, when the cache is synced.
+ */
+struct flash_write_cache {
+	/** Number of sectors the arrays were allocated for */
+	unsigned int num_sectors;
+	/** Host copy of each sector, NULL if the sector is not cached */
+	uint8_t **data;
+	/** Sector was erased by us and nothing programmed it since, so a cached
+	 * write starts from erased_value and the sync skips the erase. Only
+	 * valid until the target runs or anything else writes the flash. */
+	bool *erased;
+	/** Set while the cache commits, writes go to the driver directly */
+	bool syncing;
+};
+
+static void flash_write_cache_invalidate(struct flash_bank *bank,
+		unsigned int first, unsigned int last);
+
 int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
 	int retval;
 
+	flash_write_cache_invalidate(bank, first, last);
+
 	retval = bank->driver->erase(bank, first, last);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed erasing sectors %u to %u", first, last);
@@ -82,11 +105,19 @@ int flash_driver_protect(struct flash_bank *bank, int set, unsigned int first,
 	return retval;
 }
 
+static int flash_write_cache_write(struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t count);
+static bool flash_write_cache_overlay(struct flash_bank *bank,
+	uint8_t *buffer, uint32_t offset, uint32_t count);
+
 int flash_driver_write(struct flash_bank *bank,
 	const uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	int retval;
 
+	if (bank->write_cache && !bank->write_cache->syncing)
+		return flash_write_cache_write(bank, buffer, offset, count);
+
 	retval = bank->driver->write(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
@@ -113,8 +144,12 @@ int flash_driver_read(struct flash_bank *bank,
 			" at offset 0x%8.8" PRIx32,
 			bank->base,
 			offset);
+		return retval;
 	}
 
+	/* Pending data in the write cache are newer than the flash content */
+	flash_write_cache_overlay(bank, buffer, offset, count);
+
 	return retval;
 }
 
@@ -129,6 +164,11 @@ int flash_driver_verify(struct flash_bank *bank,
 {
 	int retval;
 
+	/* Verify the flash content, not the pending data */
+	retval = flash_write_cache_sync(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
 	retval = bank->driver->verify ? bank->driver->verify(bank, buffer, offset, count) :
 		default_flash_verify(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
@@ -161,6 +201,311 @@ int default_flash_verify(struct flash_bank *bank,
 		return ERROR_FAIL;
 }
 
+static void flash_write_cache_free_data(struct flash_write_cache *cache)
+{
+	if (cache->data) {
+		for (unsigned int i = 0; i < cache->num_sectors; i++)
+			free(cache->data[i]);
+	}
+	free(cache->data);
+	free(cache->erased);
+	cache->data = NULL;
+	cache->erased = NULL;
+	cache->num_sectors = 0;
+}
+
+static void flash_write_cache_clear_erased(struct flash_write_cache *cache)
+{
+	if (cache->erased)
+		memset(cache->erased, 0, cache->num_sectors * sizeof(*cache->erased));
+}
+
+void flash_write_cache_forget_erased(struct flash_bank *bank)
+{
+	if (bank->write_cache)
+		flash_write_cache_clear_erased(bank->write_cache);
+}
+
+static bool flash_write_cache_is_dirty(struct flash_write_cache *cache)
+{
+	for (unsigned int i = 0; cache->data && i < cache->num_sectors; i++) {
+		if (cache->data[i])
+			return true;
+	}
+	return false;
+}
+
+/* Erase makes the pending data of the sectors obsolete */
+static void flash_write_cache_invalidate(struct flash_bank *bank,
+		unsigned int first, unsigned int last)
+{
+	struct flash_write_cache *cache = bank->write_cache;
+	if (!cache || cache->syncing || !cache->data)
+		return;
+
+	for (unsigned int i = first; i <= last && i < cache->num_sectors; i++) {
+		free(cache->data[i]);
+		cache->data[i] = NULL;
+		cache->erased[i] = true;
+	}
+}
+
+static int flash_write_cache_write(struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	struct flash_write_cache *cache = bank->write_cache;
+	int retval;
+
+	if (cache->num_sectors != bank->num_sectors) {
+		/* Bank was (re)probed, commit what was cached with the old geometry */
+		retval = flash_write_cache_sync(bank);
+		if (retval != ERROR_OK)
+			return retval;
+
+		flash_write_cache_free_data(cache);
+		cache->data = calloc(bank->num_sectors, sizeof(*cache->data));
+		cache->erased = calloc(bank->num_sectors, sizeof(*cache->erased));
+		if (!cache->data || !cache->erased) {
+			flash_write_cache_free_data(cache);
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		cache->num_sectors = bank->num_sectors;
+	}
+
+	for (unsigned int i = 0; i < cache->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		uint32_t start = MAX(offset, sector->offset);
+		uint32_t end = MIN(offset + count, sector->offset + sector->size);
+		if (start >= end)
+			continue;
+
+		if (!cache->data[i]) {
+			uint8_t *data = malloc(sector->size);
+			if (!data) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+
+			if (cache->erased[i]) {
+				memset(data, bank->erased_value, sector->size);
+			} else {
+				retval = flash_driver_read(bank, data, sector->offset, sector->size);
+				if (retval != ERROR_OK) {
+					free(data);
+					return retval;
+				}
+			}
+			cache->data[i] = data;
+		}
+
+		memcpy(cache->data[i] + start - sector->offset, buffer + start - offset,
+			end - start);
+	}
+
+	return ERROR_OK;
+}
+
+int flash_write_cache_sync(struct flash_bank *bank)
+{
+	struct flash_write_cache *cache = bank->write_cache;
+	int retval = ERROR_OK;
+
+	if (!cache || cache->syncing)
+		return ERROR_OK;
+
+	if (!flash_write_cache_is_dirty(cache)) {
+		flash_write_cache_clear_erased(cache);
+		return ERROR_OK;
+	}
+
+	cache->syncing = true;
+
+	for (unsigned int i = 0; i < cache->num_sectors; i++) {
+		if (!cache->data[i])
+			continue;
+
+		struct flash_sector *sector = &bank->sectors[i];
+		LOG_DEBUG("flash %s: committing sector %u", bank->name, i);
+
+		if (!cache->erased[i]) {
+			retval = flash_driver_erase(bank, i, i);
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		retval = flash_driver_write(bank, cache->data[i], sector->offset, sector->size);
+		if (retval != ERROR_OK)
+			break;
+
+		free(cache->data[i]);
+		cache->data[i] = NULL;
+	}
+
+	cache->syncing = false;
+	flash_write_cache_clear_erased(cache);
+
+	return retval;
+}
+
+/* Copies the pending data of the cached sectors within the given range of
+ * the bank into buffer, returns true if there were any */
+static bool flash_write_cache_overlay(struct flash_bank *bank,
+	uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	struct flash_write_cache *cache = bank->write_cache;
+	bool pending = false;
+
+	if (!cache || !cache->data)
+		return false;
+
+	for (unsigned int i = 0; i < cache->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (!cache->data[i])
+			continue;
+
+		uint32_t start = MAX(offset, sector->offset);
+		uint32_t end = MIN(offset + count, sector->offset + sector->size);
+		if (start >= end)
+			continue;
+
+		if (buffer)
+			memcpy(buffer + start - offset,
+				cache->data[i] + start - sector->offset, end - start);
+		pending = true;
+	}
+
+	return pending;
+}
+
+/* Clips a target address range to the bank, false if they don't overlap */
+static bool flash_write_cache_clip(struct flash_bank *bank, target_addr_t address,
+	uint32_t count, uint32_t *offset, uint32_t *size)
+{
+	if (!count || address >= bank->base + bank->size || address + count <= bank->base)
+		return false;
+
+	target_addr_t start = MAX(address, bank->base);
+	target_addr_t end = MIN(address + count, bank->base + bank->size);
+	*offset = start - bank->base;
+	*size = end - start;
+	return true;
+}
+
+void flash_write_cache_read_pending(struct target *target, target_addr_t address,
+	uint32_t count, uint8_t *buffer)
+{
+	for (struct flash_bank *bank = flash_banks; bank; bank = bank->next) {
+		uint32_t offset, size;
+
+		if (bank->target != target ||
+				!flash_write_cache_clip(bank, address, count, &offset, &size))
+			continue;
+
+		flash_write_cache_overlay(bank, buffer + (bank->base + offset - address),
+			offset, size);
+	}
+}
+
+int flash_write_cache_sync_range(struct target *target, target_addr_t address,
+	uint32_t count)
+{
+	int retval = ERROR_OK;
+
+	for (struct flash_bank *bank = flash_banks; bank; bank = bank->next) {
+		uint32_t offset, size;
+
+		if (bank->target != target ||
+				!flash_write_cache_clip(bank, address, count, &offset, &size) ||
+				!flash_write_cache_overlay(bank, NULL, offset, size))
+			continue;
+
+		int retval1 = flash_write_cache_sync(bank);
+		if (retval == ERROR_OK)
+			retval = retval1;
+	}
+
+	return retval;
+}
+
+int flash_write_cache_sync_all(struct target *target)
+{
+	int retval = ERROR_OK;
+
+	for (struct flash_bank *bank = flash_banks; bank; bank = bank->next) {
+		if (target && bank->target != target)
+			continue;
+
+		int retval1 = flash_write_cache_sync(bank);
+		if (retval == ERROR_OK)
+			retval = retval1;
+	}
+
+	return retval;
+}
+
+static int flash_write_cache_event_handler(struct target *target,
+		enum target_event event, void *priv)
+{
+	struct flash_bank *bank = priv;
+
+	if (target != bank->target)
+		return ERROR_OK;
+
+	switch (event) {
+	case TARGET_EVENT_RESUME_START:
+		/* Flash algorithms resume the target too */
+		if (target->running_alg)
+			break;
+		/* fall through */
+	case TARGET_EVENT_GDB_DETACH:
+		if (flash_write_cache_sync(bank) != ERROR_OK)
+			LOG_ERROR("flash %s: failed to commit the write cache", bank->name);
+		break;
+	case TARGET_EVENT_HALTED:
+		/* The target may have programmed the flash while it ran */
+		if (!target->running_alg)
+			flash_write_cache_forget_erased(bank);
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+int flash_write_cache_enable(struct flash_bank *bank, bool enable)
+{
+	struct flash_write_cache *cache = bank->write_cache;
+
+	if (enable) {
+		if (cache)
+			return ERROR_OK;
+
+		cache = calloc(1, sizeof(*cache));
+		if (!cache) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		bank->write_cache = cache;
+		return target_register_event_callback(flash_write_cache_event_handler, bank);
+	}
+
+	if (!cache)
+		return ERROR_OK;
+
+	int retval = flash_write_cache_sync(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	target_unregister_event_callback(flash_write_cache_event_handler, bank);
+	flash_write_cache_free_data(cache);
+	free(cache);
+	bank->write_cache = NULL;
+
+	return ERROR_OK;
+}
+
 void flash_bank_add(struct flash_bank *bank)
 {
 	/* put flash bank in linked list */
@@ -218,6 +563,15 @@ void flash_free_all_banks(void)
 	struct flash_bank *bank = flash_banks;
 	while (bank) {
 		struct flash_bank *next = bank->next;
+
+		if (bank->write_cache) {
+			if (flash_write_cache_is_dirty(bank->write_cache))
+				LOG_WARNING("flash %s: discarding data pending in the write cache", bank->name);
+			target_unregister_event_callback(flash_write_cache_event_handler, bank);
+			flash_write_cache_free_data(bank->write_cache);
+			free(bank->write_cache);
+		}
+
 		if (bank->driver->free_driver_priv)
 			bank->driver->free_driver_priv(bank);
 		else
@@ -19,6 +19,7 @@
  */
 
 struct image;
+struct flash_write_cache;
 
 /**
  * Describes the geometry and status of a single flash sector
@@ -125,6 +126,9 @@ struct flash_bank {
 	/** Array of protection blocks, allocated and initialized by the flash driver */
 	struct flash_sector *prot_blocks;
 
+	/** Sector-granular write-combining cache, NULL if disabled */
+	struct flash_write_cache *write_cache;
+
 	struct flash_bank *next; /**< The next flash bank on this chip */
 };
 
@@ -144,6 +148,49 @@ int flash_erase_address_range(struct target *target,
 int flash_unlock_address_range(struct target *target, target_addr_t addr,
 		uint32_t length);
 
+/**
+ * Enables or disables the write-combining cache of @a bank.
+ * While enabled, flash writes are collected per sector in host memory.
+ * Disabling the cache commits the pending data first.
+ * @returns ERROR_OK if successful; otherwise, an error code.
+ */
+int flash_write_cache_enable(struct flash_bank *bank, bool enable);
+
+/**
+ * Erases and programs every sector modified in the write cache of @a bank.
+ * The cache is also committed automatically at resume and at GDB detach.
+ * @returns ERROR_OK if successful; otherwise, an error code.
+ */
+int flash_write_cache_sync(struct flash_bank *bank);
+
+/**
+ * Commits the write caches of all banks of @a target, or of all banks
+ * if @a target is NULL.
+ * @returns ERROR_OK if successful; otherwise, the first error code.
+ */
+int flash_write_cache_sync_all(struct target *target);
+
+/**
+ * Overlays the data pending in the write caches of the banks of @a target
+ * on @a buffer, which holds @a count bytes read from @a address.
+ */
+void flash_write_cache_read_pending(struct target *target, target_addr_t address,
+		uint32_t count, uint8_t *buffer);
+
+/**
+ * Commits the write caches of the banks of @a target that hold pending
+ * data within @a count bytes from @a address.
+ * @returns ERROR_OK if successful; otherwise, the first error code.
+ */
+int flash_write_cache_sync_range(struct target *target, target_addr_t address,
+		uint32_t count);
+
+/**
+ * Tells the write cache of @a bank that its flash was programmed without
+ * going through the cache, so no sector can be assumed erased anymore.
+ */
+void flash_write_cache_forget_erased(struct flash_bank *bank);
+
 /**
  * Align start address of a flash write region according to bank requirements.
  * @param bank Pointer to bank descriptor structure
@@ -1073,6 +1073,47 @@ COMMAND_HANDLER(handle_flash_padded_value_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_flash_write_cache_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank_probe_optional, 0, &p, false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC == 2) {
+		bool enable;
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[1], enable);
+
+		retval = flash_write_cache_enable(p, enable);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	command_print(CMD, "write cache of flash bank %u is %s",
+			p->bank_number, p->write_cache ? "on" : "off");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_flash_sync_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0)
+		return flash_write_cache_sync_all(NULL);
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank_probe_optional, 0, &p, false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return flash_write_cache_sync(p);
+}
+
 static const struct command_registration flash_exec_command_handlers[] = {
 	{
 		.name = "probe",
@@ -1229,6 +1270,23 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.usage = "bank_id value",
 		.help = "Set default flash padded value",
 	},
+	{
+		.name = "write_cache",
+		.handler = handle_flash_write_cache_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['on'|'off']",
+		.help = "Display or set the write-combining cache of a flash bank. "
+			"Cached sectors are erased and programmed once, on 'flash sync', "
+			"at resume or at GDB detach.",
+	},
+	{
+		.name = "sync",
+		.handler = handle_flash_sync_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[bank_id]",
+		.help = "Commit the sectors pending in the write cache of a flash "
+			"bank, or of all flash banks.",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
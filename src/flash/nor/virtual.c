@@ -117,6 +117,7 @@ static int virtual_write(struct flash_bank *bank, const uint8_t *buffer,
 
 	/* call master handler */
 	retval = master_bank->driver->write(master_bank, buffer, offset, count);
+	flash_write_cache_forget_erased(master_bank);
 	if (retval != ERROR_OK)
 		return retval;
 
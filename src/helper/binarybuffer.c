@@ -16,6 +16,10 @@
 #include "log.h"
 #include "binarybuffer.h"
 
+#ifdef HAVE_STRINGS_H
+#include <strings.h>
+#endif
+
 static const unsigned char bit_reverse_table256[] = {
 	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
 	0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
@@ -84,22 +88,47 @@ bool buf_eq(const void *_buf1, const void *_buf2, unsigned int size)
 	return buf_eq_trailing(buf1[last], buf2[last], 0xff, trailing);
 }
 
-bool buf_eq_mask(const void *_buf1, const void *_buf2,
+unsigned int buf_find_mask_mismatch(const void *_buf1, const void *_buf2,
 	const void *_mask, unsigned int size)
 {
-	if (!_buf1 || !_buf2)
-		return _buf1 == _buf2 && _buf1 == _mask;
-
 	const uint8_t *buf1 = _buf1, *buf2 = _buf2, *mask = _mask;
 	unsigned int last = size / 8;
-	for (unsigned int i = 0; i < last; i++) {
-		if (!buf_eq_masked(buf1[i], buf2[i], mask[i]))
-			return false;
+	unsigned int i = 0;
+
+	/* skip matching data a word at a time */
+	for (; i + sizeof(uint64_t) <= last; i += sizeof(uint64_t)) {
+		uint64_t a, b, m;
+
+		memcpy(&a, buf1 + i, sizeof(a));
+		memcpy(&b, buf2 + i, sizeof(b));
+		memcpy(&m, mask + i, sizeof(m));
+		if ((a ^ b) & m)
+			break;
+	}
+
+	for (; i < last; i++) {
+		uint8_t diff = (buf1[i] ^ buf2[i]) & mask[i];
+		if (diff)
+			return i * 8 + ffs(diff) - 1;
 	}
+
 	unsigned int trailing = size % 8;
-	if (!trailing)
-		return true;
-	return buf_eq_trailing(buf1[last], buf2[last], mask[last], trailing);
+	if (trailing) {
+		uint8_t diff = (buf1[last] ^ buf2[last]) & mask[last] & ((1 << trailing) - 1);
+		if (diff)
+			return last * 8 + ffs(diff) - 1;
+	}
+
+	return size;
+}
+
+bool buf_eq_mask(const void *_buf1, const void *_buf2,
+	const void *_mask, unsigned int size)
+{
+	if (!_buf1 || !_buf2)
+		return _buf1 == _buf2 && _buf1 == _mask;
+
+	return buf_find_mask_mismatch(_buf1, _buf2, _mask, size) == size;
 }
 
 void *buf_set_ones(void *_buf, unsigned int size)
@@ -138,8 +167,16 @@ void *buf_set_buf(const void *_src, unsigned int src_start,
 	 * len is a multiple of 8bit so we can simple copy
 	 * the buffer */
 	if ((sq == 0) && (dq == 0) &&  (lq == 0)) {
-		for (i = 0; i < lb; i++)
-			*dst++ = *src++;
+		memcpy(dst, src, lb);
+		return _dst;
+	}
+
+	/* byte aligned with trailing bits: copy whole bytes, then merge the rest */
+	if ((sq == 0) && (dq == 0)) {
+		uint8_t mask = (1 << lq) - 1;
+
+		memcpy(dst, src, lb);
+		dst[lb] = (dst[lb] & ~mask) | (src[lb] & mask);
 		return _dst;
 	}
 
@@ -176,6 +176,19 @@ bool buf_eq(const void *buf1, const void *buf2, unsigned int size);
 bool buf_eq_mask(const void *buf1, const void *buf2,
 		const void *mask, unsigned int size);
 
+/**
+ * Find the first bit where two buffers differ, considering only the bits
+ * set in @c mask.
+ * @param buf1 The first buffer.
+ * @param buf2 The second buffer.
+ * @param mask The buffer selecting the bits to compare.
+ * @param size The number of bits to compare.
+ * @returns The index of the first mismatching bit, or @c size if the
+ * buffers are equal under the mask.
+ */
+unsigned int buf_find_mask_mismatch(const void *buf1, const void *buf2,
+		const void *mask, unsigned int size);
+
 /**
  * Copies @c size bits out of @c from and into @c to.  Any extra
  * bits in the final byte will be set to zero.
@@ -17,6 +17,7 @@
 #include "interface.h"
 #include "interfaces.h"
 #include <transport/transport.h>
+#include <helper/time_support.h>
 
 /**
  * @file
@@ -34,6 +35,13 @@ enum adapter_clk_mode {
 
 #define DEFAULT_CLOCK_SPEED_KHZ		100U
 
+/* "adapter speed auto" tuning parameters */
+#define AUTO_SPEED_DEFAULT_MAX_KHZ	30000U
+#define AUTO_SPEED_TEST_PASSES		8
+#define AUTO_SPEED_MARGIN_PCT		80U
+#define AUTO_SPEED_ERROR_LIMIT		3
+#define AUTO_SPEED_ERROR_WINDOW_MS	1000
+
 /**
  * Adapter configuration
  */
@@ -44,6 +52,15 @@ static struct {
 	enum adapter_clk_mode clock_mode;
 	int speed_khz;
 	int rclk_fallback_speed_khz;
+	struct {
+		bool enabled;
+		bool tuned;
+		bool busy;
+		unsigned int min_khz;
+		unsigned int max_khz;
+		unsigned int errors;
+		int64_t window_start;
+	} auto_speed;
 	struct adapter_gpio_config gpios[ADAPTER_GPIO_IDX_NUM];
 	bool gpios_initialized; /* Initialization of GPIOs to their unset values performed at run time */
 } adapter_config;
@@ -298,6 +315,108 @@ int adapter_get_speed_readable(int *khz)
 	return adapter_driver->speed_div(speed_var, khz);
 }
 
+bool adapter_speed_is_auto(void)
+{
+	return adapter_config.auto_speed.enabled && adapter_driver
+		&& adapter_driver->speed && adapter_driver->khz;
+}
+
+static bool adapter_speed_test_passes(adapter_speed_test_fn test, void *priv,
+		unsigned int khz)
+{
+	if (adapter_config_khz(khz) != ERROR_OK)
+		return false;
+
+	for (unsigned int i = 0; i < AUTO_SPEED_TEST_PASSES; i++) {
+		if (test(priv) != ERROR_OK) {
+			LOG_DEBUG("adapter speed auto: %u kHz fails on pass %u", khz, i);
+			return false;
+		}
+	}
+
+	LOG_DEBUG("adapter speed auto: %u kHz passes", khz);
+	return true;
+}
+
+int adapter_speed_autotune(adapter_speed_test_fn test, void *priv)
+{
+	if (!adapter_speed_is_auto() || adapter_config.auto_speed.tuned
+			|| adapter_config.auto_speed.busy)
+		return ERROR_OK;
+
+	adapter_config.auto_speed.busy = true;
+
+	unsigned int lo = adapter_config.auto_speed.min_khz;
+	unsigned int hi = adapter_config.auto_speed.max_khz;
+	unsigned int khz;
+
+	if (!adapter_speed_test_passes(test, priv, lo)) {
+		LOG_WARNING("adapter speed auto: link unreliable at %u kHz, not tuning", lo);
+		adapter_config_khz(lo);
+		adapter_config.auto_speed.busy = false;
+		return ERROR_FAIL;
+	}
+
+	/* Binary search the highest passing clock, down to a 1/16 resolution;
+	 * most adapters only have a handful of real dividers anyway. */
+	if (adapter_speed_test_passes(test, priv, hi)) {
+		lo = hi;
+	} else {
+		while (hi - lo > lo / 16 + 1) {
+			unsigned int mid = lo + (hi - lo) / 2;
+			if (adapter_speed_test_passes(test, priv, mid))
+				lo = mid;
+			else
+				hi = mid;
+		}
+	}
+
+	/* Back off one step for margin, and make sure that still works */
+	khz = MAX(lo * AUTO_SPEED_MARGIN_PCT / 100, adapter_config.auto_speed.min_khz);
+	if (!adapter_speed_test_passes(test, priv, khz)) {
+		/* also brings the link back into a known state */
+		khz = adapter_config.auto_speed.min_khz;
+		adapter_speed_test_passes(test, priv, khz);
+	}
+
+	int actual_khz = khz;
+	adapter_get_speed_readable(&actual_khz);
+	LOG_INFO("adapter speed auto: %d kHz (highest passing %u kHz)", actual_khz, lo);
+
+	adapter_config.auto_speed.tuned = true;
+	adapter_config.auto_speed.errors = 0;
+	adapter_config.auto_speed.busy = false;
+	return ERROR_OK;
+}
+
+void adapter_speed_auto_error(void)
+{
+	if (!adapter_config.auto_speed.tuned || adapter_config.auto_speed.busy)
+		return;
+
+	int64_t now = timeval_ms();
+	if (now - adapter_config.auto_speed.window_start > AUTO_SPEED_ERROR_WINDOW_MS) {
+		adapter_config.auto_speed.window_start = now;
+		adapter_config.auto_speed.errors = 0;
+	}
+	if (++adapter_config.auto_speed.errors < AUTO_SPEED_ERROR_LIMIT)
+		return;
+
+	adapter_config.auto_speed.errors = 0;
+	unsigned int khz = adapter_get_speed_khz();
+	if (khz <= adapter_config.auto_speed.min_khz)
+		return;
+
+	khz = MAX(khz * AUTO_SPEED_MARGIN_PCT / 100, adapter_config.auto_speed.min_khz);
+	LOG_WARNING("adapter speed auto: %u errors within %d ms, lowering clock to %u kHz",
+		AUTO_SPEED_ERROR_LIMIT, AUTO_SPEED_ERROR_WINDOW_MS, khz);
+
+	/* the driver speed callback may itself flush a queue; don't recurse */
+	adapter_config.auto_speed.busy = true;
+	adapter_config_khz(khz);
+	adapter_config.auto_speed.busy = false;
+}
+
 const char *adapter_get_required_serial(void)
 {
 	return adapter_config.serial;
@@ -712,11 +831,37 @@ COMMAND_HANDLER(handle_adapter_srst_pulse_width_command)
 
 COMMAND_HANDLER(handle_adapter_speed_command)
 {
-	if (CMD_ARGC > 1)
+	if (CMD_ARGC > 2)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	int retval = ERROR_OK;
-	if (CMD_ARGC == 1) {
+	if (CMD_ARGC >= 1 && !strcmp(CMD_ARGV[0], "auto")) {
+		unsigned int max_khz = AUTO_SPEED_DEFAULT_MAX_KHZ;
+		if (CMD_ARGC == 2)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], max_khz);
+
+		/* tuning starts from the last explicitly configured speed */
+		unsigned int min_khz = adapter_get_speed_khz();
+		if (adapter_config.clock_mode != CLOCK_MODE_KHZ || !min_khz)
+			min_khz = DEFAULT_CLOCK_SPEED_KHZ;
+		if (max_khz < min_khz) {
+			command_print(CMD, "maximum speed %u kHz is below the starting speed %u kHz",
+				max_khz, min_khz);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		adapter_config.auto_speed.enabled = true;
+		adapter_config.auto_speed.tuned = false;
+		adapter_config.auto_speed.min_khz = min_khz;
+		adapter_config.auto_speed.max_khz = max_khz;
+		retval = adapter_config_khz(min_khz);
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (CMD_ARGC == 2) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	} else if (CMD_ARGC == 1) {
+		adapter_config.auto_speed.enabled = false;
+
 		unsigned int khz = 0;
 		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], khz);
 
@@ -1104,9 +1249,10 @@ static const struct command_registration adapter_command_handlers[] = {
 		.mode = COMMAND_ANY,
 		.help = "With an argument, change to the specified maximum "
 			"jtag speed.  For JTAG, 0 KHz signifies adaptive "
-			"clocking. "
+			"clocking. 'auto' searches for the highest reliable "
+			"speed when the scan chain or SWD link is set up. "
 			"With or without argument, display current setting.",
-		.usage = "[khz]",
+		.usage = "[khz | 'auto' [max_khz]]",
 	},
 	{
 		.name = "serial",
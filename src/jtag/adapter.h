@@ -106,6 +106,31 @@ int adapter_config_rclk(unsigned int fallback_speed_khz);
 /** Retrieves the clock speed of the adapter in kHz. */
 unsigned int adapter_get_speed_khz(void);
 
+/**
+ * Link check used by adapter_speed_autotune(); runs a known-good access
+ * pattern at the current clock.
+ * @returns ERROR_OK if every transfer completed with the expected data.
+ */
+typedef int (*adapter_speed_test_fn)(void *priv);
+
+/** @returns true if "adapter speed auto" is selected and supported. */
+bool adapter_speed_is_auto(void);
+
+/**
+ * Search for the highest adapter clock at which @a test passes repeatedly,
+ * then back off one step for margin. Does nothing unless "adapter speed
+ * auto" is selected, and only tunes once per "adapter speed auto" command.
+ */
+int adapter_speed_autotune(adapter_speed_test_fn test, void *priv);
+
+/**
+ * Report a link-level error (garbled ACK, parity, unexpected IDCODE/DPIDR or
+ * IR capture) to the "adapter speed auto" logic. Errors reported by the
+ * target itself, like bus faults, must not be counted. Lowers the tuned clock
+ * by one step when errors pile up within a short window.
+ */
+void adapter_speed_auto_error(void);
+
 /** Retrieves the serial number set with command 'adapter serial' */
 const char *adapter_get_required_serial(void);
 
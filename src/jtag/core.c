@@ -1031,7 +1031,8 @@ int default_interface_jtag_execute_queue(void)
 void jtag_execute_queue_noclear(void)
 {
 	jtag_flush_queue_count++;
-	jtag_set_error(interface_jtag_execute_queue());
+	int retval = interface_jtag_execute_queue();
+	jtag_set_error(retval);
 
 	if (jtag_flush_queue_sleep > 0) {
 		/* For debug purposes it can be useful to test performance
@@ -1211,6 +1212,7 @@ static bool jtag_examine_chain_match_tap(const struct jtag_tap *tap)
 	}
 
 	/* If none of the expected ids matched, warn */
+	adapter_speed_auto_error();
 	jtag_examine_chain_display(LOG_LVL_WARNING, "UNEXPECTED",
 		tap->dotted_name, tap->idcode);
 	for (unsigned int i = 0; i < tap->expected_ids_cnt; i++) {
@@ -1429,6 +1431,7 @@ static int jtag_validate_ircapture(void)
 				(tap->ir_length + 7) / tap->ir_length, val,
 				(tap->ir_length + 7) / tap->ir_length, tap->ir_capture_value);
 
+			adapter_speed_auto_error();
 			retval = ERROR_JTAG_INIT_FAILED;
 			goto done;
 		}
@@ -1445,6 +1448,7 @@ static int jtag_validate_ircapture(void)
 		LOG_ERROR("IR capture error at bit %d, saw 0x%s not 0x...3",
 			chain_pos, cbuf);
 		free(cbuf);
+		adapter_speed_auto_error();
 		retval = ERROR_JTAG_INIT_FAILED;
 	}
 
@@ -1513,6 +1517,86 @@ void jtag_tap_free(struct jtag_tap *tap)
 	free(tap);
 }
 
+/* "adapter speed auto" link check: re-read IDCODEs after TLR, then put
+ * every TAP into BYPASS and loop a pseudorandom pattern through the chain.
+ */
+static int jtag_speed_test(void *priv)
+{
+	static uint32_t lfsr = 0xace1u;
+	struct jtag_tap *tap;
+	unsigned int ir_bits = 0, id_bits = 0, num_taps = 0;
+	int retval = ERROR_FAIL;
+
+	for (tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap)) {
+		ir_bits += tap->ir_length;
+		id_bits += tap->has_idcode ? 32 : 1;
+		num_taps++;
+	}
+	if (!num_taps || !ir_bits)
+		return ERROR_OK;
+
+	const unsigned int pattern_bits = 64;
+	unsigned int dr_bits = pattern_bits + num_taps;
+	uint8_t *ir = malloc(DIV_ROUND_UP(ir_bits, 8));
+	uint8_t *id_out = calloc(DIV_ROUND_UP(id_bits, 8), 1);
+	uint8_t *id_in = malloc(DIV_ROUND_UP(id_bits, 8));
+	uint8_t *dr_out = calloc(DIV_ROUND_UP(dr_bits, 8), 1);
+	uint8_t *dr_in = malloc(DIV_ROUND_UP(dr_bits, 8));
+	if (!ir || !id_out || !id_in || !dr_out || !dr_in)
+		goto done;
+
+	buf_set_ones(ir, ir_bits);
+	buf_set_ones(id_out, id_bits);
+	for (unsigned int i = 0; i < pattern_bits; i += 32) {
+		lfsr ^= lfsr << 13;
+		lfsr ^= lfsr >> 17;
+		lfsr ^= lfsr << 5;
+		buf_set_u32(dr_out, i, 32, lfsr);
+	}
+
+	jtag_add_tlr();
+	jtag_add_plain_dr_scan(id_bits, id_out, id_in, TAP_IDLE);
+	jtag_add_plain_ir_scan(ir_bits, ir, NULL, TAP_IDLE);
+	jtag_add_plain_dr_scan(dr_bits, dr_out, dr_in, TAP_IDLE);
+	/* leave the chain the way targets expect it after examine */
+	jtag_add_tlr();
+	retval = jtag_execute_queue();
+	if (retval != ERROR_OK)
+		goto done;
+
+	unsigned int pos = 0;
+	for (tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap)) {
+		if (!tap->has_idcode) {
+			pos++;
+			continue;
+		}
+		if (buf_get_u32(id_in, pos, 32) != tap->idcode) {
+			LOG_DEBUG("%s: IDCODE 0x%08" PRIx32 " not 0x%08" PRIx32,
+				jtag_tap_name(tap), buf_get_u32(id_in, pos, 32), tap->idcode);
+			retval = ERROR_FAIL;
+			goto done;
+		}
+		pos += 32;
+	}
+
+	/* each BYPASS register delays the pattern by one bit */
+	for (unsigned int i = 0; i < pattern_bits; i += 32) {
+		if (buf_get_u32(dr_in, num_taps + i, 32) != buf_get_u32(dr_out, i, 32)) {
+			LOG_DEBUG("BYPASS loop-back mismatch at bit %u", i);
+			retval = ERROR_FAIL;
+			goto done;
+		}
+	}
+
+done:
+	free(ir);
+	free(id_out);
+	free(id_in);
+	free(dr_out);
+	free(dr_in);
+	return retval;
+}
+
 int jtag_init_inner(struct command_context *cmd_ctx)
 {
 	struct jtag_tap *tap;
@@ -1584,6 +1668,9 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 		issue_setup = false;
 	}
 
+	if (issue_setup && adapter_speed_is_auto())
+		adapter_speed_autotune(jtag_speed_test, NULL);
+
 	if (issue_setup)
 		jtag_notify_event(JTAG_TAP_EVENT_SETUP);
 	else
@@ -385,6 +385,9 @@ int bitbang_execute_queue(struct jtag_command *cmd_queue)
 }
 
 static int queued_retval;
+/* transactions with OK ACK in the running and in the last executed queue */
+static unsigned int queued_completed;
+static unsigned int last_completed;
 
 static int bitbang_swd_init(void)
 {
@@ -463,8 +466,13 @@ static int bitbang_swd_switch_seq(enum swd_special_seq seq)
 
 static void swd_clear_sticky_errors(void)
 {
+	/* Internal transaction, do not count it as a queued one */
+	unsigned int completed = queued_completed;
+
 	bitbang_swd_write_reg(swd_cmd(false,  false, DP_ABORT),
 		STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, 0);
+
+	queued_completed = completed;
 }
 
 static void bitbang_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_clk)
@@ -516,11 +524,12 @@ static void bitbang_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay
 
 		if (parity != parity_u32(data)) {
 			LOG_ERROR("Wrong parity detected");
-			queued_retval = ERROR_FAIL;
+			queued_retval = ERROR_SWD_FAIL;
 			return;
 		}
 		if (value)
 			*value = data;
+		queued_completed++;
 		if (cmd & SWD_CMD_APNDP)
 			bitbang_swd_exchange(true, NULL, 0, ap_delay_clk);
 		return;
@@ -593,6 +602,7 @@ static void bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay
 			return;
 		}
 
+		queued_completed++;
 		if (cmd & SWD_CMD_APNDP)
 			bitbang_swd_exchange(true, NULL, 0, ap_delay_clk);
 		return;
@@ -607,14 +617,22 @@ static int bitbang_swd_run_queue(void)
 
 	int retval = queued_retval;
 	queued_retval = ERROR_OK;
+	last_completed = queued_completed;
+	queued_completed = 0;
 	LOG_DEBUG_IO("SWD queue return value: %02x", retval);
 	return retval;
 }
 
+static unsigned int bitbang_swd_completed_count(void)
+{
+	return last_completed;
+}
+
 const struct swd_driver bitbang_swd = {
 	.init = bitbang_swd_init,
 	.switch_seq = bitbang_swd_switch_seq,
 	.read_reg = bitbang_swd_read_reg,
 	.write_reg = bitbang_swd_write_reg,
 	.run = bitbang_swd_run_queue,
+	.completed_count = bitbang_swd_completed_count,
 };
@@ -1445,7 +1445,7 @@ static void buspirate_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_del
 	case SWD_ACK_OK:
 		if (parity != parity_u32(data)) {
 			LOG_DEBUG("Read data parity mismatch %x %x", parity, parity_u32(data));
-			queued_retval = ERROR_FAIL;
+			queued_retval = ERROR_SWD_FAIL;
 			return;
 		}
 		if (value)
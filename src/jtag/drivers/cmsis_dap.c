@@ -34,10 +34,16 @@
 #include <jtag/interface.h>
 #include <jtag/commands.h>
 #include <jtag/tcl.h>
+#include <target/arm_adi_v5.h>
 #include <target/cortex_m.h>
 
 #include "cmsis_dap.h"
+#if BUILD_CMSIS_DAP_USB == 1
 #include "libusb_helper.h"
+#else
+/* same packet timeout for the backends built without libusb */
+#define LIBUSB_TIMEOUT_MS	(6000)
+#endif
 
 /* Create a dummy backend for 'backend' command if real one does not build */
 #if BUILD_CMSIS_DAP_USB == 0
@@ -52,9 +58,16 @@ const struct cmsis_dap_backend cmsis_dap_hid_backend = {
 };
 #endif
 
+#if BUILD_CMSIS_DAP_TCP == 0
+const struct cmsis_dap_backend cmsis_dap_tcp_backend = {
+	.name = "tcp"
+};
+#endif
+
 static const struct cmsis_dap_backend *const cmsis_dap_backends[] = {
 	&cmsis_dap_usb_backend,
 	&cmsis_dap_hid_backend,
+	&cmsis_dap_tcp_backend,
 };
 
 /* USB Config */
@@ -77,6 +90,13 @@ static uint16_t cmsis_dap_pid[MAX_USB_IDS + 1] = { 0 };
 static int cmsis_dap_backend = -1;
 static bool swd_mode;
 
+/* ADIv5 DAP accesses in JTAG mode through DAP_Transfer, see cmsis_dap_jtag_dap_ops */
+static bool jtag_dap_transfer = true;
+static struct adiv5_dap *jtag_dap_cur;	/* DAP addressed by the queued transfers */
+static uint8_t jtag_dap_index;			/* its position in the chain, the DAP Index */
+static uint8_t jtag_dap_ir;				/* the IR it was left with */
+static int jtag_dap_idle;				/* idle cycles set by DAP_TransferConfigure */
+
 /* CMSIS-DAP General Commands */
 #define CMD_DAP_INFO              0x00
 #define CMD_DAP_LED               0x01
@@ -314,9 +334,11 @@ static void cmsis_dap_close(struct cmsis_dap *dap)
 
 	free(dap->packet_buffer);
 
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
-		free(dap->pending_fifo[i].transfers);
-		dap->pending_fifo[i].transfers = NULL;
+	if (dap->pending_fifo) {
+		for (unsigned int i = 0; i < dap->packet_count; i++)
+			free(dap->pending_fifo[i].transfers);
+		free(dap->pending_fifo);
+		dap->pending_fifo = NULL;
 	}
 
 	free(cmsis_dap_handle);
@@ -535,6 +557,40 @@ static int cmsis_dap_cmd_dap_tfer_configure(uint8_t idle, uint16_t retry_count,
 	return ERROR_OK;
 }
 
+static int cmsis_dap_cmd_dap_write_abort(uint8_t dap_index, uint32_t value)
+{
+	uint8_t *command = cmsis_dap_handle->command;
+
+	command[0] = CMD_DAP_WRITE_ABORT;
+	command[1] = dap_index;
+	h_u32_to_le(&command[2], value);
+
+	int retval = cmsis_dap_xfer(cmsis_dap_handle, 6);
+	if (retval != ERROR_OK || cmsis_dap_handle->response[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_WRITE_ABORT failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_dap_jtag_configure(const uint8_t *ir_lengths, unsigned int count)
+{
+	uint8_t *command = cmsis_dap_handle->command;
+
+	command[0] = CMD_DAP_JTAG_CONFIGURE;
+	command[1] = count;
+	memcpy(&command[2], ir_lengths, count);
+
+	int retval = cmsis_dap_xfer(cmsis_dap_handle, 2 + count);
+	if (retval != ERROR_OK || cmsis_dap_handle->response[1] != DAP_OK) {
+		LOG_DEBUG("CMSIS-DAP command CMD_JTAG_CONFIGURE failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
 static int cmsis_dap_cmd_dap_swd_configure(uint8_t cfg)
 {
 	uint8_t *command = cmsis_dap_handle->command;
@@ -770,7 +826,7 @@ static int cmsis_dap_cmd_dap_swo_data(
 
 static void cmsis_dap_swd_discard_all_pending(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++)
+	for (unsigned int i = 0; i < dap->packet_count; i++)
 		dap->pending_fifo[i].transfer_count = 0;
 
 	dap->pending_fifo_put_idx = 0;
@@ -815,7 +871,7 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	block->command = block_cmd ? CMD_DAP_TFER_BLOCK : CMD_DAP_TFER;
 
 	command[0] = block->command;
-	command[1] = 0x00;	/* DAP Index */
+	command[1] = swd_mode ? 0x00 : jtag_dap_index;	/* DAP Index */
 
 	unsigned int idx;
 	if (block_cmd) {
@@ -942,7 +998,7 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 	}
 	if (resp[idx] & 0x08) {
 		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", transfer_count);
-		queued_retval = ERROR_FAIL;
+		queued_retval = ERROR_SWD_FAIL;
 		goto skip;
 	}
 	uint8_t ack = resp[idx++] & 0x07;
@@ -976,9 +1032,10 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 
 			LOG_DEBUG_IO("Read result: %" PRIx32, data);
 
-			/* Imitate posted AP reads */
-			if ((transfer->cmd & SWD_CMD_APNDP) ||
-			    ((transfer->cmd & SWD_CMD_A32) >> 1 == DP_RDBUFF)) {
+			/* Imitate posted AP reads, in JTAG mode the adapter
+			 * returns the results of cmsis_dap_jtag_dap_ops directly */
+			if (swd_mode && ((transfer->cmd & SWD_CMD_APNDP) ||
+			    ((transfer->cmd & SWD_CMD_A32) >> 1 == DP_RDBUFF))) {
 				tmp = last_read;
 				last_read = data;
 			}
@@ -1129,6 +1186,375 @@ static void cmsis_dap_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_del
 	cmsis_dap_swd_queue_cmd(cmd, value, 0);
 }
 
+/*
+ * ADIv5 DAP accesses in JTAG mode. Instead of the IR and DR scans of
+ * jtag_dp_ops, DP and AP accesses are queued as DAP_Transfer requests:
+ * the adapter selects DPACC/APACC, handles posted reads and retries WAIT
+ * itself, so a whole memory block costs a single USB round trip. Chains the
+ * adapter can't address (disabled TAPs, over-long IRs) keep using jtag_dp_ops.
+ */
+
+#define JTAG_DP_ABORT		0xF8
+#define JTAG_DP_DPACC		0xFA
+#define JTAG_DP_APACC		0xFB
+
+/* Point the transfers at @dap, flushing what is queued for another DAP */
+static int cmsis_dap_jtag_select(struct adiv5_dap *dap)
+{
+	if (dap == jtag_dap_cur)
+		return ERROR_OK;
+
+	int retval = cmsis_dap_swd_run_queue();
+	if (retval != ERROR_OK)
+		return retval;
+
+	unsigned int index = 0;
+	for (struct jtag_tap *tap = jtag_all_taps(); tap != dap->tap; tap = tap->next_tap)
+		index++;
+
+	/* DAP_Transfer starts from Run-Test/Idle, finish the JTAG queue there */
+	if (tap_get_state() != TAP_IDLE)
+		jtag_add_statemove(TAP_IDLE);
+	retval = jtag_execute_queue();
+	if (retval != ERROR_OK)
+		return retval;
+
+	jtag_dap_cur = dap;
+	jtag_dap_index = index;
+	return ERROR_OK;
+}
+
+/* Make the JTAG layer aware of the IRs the adapter left behind */
+static void cmsis_dap_jtag_sync_taps(void)
+{
+	if (!jtag_dap_cur)
+		return;
+
+	for (struct jtag_tap *tap = jtag_all_taps(); tap; tap = tap->next_tap) {
+		if (tap == jtag_dap_cur->tap) {
+			buf_set_u32(tap->cur_instr, 0, tap->ir_length, jtag_dap_ir);
+			tap->bypass = false;
+		} else {
+			buf_set_ones(tap->cur_instr, tap->ir_length);
+			tap->bypass = true;
+		}
+	}
+	tap_set_state(TAP_IDLE);
+
+	/* the next transfer goes through cmsis_dap_jtag_select() again */
+	jtag_dap_cur = NULL;
+}
+
+static int cmsis_dap_jtag_flush(void)
+{
+	int retval = cmsis_dap_swd_run_queue();
+	cmsis_dap_jtag_sync_taps();
+	return retval;
+}
+
+static int cmsis_dap_jtag_queue(struct adiv5_dap *dap, bool is_ap, bool is_read,
+		unsigned int reg, uint32_t *data, uint32_t value)
+{
+	int retval = cmsis_dap_jtag_select(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	jtag_dap_ir = is_ap ? JTAG_DP_APACC : JTAG_DP_DPACC;
+	cmsis_dap_swd_queue_cmd(swd_cmd(is_read, is_ap, reg), data, value);
+	return queued_retval;
+}
+
+static int cmsis_dap_jtag_dp_bankselect(struct adiv5_dap *dap, unsigned int reg)
+{
+	/* SELECT and RDBUFF are not banked */
+	if (reg == DP_SELECT || reg == DP_RDBUFF)
+		return ERROR_OK;
+
+	uint64_t sel = (reg >> 4) & DP_SELECT_DPBANK;
+	if (dap->select_valid && sel == (dap->select & DP_SELECT_DPBANK))
+		return ERROR_OK;
+
+	sel |= dap->select & SELECT_AP_MASK;
+
+	LOG_DEBUG_IO("DP BANK SELECT: %" PRIx32, (uint32_t)sel);
+
+	int retval = cmsis_dap_jtag_queue(dap, false, false, DP_SELECT, NULL, (uint32_t)sel);
+	if (retval != ERROR_OK)
+		return retval;
+
+	dap->select = sel;
+	dap->select_valid = true;
+	return ERROR_OK;
+}
+
+static int cmsis_dap_jtag_dp_q_read(struct adiv5_dap *dap, unsigned int reg, uint32_t *data)
+{
+	int retval = cmsis_dap_jtag_dp_bankselect(dap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_jtag_queue(dap, false, true, reg, data, 0);
+}
+
+static int cmsis_dap_jtag_dp_q_write(struct adiv5_dap *dap, unsigned int reg, uint32_t data)
+{
+	int retval = cmsis_dap_jtag_dp_bankselect(dap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_jtag_queue(dap, false, false, reg, NULL, data);
+}
+
+static int cmsis_dap_jtag_ap_bankselect(struct adiv5_ap *ap, unsigned int reg)
+{
+	int retval;
+	struct adiv5_dap *dap = ap->dap;
+	uint64_t sel;
+
+	if (is_adiv6(dap))
+		sel = ap->ap_num | (reg & 0x00000FF0);
+	else
+		sel = (ap->ap_num << 24) | (reg & ADIV5_DP_SELECT_APBANK);
+
+	uint64_t sel_diff = (sel ^ dap->select) & SELECT_AP_MASK;
+
+	bool set_select = !dap->select_valid || (sel_diff & 0xffffffffull);
+	bool set_select1 = is_adiv6(dap) && dap->asize > 32
+						&& (!dap->select1_valid
+							|| sel_diff & (0xffffffffull << 32));
+
+	if (set_select && set_select1) {
+		/* Prepare DP bank for DP_SELECT1 now to save one write */
+		sel |= (DP_SELECT1 >> 4) & DP_SELECT_DPBANK;
+	} else {
+		/* Use the DP part of dap->select regardless of dap->select_valid,
+		 * see jtag_ap_q_bankselect() */
+		sel |= dap->select & DP_SELECT_DPBANK;
+	}
+
+	if (set_select) {
+		LOG_DEBUG_IO("AP BANK SELECT: %" PRIx32, (uint32_t)sel);
+
+		retval = cmsis_dap_jtag_dp_q_write(dap, DP_SELECT, (uint32_t)sel);
+		if (retval != ERROR_OK) {
+			dap->select_valid = false;
+			return retval;
+		}
+	}
+
+	if (set_select1) {
+		LOG_DEBUG_IO("AP BANK SELECT1: %" PRIx32, (uint32_t)(sel >> 32));
+
+		retval = cmsis_dap_jtag_dp_q_write(dap, DP_SELECT1, (uint32_t)(sel >> 32));
+		if (retval != ERROR_OK) {
+			dap->select1_valid = false;
+			return retval;
+		}
+	}
+
+	dap->select = sel;
+	return ERROR_OK;
+}
+
+/* The adapter inserts the idle cycles of a MEM-AP after each AP access */
+static int cmsis_dap_jtag_ap_idle(struct adiv5_ap *ap)
+{
+	int idle = MIN(ap->memaccess_tck, 255);
+	if (idle == jtag_dap_idle)
+		return ERROR_OK;
+
+	int retval = cmsis_dap_jtag_flush();
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_cmd_dap_tfer_configure(idle, 64, 0);
+	if (retval != ERROR_OK)
+		return retval;
+
+	jtag_dap_idle = idle;
+	return ERROR_OK;
+}
+
+static int cmsis_dap_jtag_check_reconnect(struct adiv5_dap *dap)
+{
+	if (dap->do_reconnect)
+		return dap->ops->connect(dap);
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_jtag_ap_q_read(struct adiv5_ap *ap, unsigned int reg, uint32_t *data)
+{
+	int retval = cmsis_dap_jtag_check_reconnect(ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_jtag_ap_idle(ap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_jtag_ap_bankselect(ap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_jtag_queue(ap->dap, true, true, reg, data, 0);
+}
+
+static int cmsis_dap_jtag_ap_q_write(struct adiv5_ap *ap, unsigned int reg, uint32_t data)
+{
+	int retval = cmsis_dap_jtag_check_reconnect(ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_jtag_ap_idle(ap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_jtag_ap_bankselect(ap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_jtag_queue(ap->dap, true, false, reg, NULL, data);
+}
+
+static int cmsis_dap_jtag_ap_q_abort(struct adiv5_dap *dap, uint8_t *ack)
+{
+	/* the result of the queue doesn't matter, the transaction gets aborted */
+	(void)cmsis_dap_jtag_flush();
+
+	unsigned int index = 0;
+	for (struct jtag_tap *tap = jtag_all_taps(); tap != dap->tap; tap = tap->next_tap)
+		index++;
+
+	int retval = cmsis_dap_cmd_dap_write_abort(index, DAPABORT);
+	if (retval != ERROR_OK)
+		return retval;
+
+	jtag_dap_cur = dap;
+	jtag_dap_ir = JTAG_DP_ABORT;
+	cmsis_dap_jtag_sync_taps();
+	return ERROR_OK;
+}
+
+static int cmsis_dap_jtag_run(struct adiv5_dap *dap)
+{
+	uint32_t ctrlstat, pwrmask;
+
+	/* JTAG-DP doesn't report FAULT in the ACK, check the sticky
+	 * error with a CTRL/STAT read appended to the queue */
+	int retval = cmsis_dap_jtag_dp_q_read(dap, DP_CTRL_STAT, &ctrlstat);
+	int flush_retval = cmsis_dap_jtag_flush();
+	if (retval == ERROR_OK)
+		retval = flush_retval;
+
+	if (retval == ERROR_WAIT) {
+		LOG_DEBUG("WAIT response persisted, aborting the transaction");
+		cmsis_dap_jtag_ap_q_abort(dap, NULL);
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* REVISIT also STICKYCMP, for pushed comparisons (nyet used) */
+
+	if (ctrlstat & SSTICKYERR) {
+		LOG_DEBUG("jtag-dp: CTRL/STAT 0x%" PRIx32, ctrlstat);
+		/* Check power to debug regions */
+		pwrmask = CDBGPWRUPREQ | CDBGPWRUPACK | CSYSPWRUPREQ;
+		if (!dap->ignore_syspwrupack)
+			pwrmask |= CSYSPWRUPACK;
+		if ((ctrlstat & pwrmask) != pwrmask) {
+			LOG_ERROR("Debug regions are unpowered, an unexpected reset might have happened");
+			dap->do_reconnect = true;
+		}
+
+		LOG_ERROR("JTAG-DP STICKY ERROR");
+		if (ctrlstat & SSTICKYORUN)
+			LOG_DEBUG("JTAG-DP STICKY OVERRUN");
+
+		/* Clear Sticky Error and Sticky Overrun Bits */
+		retval = cmsis_dap_jtag_dp_q_write(dap, DP_CTRL_STAT,
+				dap->dp_ctrl_stat | SSTICKYERR | SSTICKYORUN);
+		flush_retval = cmsis_dap_jtag_flush();
+		if (retval == ERROR_OK)
+			retval = flush_retval;
+		if (retval != ERROR_OK)
+			return retval;
+
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_jtag_sync(struct adiv5_dap *dap)
+{
+	return cmsis_dap_jtag_flush();
+}
+
+static int cmsis_dap_jtag_send_sequence(struct adiv5_dap *dap, enum swd_special_seq seq)
+{
+	return jtag_dp_ops.send_sequence(dap, seq);
+}
+
+/* Tell the adapter the IR lengths of the chain, false if it can't handle it */
+static bool cmsis_dap_jtag_configure_chain(void)
+{
+	uint8_t ir_lengths[256];
+	unsigned int count = 0;
+
+	if (!jtag_dap_transfer || swd_mode)
+		return false;
+
+	for (struct jtag_tap *tap = jtag_all_taps(); tap; tap = tap->next_tap) {
+		if (!tap->enabled) {
+			LOG_DEBUG("TAP %s is disabled", tap->dotted_name);
+			return false;
+		}
+		if (tap->ir_length > 255 || count >= 255)
+			return false;
+		ir_lengths[count++] = tap->ir_length;
+	}
+
+	if (2 + count > cmsis_dap_handle->packet_usable_size)
+		return false;
+
+	/* The chain may have changed since the last connect */
+	if (jtag_execute_queue() != ERROR_OK)
+		return false;
+
+	return cmsis_dap_cmd_dap_jtag_configure(ir_lengths, count) == ERROR_OK;
+}
+
+static int cmsis_dap_jtag_connect(struct adiv5_dap *dap)
+{
+	dap->do_reconnect = false;
+
+	if (cmsis_dap_jtag_configure_chain()) {
+		jtag_dap_cur = NULL;
+		int retval = dap_dp_init(dap);
+		if (retval == ERROR_OK) {
+			LOG_DEBUG("%s: using CMSIS-DAP DAP_Transfer", adiv5_dap_name(dap));
+			return ERROR_OK;
+		}
+		LOG_INFO("%s: DAP_Transfer failed, using JTAG scans", adiv5_dap_name(dap));
+	}
+
+	dap->ops = &jtag_dp_ops;
+	return dap->ops->connect(dap);
+}
+
+static const struct dap_ops cmsis_dap_jtag_dap_ops = {
+	.connect = cmsis_dap_jtag_connect,
+	.send_sequence = cmsis_dap_jtag_send_sequence,
+	.queue_dp_read = cmsis_dap_jtag_dp_q_read,
+	.queue_dp_write = cmsis_dap_jtag_dp_q_write,
+	.queue_ap_read = cmsis_dap_jtag_ap_q_read,
+	.queue_ap_write = cmsis_dap_jtag_ap_q_write,
+	.queue_ap_abort = cmsis_dap_jtag_ap_q_abort,
+	.run = cmsis_dap_jtag_run,
+	.sync = cmsis_dap_jtag_sync,
+};
+
 static int cmsis_dap_get_serial_info(void)
 {
 	uint8_t *data;
@@ -1393,12 +1819,19 @@ static int cmsis_dap_init(void)
 	if (data[0] == 1) { /* byte */
 		unsigned int pkt_cnt = data[1];
 		if (pkt_cnt > 1)
-			cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+			cmsis_dap_handle->packet_count = MIN(cmsis_dap_handle->backend->max_pending_requests, pkt_cnt);
 
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %u", pkt_cnt);
 	}
 
 	LOG_DEBUG("Allocating FIFO for %u pending packets", cmsis_dap_handle->packet_count);
+	cmsis_dap_handle->pending_fifo = calloc(cmsis_dap_handle->packet_count,
+									sizeof(struct pending_request_block));
+	if (!cmsis_dap_handle->pending_fifo) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
 	for (unsigned int i = 0; i < cmsis_dap_handle->packet_count; i++) {
 		cmsis_dap_handle->pending_fifo[i].transfers = malloc(pending_queue_len
 									 * sizeof(struct pending_transfer_result));
@@ -1425,6 +1858,7 @@ static int cmsis_dap_init(void)
 	retval = cmsis_dap_cmd_dap_tfer_configure(0, 64, 0);
 	if (retval != ERROR_OK)
 		goto init_err;
+	jtag_dap_idle = 0;
 
 	if (swd_mode) {
 		/* Data Phase (bit 2) must be set to 1 if sticky overrun
@@ -2246,6 +2680,19 @@ COMMAND_HANDLER(cmsis_dap_handle_quirk_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_jtag_transfer_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], jtag_dap_transfer);
+
+	command_print(CMD, "CMSIS-DAP DAP_Transfer in JTAG mode %s",
+				  jtag_dap_transfer ? "enabled" : "disabled");
+	return ERROR_OK;
+}
+
 static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 	{
 		.name = "info",
@@ -2272,8 +2719,8 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.name = "backend",
 		.handler = &cmsis_dap_handle_backend_command,
 		.mode = COMMAND_CONFIG,
-		.help = "set the communication backend to use (USB bulk or HID).",
-		.usage = "(auto | usb_bulk | hid)",
+		.help = "set the communication backend to use (USB bulk, HID or TCP).",
+		.usage = "(auto | usb_bulk | hid | tcp)",
 	},
 	{
 		.name = "quirk",
@@ -2282,6 +2729,13 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.help = "allow expensive workarounds of known adapter quirks.",
 		.usage = "[enable | disable]",
 	},
+	{
+		.name = "jtag_transfer",
+		.handler = &cmsis_dap_handle_jtag_transfer_command,
+		.mode = COMMAND_CONFIG,
+		.help = "access ADIv5 DAPs through DAP_Transfer in JTAG mode.",
+		.usage = "[enable | disable]",
+	},
 #if BUILD_CMSIS_DAP_USB
 	{
 		.name = "usb",
@@ -2290,6 +2744,15 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.help = "USB bulk backend-specific commands",
 		.usage = "<cmd>",
 	},
+#endif
+#if BUILD_CMSIS_DAP_TCP
+	{
+		.name = "tcp",
+		.chain = cmsis_dap_tcp_subcommand_handlers,
+		.mode = COMMAND_ANY,
+		.help = "TCP backend-specific commands",
+		.usage = "<cmd>",
+	},
 #endif
 	COMMAND_REGISTRATION_DONE
 };
@@ -2337,4 +2800,5 @@ struct adapter_driver cmsis_dap_adapter_driver = {
 
 	.jtag_ops = &cmsis_dap_interface,
 	.swd_ops = &cmsis_dap_swd_driver,
+	.dap_jtag_ops = &cmsis_dap_jtag_dap_ops,
 };
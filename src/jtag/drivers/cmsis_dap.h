@@ -14,9 +14,12 @@ struct pending_transfer_result {
 	void *buffer;
 };
 
-/* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
- * until the first response arrives */
+/* Up to MIN(packet_count, backend->max_pending_requests) requests may be
+ * issued until the first response arrives. USB backends keep one transfer
+ * per request and stay at MAX_PENDING_REQUESTS, stream backends go as deep
+ * as the adapter reports */
 #define MAX_PENDING_REQUESTS 4
+#define MAX_PENDING_REQUESTS_STREAM 255
 
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
@@ -45,8 +48,9 @@ struct cmsis_dap {
 	uint8_t common_swd_cmd;
 	bool swd_cmds_differ;
 
-	/* Pending requests are organized as a FIFO - circular buffer */
-	struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
+	/* Pending requests are organized as a FIFO - circular buffer
+	 * of packet_count blocks */
+	struct pending_request_block *pending_fifo;
 	unsigned int packet_count;
 	unsigned int pending_fifo_put_idx, pending_fifo_get_idx;
 	unsigned int pending_fifo_block_count;
@@ -74,11 +78,14 @@ struct cmsis_dap_backend {
 	int (*packet_buffer_alloc)(struct cmsis_dap *dap, unsigned int pkt_sz);
 	void (*packet_buffer_free)(struct cmsis_dap *dap);
 	void (*cancel_all)(struct cmsis_dap *dap);
+	unsigned int max_pending_requests;
 };
 
 extern const struct cmsis_dap_backend cmsis_dap_hid_backend;
 extern const struct cmsis_dap_backend cmsis_dap_usb_backend;
+extern const struct cmsis_dap_backend cmsis_dap_tcp_backend;
 extern const struct command_registration cmsis_dap_usb_subcommand_handlers[];
+extern const struct command_registration cmsis_dap_tcp_subcommand_handlers[];
 
 #define REPORT_ID_SIZE   1
 
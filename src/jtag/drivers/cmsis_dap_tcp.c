@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * CMSIS-DAP backend carrying the command and response packets over a TCP or
+ * Unix domain stream socket, for probes behind network bridges and for
+ * firmware running in a simulator.
+ *
+ * A stream has no packet boundaries, so every packet is preceded by a header:
+ *
+ *   u32  signature "DAP\0" (0x00504144 little endian)
+ *   u16  length of the packet that follows, little endian
+ *   u8   CMSIS_DAP_TCP_REQUEST or CMSIS_DAP_TCP_RESPONSE
+ *   u8   reserved, 0
+ *
+ * The adapter answers requests in order. As a socket buffers any number of
+ * requests, the pipelining depth is only limited by the packet count the
+ * adapter reports in DAP_Info, see MAX_PENDING_REQUESTS_STREAM.
+ * contrib/cmsis_dap_tcp/ has a server implementing the other end.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _WIN32
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#endif
+#include <helper/system.h>
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include <helper/time_support.h>
+#include <jtag/jtag.h>	/* ERROR_JTAG_DEVICE_ERROR only */
+
+#include "cmsis_dap.h"
+
+#define CMSIS_DAP_TCP_SIGNATURE		0x00504144
+#define CMSIS_DAP_TCP_REQUEST		0x01
+#define CMSIS_DAP_TCP_RESPONSE		0x02
+#define CMSIS_DAP_TCP_HEADER_SIZE	8
+
+#define CMSIS_DAP_TCP_DEFAULT_PORT	4441
+
+/* Used until the adapter reports its packet size */
+#define CMSIS_DAP_TCP_DEFAULT_PACKET_SIZE	1024
+
+struct cmsis_dap_backend_data {
+	int sockfd;
+};
+
+static char *cmsis_dap_tcp_host;
+static uint16_t cmsis_dap_tcp_port = CMSIS_DAP_TCP_DEFAULT_PORT;
+
+static void cmsis_dap_tcp_close(struct cmsis_dap *dap);
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz);
+static void cmsis_dap_tcp_free(struct cmsis_dap *dap);
+
+static int cmsis_dap_tcp_connect_tcp(const char *host, uint16_t port)
+{
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+	struct addrinfo *result, *rp;
+	char service[8];
+	int fd = -1;
+
+	LOG_INFO("CMSIS-DAP: connecting to %s:%" PRIu16, host, port);
+
+	snprintf(service, sizeof(service), "%" PRIu16, port);
+	int s = getaddrinfo(host, service, &hints, &result);
+	if (s != 0) {
+		LOG_ERROR("getaddrinfo: %s", gai_strerror(s));
+		return ERROR_FAIL;
+	}
+
+	for (rp = result; rp; rp = rp->ai_next) {
+		fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (fd == -1)
+			continue;
+
+		if (connect(fd, rp->ai_addr, rp->ai_addrlen) != -1)
+			break;
+
+		close_socket(fd);
+	}
+
+	freeaddrinfo(result);
+
+	if (!rp) {
+		log_socket_error("CMSIS-DAP: failed to connect");
+		return ERROR_FAIL;
+	}
+
+	/* Every packet is a complete request, don't let Nagle sit on it */
+	int one = 1;
+	/* On Windows optval has to be a const char *. */
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+
+	return fd;
+}
+
+static int cmsis_dap_tcp_connect_unix(const char *path)
+{
+#ifdef _WIN32
+	LOG_ERROR("CMSIS-DAP: Unix domain sockets are not supported on this host");
+	return ERROR_FAIL;
+#else
+	LOG_INFO("CMSIS-DAP: connecting to unix socket %s", path);
+
+	int fd = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		log_socket_error("socket");
+		return ERROR_FAIL;
+	}
+
+	struct sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path));
+	addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(struct sockaddr_un)) < 0) {
+		log_socket_error("CMSIS-DAP: failed to connect");
+		close_socket(fd);
+		return ERROR_FAIL;
+	}
+
+	return fd;
+#endif
+}
+
+/* Wait until @fd can be read (or written), returns 0 on timeout */
+static int cmsis_dap_tcp_wait(int fd, bool for_write, int timeout_ms)
+{
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+
+	struct timeval tv = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_usec = timeout_ms % 1000 * 1000
+	};
+
+	int retval = select(fd + 1, for_write ? NULL : &fds, for_write ? &fds : NULL, NULL, &tv);
+	if (retval < 0 && errno == EINTR)
+		return 0;
+	return retval;
+}
+
+static int cmsis_dap_tcp_read_all(int fd, uint8_t *buf, unsigned int len, int timeout_ms)
+{
+	int64_t deadline = timeval_ms() + timeout_ms;
+
+	while (len) {
+		int remaining = deadline - timeval_ms();
+		int retval = cmsis_dap_tcp_wait(fd, false, MAX(remaining, 0));
+		if (retval < 0) {
+			log_socket_error("CMSIS-DAP: select");
+			return ERROR_FAIL;
+		}
+		if (retval == 0) {
+			if (remaining <= 0) {
+				LOG_ERROR("CMSIS-DAP: timeout reading a response");
+				return ERROR_TIMEOUT_REACHED;
+			}
+			continue;
+		}
+
+		retval = read_socket(fd, buf, len);
+		if (retval == 0) {
+			LOG_ERROR("CMSIS-DAP: connection closed by the adapter");
+			return ERROR_FAIL;
+		}
+		if (retval < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+				continue;
+			log_socket_error("CMSIS-DAP: read");
+			return ERROR_FAIL;
+		}
+		buf += retval;
+		len -= retval;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_tcp_write_all(int fd, const uint8_t *buf, unsigned int len, int timeout_ms)
+{
+	int64_t deadline = timeval_ms() + timeout_ms;
+
+	while (len) {
+		int retval = write_socket(fd, buf, len);
+		if (retval > 0) {
+			buf += retval;
+			len -= retval;
+			continue;
+		}
+		if (retval < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+			log_socket_error("CMSIS-DAP: write");
+			return ERROR_FAIL;
+		}
+
+		int remaining = deadline - timeval_ms();
+		if (remaining <= 0) {
+			LOG_ERROR("CMSIS-DAP: timeout writing a request");
+			return ERROR_TIMEOUT_REACHED;
+		}
+		cmsis_dap_tcp_wait(fd, true, remaining);
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_tcp_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t pids[], const char *serial)
+{
+	const char *host = cmsis_dap_tcp_host ? cmsis_dap_tcp_host : "localhost";
+	int fd;
+
+	if (cmsis_dap_tcp_port == 0)
+		fd = cmsis_dap_tcp_connect_unix(host);
+	else
+		fd = cmsis_dap_tcp_connect_tcp(host, cmsis_dap_tcp_port);
+	if (fd < 0)
+		return ERROR_FAIL;
+
+	socket_nonblock(fd);
+
+	dap->bdata = malloc(sizeof(struct cmsis_dap_backend_data));
+	if (!dap->bdata) {
+		LOG_ERROR("unable to allocate memory");
+		close_socket(fd);
+		return ERROR_FAIL;
+	}
+	dap->bdata->sockfd = fd;
+
+	int retval = cmsis_dap_tcp_alloc(dap, CMSIS_DAP_TCP_DEFAULT_PACKET_SIZE);
+	if (retval != ERROR_OK) {
+		cmsis_dap_tcp_close(dap);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_tcp_close(struct cmsis_dap *dap)
+{
+	if (dap->bdata) {
+		close_socket(dap->bdata->sockfd);
+		free(dap->bdata);
+		dap->bdata = NULL;
+	}
+	cmsis_dap_tcp_free(dap);
+}
+
+static int cmsis_dap_tcp_read(struct cmsis_dap *dap, int transfer_timeout_ms,
+							  enum cmsis_dap_blocking blocking)
+{
+	int fd = dap->bdata->sockfd;
+	int wait_ms = (blocking == CMSIS_DAP_NON_BLOCKING) ? 0 : transfer_timeout_ms;
+
+	/* Once a response has started, the rest follows shortly */
+	int retval = cmsis_dap_tcp_wait(fd, false, wait_ms);
+	if (retval < 0) {
+		log_socket_error("CMSIS-DAP: select");
+		return ERROR_FAIL;
+	}
+	if (retval == 0)
+		return ERROR_TIMEOUT_REACHED;
+
+	uint8_t *header = dap->packet_buffer;
+	retval = cmsis_dap_tcp_read_all(fd, header, CMSIS_DAP_TCP_HEADER_SIZE, transfer_timeout_ms);
+	if (retval != ERROR_OK)
+		return retval;
+
+	unsigned int len = le_to_h_u16(&header[4]);
+	if (le_to_h_u32(header) != CMSIS_DAP_TCP_SIGNATURE
+			|| header[6] != CMSIS_DAP_TCP_RESPONSE
+			|| len > dap->packet_size) {
+		LOG_ERROR("CMSIS-DAP: invalid response header");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	retval = cmsis_dap_tcp_read_all(fd, dap->response, len, transfer_timeout_ms);
+	if (retval != ERROR_OK)
+		return retval;
+
+	memset(&dap->response[len], 0, dap->packet_size - len);
+	return len;
+}
+
+static int cmsis_dap_tcp_write(struct cmsis_dap *dap, int txlen, int timeout_ms)
+{
+	uint8_t *header = dap->packet_buffer;
+
+	h_u32_to_le(&header[0], CMSIS_DAP_TCP_SIGNATURE);
+	h_u16_to_le(&header[4], txlen);
+	header[6] = CMSIS_DAP_TCP_REQUEST;
+	header[7] = 0;
+
+	int retval = cmsis_dap_tcp_write_all(dap->bdata->sockfd, dap->packet_buffer,
+										 CMSIS_DAP_TCP_HEADER_SIZE + txlen, timeout_ms);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return txlen;
+}
+
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
+{
+	unsigned int packet_buffer_size = CMSIS_DAP_TCP_HEADER_SIZE + pkt_sz;
+	uint8_t *buf = malloc(packet_buffer_size);
+	if (!buf) {
+		LOG_ERROR("unable to allocate CMSIS-DAP packet buffer");
+		return ERROR_FAIL;
+	}
+
+	dap->packet_buffer = buf;
+	dap->packet_size = pkt_sz;
+	dap->packet_usable_size = pkt_sz;
+	dap->packet_buffer_size = packet_buffer_size;
+
+	dap->command = dap->packet_buffer + CMSIS_DAP_TCP_HEADER_SIZE;
+	dap->response = dap->packet_buffer + CMSIS_DAP_TCP_HEADER_SIZE;
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_tcp_free(struct cmsis_dap *dap)
+{
+	free(dap->packet_buffer);
+	dap->packet_buffer = NULL;
+	dap->command = NULL;
+	dap->response = NULL;
+}
+
+static void cmsis_dap_tcp_cancel_all(struct cmsis_dap *dap)
+{
+	/* Requests already sent can't be recalled, their responses
+	 * get drained by cmsis_dap_flush_read() */
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_host_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(cmsis_dap_tcp_host);
+	cmsis_dap_tcp_host = strdup(CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_port_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(u16, CMD_ARGV[0], cmsis_dap_tcp_port);
+	return ERROR_OK;
+}
+
+const struct command_registration cmsis_dap_tcp_subcommand_handlers[] = {
+	{
+		.name = "host",
+		.handler = &cmsis_dap_handle_tcp_host_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the host name or address of the adapter (for TCP backend only).\n"
+			"  if port is 0, this is the path of a unix socket.",
+		.usage = "<host_name>",
+	},
+	{
+		.name = "port",
+		.handler = &cmsis_dap_handle_tcp_port_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the TCP port of the adapter, 4441 by default (for TCP backend only).\n"
+			"  0 selects a unix socket named by host.",
+		.usage = "<port_number>",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct cmsis_dap_backend cmsis_dap_tcp_backend = {
+	.name = "tcp",
+	.open = cmsis_dap_tcp_open,
+	.close = cmsis_dap_tcp_close,
+	.read = cmsis_dap_tcp_read,
+	.write = cmsis_dap_tcp_write,
+	.packet_buffer_alloc = cmsis_dap_tcp_alloc,
+	.packet_buffer_free = cmsis_dap_tcp_free,
+	.cancel_all = cmsis_dap_tcp_cancel_all,
+	.max_pending_requests = MAX_PENDING_REQUESTS_STREAM,
+};
@@ -675,4 +675,5 @@ const struct cmsis_dap_backend cmsis_dap_usb_backend = {
 	.packet_buffer_alloc = cmsis_dap_usb_alloc,
 	.packet_buffer_free = cmsis_dap_usb_free,
 	.cancel_all = cmsis_dap_usb_cancel_all,
+	.max_pending_requests = MAX_PENDING_REQUESTS,
 };
@@ -281,4 +281,5 @@ const struct cmsis_dap_backend cmsis_dap_hid_backend = {
 	.packet_buffer_alloc = cmsis_dap_hid_alloc,
 	.packet_buffer_free = cmsis_dap_hid_free,
 	.cancel_all = cmsis_dap_hid_cancel_all,
+	.max_pending_requests = MAX_PENDING_REQUESTS,
 };
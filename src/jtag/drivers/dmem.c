@@ -51,6 +51,9 @@ static uint32_t dmem_dap_ap_offset = 0x100;
 /* DAP error code. */
 static int dmem_dap_retval = ERROR_OK;
 
+/* Transfer MEM-AP buffers with direct loops over the mapped window */
+static bool dmem_bulk_transfers = true;
+
 /* AP Emulation Mode */
 static uint64_t dmem_emu_base_address;
 static uint64_t dmem_emu_size;
@@ -305,6 +308,163 @@ static int dmem_ap_q_write(struct adiv5_ap *ap, unsigned int reg, uint32_t data)
 	return ERROR_OK;
 }
 
+/*
+ * BULK MODE: MEM-AP buffer transfers are done synchronously in a single loop
+ * instead of going through the per-word TAR/DRW register emulation above.
+ * Only naturally aligned accesses of up to 32 bits are handled here, anything
+ * else is returned to the generic code with ERROR_NOT_IMPLEMENTED.
+ */
+static bool dmem_bulk_usable(struct adiv5_ap *ap, uint32_t size, target_addr_t address)
+{
+	if (!dmem_bulk_transfers || is_adiv6(ap->dap))
+		return false;
+
+	return (size == 1 || size == 2 || size == 4) && address % size == 0;
+}
+
+/* Make sure the accesses of a bulk transfer reached the device */
+static void dmem_bulk_barrier(void)
+{
+	__sync_synchronize();
+}
+
+/*
+ * Return the emulated window address of @count words starting at @address,
+ * or NULL if the transfer does not fit in the window.
+ */
+static volatile uint32_t *dmem_emu_bulk_ptr(target_addr_t address, uint32_t count)
+{
+	address &= ~ARM_APB_PADDR31;
+
+	if (address >= dmem_emu_size || count > (dmem_emu_size - address) / 4) {
+		LOG_ERROR("dmem: emulated access at 0x%" TARGET_PRIxADDR " outside the window",
+				  address);
+		return NULL;
+	}
+
+	return (volatile uint32_t *)((uintptr_t)dmem_emu_virt_base_addr + address);
+}
+
+static void dmem_ap_bulk_setup(struct adiv5_ap *ap, uint32_t size, bool addrinc)
+{
+	uint32_t csw = ap->csw_default;
+
+	if (size == 4)
+		csw |= CSW_32BIT;
+	else if (size == 2)
+		csw |= CSW_16BIT;
+	else
+		csw |= CSW_8BIT;
+
+	csw |= addrinc ? CSW_ADDRINC_SINGLE : CSW_ADDRINC_OFF;
+
+	dmem_set_ap_reg(ap, MEM_AP_REG_CSW(ap->dap), csw);
+}
+
+static void dmem_ap_bulk_set_tar(struct adiv5_ap *ap, target_addr_t address)
+{
+	dmem_set_ap_reg(ap, MEM_AP_REG_TAR(ap->dap), (uint32_t)address);
+	if (is_64bit_ap(ap))
+		dmem_set_ap_reg(ap, MEM_AP_REG_TAR64(ap->dap), (uint32_t)(address >> 32));
+}
+
+/*
+ * TAR auto-increment is only guaranteed within tar_autoincr_block, so TAR
+ * gets reloaded whenever an incrementing transfer crosses such a boundary.
+ */
+static bool dmem_ap_bulk_reload_tar(struct adiv5_ap *ap, uint32_t i,
+		target_addr_t address, bool addrinc)
+{
+	return i == 0 || (addrinc && (address & (ap->tar_autoincr_block - 1)) == 0);
+}
+
+static int dmem_mem_ap_read_buf(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size,
+		uint32_t count, target_addr_t address, bool addrinc)
+{
+	unsigned int idx;
+
+	if (!dmem_bulk_usable(ap, size, address))
+		return ERROR_NOT_IMPLEMENTED;
+
+	if (dmem_is_emulated_ap(ap, &idx)) {
+		/* Emulated APs only do 32-bit accesses */
+		if (size != 4)
+			return ERROR_NOT_IMPLEMENTED;
+
+		volatile uint32_t *src = dmem_emu_bulk_ptr(address, addrinc ? count : 1);
+		if (!src)
+			return ERROR_FAIL;
+
+		for (uint32_t i = 0; i < count; i++)
+			h_u32_to_le(buffer + 4 * i, addrinc ? src[i] : src[0]);
+
+		return ERROR_OK;
+	}
+
+	dmem_ap_bulk_setup(ap, size, addrinc);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (dmem_ap_bulk_reload_tar(ap, i, address, addrinc))
+			dmem_ap_bulk_set_tar(ap, address);
+
+		uint32_t data = dmem_get_ap_reg(ap, MEM_AP_REG_DRW(ap->dap));
+
+		/* Pick the bytes from their lanes in DRW */
+		for (uint32_t j = 0; j < size; j++)
+			*buffer++ = data >> 8 * ((address + j) & 3);
+
+		if (addrinc)
+			address += size;
+	}
+
+	return ERROR_OK;
+}
+
+static int dmem_mem_ap_write_buf(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size,
+		uint32_t count, target_addr_t address, bool addrinc)
+{
+	unsigned int idx;
+
+	if (!dmem_bulk_usable(ap, size, address))
+		return ERROR_NOT_IMPLEMENTED;
+
+	if (dmem_is_emulated_ap(ap, &idx)) {
+		/* Emulated APs only do 32-bit accesses */
+		if (size != 4)
+			return ERROR_NOT_IMPLEMENTED;
+
+		volatile uint32_t *dst = dmem_emu_bulk_ptr(address, addrinc ? count : 1);
+		if (!dst)
+			return ERROR_FAIL;
+
+		for (uint32_t i = 0; i < count; i++)
+			dst[addrinc ? i : 0] = le_to_h_u32(buffer + 4 * i);
+
+		dmem_bulk_barrier();
+		return ERROR_OK;
+	}
+
+	dmem_ap_bulk_setup(ap, size, addrinc);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (dmem_ap_bulk_reload_tar(ap, i, address, addrinc))
+			dmem_ap_bulk_set_tar(ap, address);
+
+		/* Place the bytes in their lanes in DRW */
+		uint32_t data = 0;
+		for (uint32_t j = 0; j < size; j++)
+			data |= (uint32_t)*buffer++ << 8 * ((address + j) & 3);
+
+		dmem_set_ap_reg(ap, MEM_AP_REG_DRW(ap->dap), data);
+
+		if (addrinc)
+			address += size;
+	}
+
+	dmem_bulk_barrier();
+	return ERROR_OK;
+}
+
 static int dmem_ap_q_abort(struct adiv5_dap *dap, uint8_t *ack)
 {
 	return ERROR_OK;
@@ -394,6 +554,20 @@ COMMAND_HANDLER(dmem_emu_ap_list_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(dmem_bulk_transfers_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], dmem_bulk_transfers);
+
+	command_print(CMD, "dmem bulk transfers %s",
+				  dmem_bulk_transfers ? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(dmem_dap_config_info_command)
 {
 	if (CMD_ARGC != 0)
@@ -405,6 +579,7 @@ COMMAND_HANDLER(dmem_dap_config_info_command)
 	command_print(CMD, " Base Address : 0x%" PRIx64, dmem_dap_base_address);
 	command_print(CMD, " Max APs      : %u", dmem_dap_max_aps);
 	command_print(CMD, " AP offset    : 0x%08" PRIx32, dmem_dap_ap_offset);
+	command_print(CMD, " Bulk transfers : %s", dmem_bulk_transfers ? "on" : "off");
 	command_print(CMD, " Emulated AP Count : %u", dmem_emu_ap_count);
 
 	if (dmem_emu_ap_count) {
@@ -468,6 +643,13 @@ static const struct command_registration dmem_dap_subcommand_handlers[] = {
 		.help = "set the base address and size of emulated AP range (all emulated APs access this range)",
 		.usage = "base_address address_window_size",
 	},
+	{
+		.name = "bulk_transfers",
+		.handler = dmem_bulk_transfers_command,
+		.mode = COMMAND_ANY,
+		.help = "transfer MEM-AP buffers directly over the memory map (default: on)",
+		.usage = "[on|off]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -602,6 +784,8 @@ static const struct dap_ops dmem_dap_ops = {
 	.queue_ap_write = dmem_ap_q_write,
 	.queue_ap_abort = dmem_ap_q_abort,
 	.run = dmem_dp_run,
+	.mem_ap_read_buf = dmem_mem_ap_read_buf,
+	.mem_ap_write_buf = dmem_mem_ap_write_buf,
 };
 
 static const char *const dmem_dap_transport[] = { "dapdirect_swd", NULL };
@@ -113,6 +113,9 @@ static struct swd_cmd_queue_entry {
 } *swd_cmd_queue;
 static size_t swd_cmd_queue_length;
 static size_t swd_cmd_queue_alloced;
+/* transactions with OK ACK in the running and in the last executed queue */
+static size_t swd_cmd_queue_completed;
+static size_t swd_cmd_queue_last_completed;
 static int queued_retval;
 static int freq;
 
@@ -1107,13 +1110,15 @@ static int ftdi_swd_run_queue(void)
 
 			if (parity != parity_u32(data)) {
 				LOG_ERROR("SWD Read data parity mismatch");
-				queued_retval = ERROR_FAIL;
+				queued_retval = ERROR_SWD_FAIL;
 				goto skip;
 			}
 
 			if (swd_cmd_queue[i].dst)
 				*swd_cmd_queue[i].dst = data;
 		}
+
+		swd_cmd_queue_completed++;
 	}
 
 skip:
@@ -1128,6 +1133,21 @@ skip:
 	return retval;
 }
 
+static int ftdi_swd_run(void)
+{
+	/* the queue may have been partially executed already when it grew,
+	 * count the completed transactions over the whole batch */
+	int retval = ftdi_swd_run_queue();
+	swd_cmd_queue_last_completed = swd_cmd_queue_completed;
+	swd_cmd_queue_completed = 0;
+	return retval;
+}
+
+static unsigned int ftdi_swd_completed_count(void)
+{
+	return swd_cmd_queue_last_completed;
+}
+
 static void ftdi_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32_t ap_delay_clk)
 {
 	if (swd_cmd_queue_length >= swd_cmd_queue_alloced) {
@@ -1244,7 +1264,8 @@ static const struct swd_driver ftdi_swd = {
 	.switch_seq = ftdi_swd_switch_seq,
 	.read_reg = ftdi_swd_read_reg,
 	.write_reg = ftdi_swd_write_reg,
-	.run = ftdi_swd_run_queue,
+	.run = ftdi_swd_run,
+	.completed_count = ftdi_swd_completed_count,
 };
 
 static const char * const ftdi_transports[] = { "jtag", "swd", NULL };
@@ -2196,7 +2196,7 @@ static int jlink_swd_run_queue(void)
 
 			if (parity != parity_u32(data)) {
 				LOG_ERROR("SWD: Read data parity mismatch");
-				queued_retval = ERROR_FAIL;
+				queued_retval = ERROR_SWD_FAIL;
 				goto skip;
 			}
 
@@ -16,6 +16,8 @@
 #endif
 
 #include <jtag/interface.h>
+#include <helper/bits.h>
+#include <helper/nvp.h>
 #ifdef HAVE_ARPA_INET_H
 #include <arpa/inet.h>
 #endif
@@ -27,8 +29,55 @@
 #define SERVER_ADDRESS	"127.0.0.1"
 #define SERVER_PORT	5555
 
+/*
+ * Protocol version 2 is a framed binary stream. The client queues any number
+ * of records, each one an opcode byte followed by little endian arguments,
+ * and closes the batch with DPI_CMD_FLUSH. The server answers a batch with
+ * the captured bits of every scan that asked for them, in queue order,
+ * followed by a single DPI_ACK byte. See contrib/jtag_dpi for a reference
+ * implementation.
+ */
+#define DPI_HELLO		"vers 2\n"
+#define DPI_HELLO_REPLY		"OK2\n"
+#define DPI_HELLO_TIMEOUT_MS	500
+
+/* flags (u8), num_bits (u32), TDI bits: shift from Run-Test/Idle back to Run-Test/Idle */
+#define DPI_CMD_SCAN		'S'
+/* num_bits (u32), TMS bits, TDI held low */
+#define DPI_CMD_TMS		'T'
+/* num_cycles (u32) with TMS low */
+#define DPI_CMD_RUNTEST		'R'
+/* reserved (u32, zero): pulse TRST and move to Run-Test/Idle */
+#define DPI_CMD_RESET		'Z'
+/* execute everything queued, then send the captured data and DPI_ACK */
+#define DPI_CMD_FLUSH		'F'
+#define DPI_ACK			'K'
+
+#define DPI_SCAN_IR		BIT(0)
+#define DPI_SCAN_CAPTURE	BIT(1)
+
+/* keep batches bounded, neither side needs the whole queue in memory */
+#define DPI_BATCH_MAX		(1024 * 1024)
+
+enum jtag_dpi_protocol {
+	JTAG_DPI_PROTOCOL_AUTO,
+	JTAG_DPI_PROTOCOL_LINE,
+	JTAG_DPI_PROTOCOL_FRAMED,
+};
+
+static const struct nvp nvp_jtag_dpi_protocol[] = {
+	{ .name = "auto",   .value = JTAG_DPI_PROTOCOL_AUTO },
+	{ .name = "line",   .value = JTAG_DPI_PROTOCOL_LINE },
+	{ .name = "framed", .value = JTAG_DPI_PROTOCOL_FRAMED },
+	{ .name = NULL,     .value = -1 },
+};
+
 static uint16_t server_port = SERVER_PORT;
 static char *server_address;
+/* protocol requested by the configuration */
+static enum jtag_dpi_protocol protocol = JTAG_DPI_PROTOCOL_AUTO;
+/* protocol in use on the current connection, never AUTO */
+static enum jtag_dpi_protocol active_protocol = JTAG_DPI_PROTOCOL_LINE;
 
 static int sockfd;
 static struct sockaddr_in serv_addr;
@@ -36,6 +85,18 @@ static struct sockaddr_in serv_addr;
 static uint8_t *last_ir_buf;
 static int last_ir_num_bits;
 
+/* framed protocol: pending batch and the scans waiting for captured data */
+struct jtag_dpi_capture {
+	struct scan_command *cmd;
+	size_t offset;
+};
+
+static uint8_t *batch;
+static size_t batch_len, batch_size;
+static struct jtag_dpi_capture *captures;
+static size_t num_captures, captures_size;
+static size_t capture_len;
+
 static int write_sock(char *buf, size_t len)
 {
 	if (!buf) {
@@ -66,6 +127,212 @@ static int read_sock(char *buf, size_t len)
 	return ERROR_OK;
 }
 
+static int read_sock_all(uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = read(sockfd, buf, len);
+		if (n <= 0) {
+			LOG_ERROR("%s: %s", __func__,
+				n == 0 ? "connection closed by the DPI server" : strerror(errno));
+			return ERROR_FAIL;
+		}
+		buf += n;
+		len -= n;
+	}
+	return ERROR_OK;
+}
+
+static int jtag_dpi_batch_append(const void *data, size_t len)
+{
+	if (batch_len + len > batch_size) {
+		size_t size = MAX(batch_size * 2, batch_len + len + 256);
+		uint8_t *p = realloc(batch, size);
+		if (!p) {
+			LOG_ERROR("%s: out of memory", __func__);
+			return ERROR_FAIL;
+		}
+		batch = p;
+		batch_size = size;
+	}
+	memcpy(batch + batch_len, data, len);
+	batch_len += len;
+	return ERROR_OK;
+}
+
+static int jtag_dpi_batch_cmd(uint8_t op, uint32_t arg)
+{
+	uint8_t rec[5];
+
+	rec[0] = op;
+	h_u32_to_le(rec + 1, arg);
+	return jtag_dpi_batch_append(rec, sizeof(rec));
+}
+
+/**
+ * Send the pending batch, wait for the server to execute it and hand the
+ * captured bits back to the scan commands that asked for them.
+ */
+static int jtag_dpi_batch_flush(void)
+{
+	uint8_t *resp = NULL;
+	uint8_t op = DPI_CMD_FLUSH;
+	int ret;
+
+	if (batch_len == 0)
+		return ERROR_OK;
+
+	ret = jtag_dpi_batch_append(&op, 1);
+	if (ret != ERROR_OK)
+		goto out;
+
+	LOG_DEBUG_IO("DPI batch: %zu bytes out, %zu scans / %zu bytes captured",
+		batch_len, num_captures, capture_len);
+
+	ret = write_sock((char *)batch, batch_len);
+	if (ret != ERROR_OK)
+		goto out;
+
+	resp = malloc(capture_len + 1);
+	if (!resp) {
+		LOG_ERROR("%s: out of memory", __func__);
+		ret = ERROR_FAIL;
+		goto out;
+	}
+	ret = read_sock_all(resp, capture_len + 1);
+	if (ret != ERROR_OK)
+		goto out;
+	if (resp[capture_len] != DPI_ACK) {
+		LOG_ERROR("DPI server out of sync (got 0x%02x instead of ack)", resp[capture_len]);
+		ret = ERROR_FAIL;
+		goto out;
+	}
+
+	for (size_t i = 0; i < num_captures && ret == ERROR_OK; i++)
+		ret = jtag_read_buffer(resp + captures[i].offset, captures[i].cmd);
+
+out:
+	free(resp);
+	batch_len = 0;
+	num_captures = 0;
+	capture_len = 0;
+	return ret;
+}
+
+static int jtag_dpi_batch_scan(struct scan_command *cmd)
+{
+	uint8_t *data_buf;
+	uint8_t flags = 0;
+	int num_bits, bytes;
+	int ret;
+
+	num_bits = jtag_build_buffer(cmd, &data_buf);
+	if (!data_buf) {
+		LOG_ERROR("jtag_build_buffer call failed, data_buf == NULL");
+		return ERROR_FAIL;
+	}
+	bytes = DIV_ROUND_UP(num_bits, 8);
+
+	if (cmd->ir_scan)
+		flags |= DPI_SCAN_IR;
+	/* only fields that want their input back cost response bytes */
+	if (jtag_scan_type(cmd) & SCAN_IN) {
+		if (num_captures == captures_size) {
+			size_t size = MAX(captures_size * 2, 64);
+			struct jtag_dpi_capture *p = realloc(captures, size * sizeof(*p));
+			if (!p) {
+				LOG_ERROR("%s: out of memory", __func__);
+				ret = ERROR_FAIL;
+				goto out;
+			}
+			captures = p;
+			captures_size = size;
+		}
+		captures[num_captures].cmd = cmd;
+		captures[num_captures].offset = capture_len;
+		num_captures++;
+		capture_len += bytes;
+		flags |= DPI_SCAN_CAPTURE;
+	}
+
+	ret = jtag_dpi_batch_append(&(uint8_t){DPI_CMD_SCAN}, 1);
+	if (ret == ERROR_OK)
+		ret = jtag_dpi_batch_cmd(flags, num_bits);
+	if (ret == ERROR_OK)
+		ret = jtag_dpi_batch_append(data_buf, bytes);
+
+out:
+	free(data_buf);
+	return ret;
+}
+
+static int jtag_dpi_batch_tms(const uint8_t *bits, unsigned int num_bits)
+{
+	enum tap_state cur = tap_get_state();
+
+	for (unsigned int i = 0; i < num_bits; i++)
+		cur = tap_state_transition(cur, buf_get_u32(bits, i, 1));
+	tap_set_state(cur);
+
+	int ret = jtag_dpi_batch_cmd(DPI_CMD_TMS, num_bits);
+	if (ret != ERROR_OK)
+		return ret;
+	return jtag_dpi_batch_append(bits, DIV_ROUND_UP(num_bits, 8));
+}
+
+static int jtag_dpi_batch_pathmove(struct pathmove_command *cmd)
+{
+	uint8_t bits[DIV_ROUND_UP(32, 8)];
+	enum tap_state cur = tap_get_state();
+	unsigned int n = 0;
+	int ret;
+
+	/* the server only knows TMS sequences */
+	for (unsigned int i = 0; i < cmd->num_states; i++) {
+		if (n == 32) {
+			ret = jtag_dpi_batch_tms(bits, n);
+			if (ret != ERROR_OK)
+				return ret;
+			n = 0;
+		}
+		if (tap_state_transition(cur, false) == cmd->path[i]) {
+			buf_set_u32(bits, n, 1, 0);
+		} else if (tap_state_transition(cur, true) == cmd->path[i]) {
+			buf_set_u32(bits, n, 1, 1);
+		} else {
+			LOG_ERROR("BUG: %s -> %s isn't a valid TAP transition",
+				tap_state_name(cur), tap_state_name(cmd->path[i]));
+			return ERROR_FAIL;
+		}
+		n++;
+		cur = cmd->path[i];
+	}
+
+	return n ? jtag_dpi_batch_tms(bits, n) : ERROR_OK;
+}
+
+/*
+ * Scan and runtest records shift from Run-Test/Idle back to Run-Test/Idle,
+ * while pathmove and TMS records can leave the TAP anywhere. Move the TAP to
+ * @a goal with a TMS record.
+ */
+static int jtag_dpi_batch_move(enum tap_state goal)
+{
+	enum tap_state cur = tap_get_state();
+	uint8_t bits[4];
+
+	if (cur == goal)
+		return ERROR_OK;
+
+	if (!tap_is_state_stable(cur) || !tap_is_state_stable(goal)) {
+		LOG_ERROR("BUG: can't move from %s to %s",
+			tap_state_name(cur), tap_state_name(goal));
+		return ERROR_FAIL;
+	}
+
+	buf_set_u32(bits, 0, 32, tap_get_tms_path(cur, goal));
+	return jtag_dpi_batch_tms(bits, tap_get_tms_path_len(cur, goal));
+}
+
 /**
  * jtag_dpi_reset - ask to reset the JTAG device
  * @param trst 1 if TRST is to be asserted
@@ -78,7 +345,12 @@ static int jtag_dpi_reset(int trst, int srst)
 
 	LOG_DEBUG_IO("JTAG DRIVER DEBUG: reset trst: %i srst %i", trst, srst);
 
-	if (trst == 1) {
+	if (trst == 1 && active_protocol == JTAG_DPI_PROTOCOL_FRAMED) {
+		/* may be called from within a queue, keep the stream ordered */
+		ret = jtag_dpi_batch_cmd(DPI_CMD_RESET, 0);
+		if (ret == ERROR_OK)
+			ret = jtag_dpi_batch_flush();
+	} else if (trst == 1) {
 		/* reset the JTAG TAP controller */
 		ret = write_sock(buf, strlen(buf));
 		if (ret != ERROR_OK) {
@@ -222,11 +494,79 @@ static int jtag_dpi_stableclocks(unsigned int num_cycles)
 	return jtag_dpi_runtest(num_cycles);
 }
 
+static int jtag_dpi_execute_queue_framed(struct jtag_command *cmd_queue)
+{
+	struct jtag_command *cmd;
+	int ret = ERROR_OK;
+
+	for (cmd = cmd_queue; ret == ERROR_OK && cmd; cmd = cmd->next) {
+		switch (cmd->type) {
+		case JTAG_RUNTEST:
+			ret = jtag_dpi_batch_move(TAP_IDLE);
+			if (ret == ERROR_OK)
+				ret = jtag_dpi_batch_cmd(DPI_CMD_RUNTEST, cmd->cmd.runtest->num_cycles);
+			if (ret == ERROR_OK)
+				ret = jtag_dpi_batch_move(cmd->cmd.runtest->end_state);
+			break;
+		case JTAG_STABLECLOCKS:
+			ret = jtag_dpi_batch_move(TAP_IDLE);
+			if (ret == ERROR_OK)
+				ret = jtag_dpi_batch_cmd(DPI_CMD_RUNTEST, cmd->cmd.stableclocks->num_cycles);
+			break;
+		case JTAG_TLR_RESET:
+			if (cmd->cmd.statemove->end_state == TAP_RESET) {
+				ret = jtag_dpi_batch_cmd(DPI_CMD_RESET, 0);
+				tap_set_state(TAP_IDLE);
+			}
+			break;
+		case JTAG_PATHMOVE:
+			ret = jtag_dpi_batch_pathmove(cmd->cmd.pathmove);
+			break;
+		case JTAG_TMS:
+			ret = jtag_dpi_batch_tms(cmd->cmd.tms->bits, cmd->cmd.tms->num_bits);
+			break;
+		case JTAG_SLEEP:
+			/* the delay has to happen between the surrounding commands */
+			ret = jtag_dpi_batch_flush();
+			jtag_sleep(cmd->cmd.sleep->us);
+			break;
+		case JTAG_SCAN:
+			/* the server shifts from Run-Test/Idle back to Run-Test/Idle */
+			ret = jtag_dpi_batch_move(TAP_IDLE);
+			if (ret == ERROR_OK)
+				ret = jtag_dpi_batch_scan(cmd->cmd.scan);
+			if (ret == ERROR_OK)
+				ret = jtag_dpi_batch_move(cmd->cmd.scan->end_state);
+			break;
+		default:
+			LOG_ERROR("BUG: unknown JTAG command type 0x%X",
+				  cmd->type);
+			ret = ERROR_FAIL;
+			break;
+		}
+
+		if (ret == ERROR_OK && batch_len >= DPI_BATCH_MAX)
+			ret = jtag_dpi_batch_flush();
+	}
+
+	if (ret == ERROR_OK)
+		return jtag_dpi_batch_flush();
+
+	/* drop whatever is left, the captures refer to this queue */
+	batch_len = 0;
+	num_captures = 0;
+	capture_len = 0;
+	return ret;
+}
+
 static int jtag_dpi_execute_queue(struct jtag_command *cmd_queue)
 {
 	struct jtag_command *cmd;
 	int ret = ERROR_OK;
 
+	if (active_protocol == JTAG_DPI_PROTOCOL_FRAMED)
+		return jtag_dpi_execute_queue_framed(cmd_queue);
+
 	for (cmd = cmd_queue; ret == ERROR_OK && cmd;
 	     cmd = cmd->next) {
 		switch (cmd->type) {
@@ -264,6 +604,57 @@ static int jtag_dpi_execute_queue(struct jtag_command *cmd_queue)
 	return ret;
 }
 
+/**
+ * Offer the framed protocol. Servers that only know the line protocol don't
+ * answer, so silence within the timeout means falling back to it.
+ */
+static int jtag_dpi_negotiate(void)
+{
+	char reply[sizeof(DPI_HELLO_REPLY) - 1];
+	size_t got = 0;
+
+	active_protocol = JTAG_DPI_PROTOCOL_LINE;
+	if (protocol == JTAG_DPI_PROTOCOL_LINE)
+		return ERROR_OK;
+
+	if (write_sock(DPI_HELLO, strlen(DPI_HELLO)) != ERROR_OK)
+		return ERROR_FAIL;
+
+	while (got < sizeof(reply)) {
+		struct timeval tv = {
+			.tv_sec = DPI_HELLO_TIMEOUT_MS / 1000,
+			.tv_usec = (DPI_HELLO_TIMEOUT_MS % 1000) * 1000,
+		};
+		fd_set rfds;
+
+		FD_ZERO(&rfds);
+		FD_SET(sockfd, &rfds);
+		if (select(sockfd + 1, &rfds, NULL, NULL, &tv) <= 0)
+			break;
+		ssize_t n = read(sockfd, reply + got, sizeof(reply) - got);
+		if (n <= 0)
+			break;
+		got += n;
+	}
+
+	if (got == sizeof(reply) && !memcmp(reply, DPI_HELLO_REPLY, sizeof(reply))) {
+		active_protocol = JTAG_DPI_PROTOCOL_FRAMED;
+		LOG_INFO("DPI server supports the framed protocol");
+		return ERROR_OK;
+	}
+
+	if (got) {
+		LOG_ERROR("unexpected reply to the DPI protocol handshake");
+		return ERROR_FAIL;
+	}
+	if (protocol == JTAG_DPI_PROTOCOL_FRAMED) {
+		LOG_ERROR("DPI server doesn't support the framed protocol");
+		return ERROR_FAIL;
+	}
+	LOG_INFO("DPI server doesn't answer the handshake, using the line protocol");
+	return ERROR_OK;
+}
+
 static int jtag_dpi_init(void)
 {
 	sockfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -309,6 +700,11 @@ static int jtag_dpi_init(void)
 
 	LOG_INFO("Connection to %s : %" PRIu16 " succeed", server_address, server_port);
 
+	if (jtag_dpi_negotiate() != ERROR_OK) {
+		close(sockfd);
+		return ERROR_FAIL;
+	}
+
 	return ERROR_OK;
 }
 
@@ -316,6 +712,14 @@ static int jtag_dpi_quit(void)
 {
 	free(server_address);
 	server_address = NULL;
+	free(batch);
+	batch = NULL;
+	batch_len = 0;
+	batch_size = 0;
+	free(captures);
+	captures = NULL;
+	num_captures = 0;
+	captures_size = 0;
 
 	return close(sockfd);
 }
@@ -362,6 +766,22 @@ COMMAND_HANDLER(jtag_dpi_set_address)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_dpi_set_protocol)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		const struct nvp *n = nvp_name2value(nvp_jtag_dpi_protocol, CMD_ARGV[0]);
+		if (!n->name)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		protocol = n->value;
+	}
+
+	command_print(CMD, "%s", nvp_value2name(nvp_jtag_dpi_protocol, protocol)->name);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_dpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -377,6 +797,13 @@ static const struct command_registration jtag_dpi_subcommand_handlers[] = {
 		.help = "set the address of the DPI server",
 		.usage = "[address]",
 	},
+	{
+		.name = "protocol",
+		.handler = &jtag_dpi_set_protocol,
+		.mode = COMMAND_CONFIG,
+		.help = "select the protocol spoken to the DPI server",
+		.usage = "['auto'|'line'|'framed']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -415,7 +415,7 @@ static int spidev_swd_execute_queue(unsigned int end_idle_bytes)
 
 			if (parity != parity_u32(data)) {
 				LOG_ERROR("SWD Read data parity mismatch");
-				queue_retval = ERROR_FAIL;
+				queue_retval = ERROR_SWD_FAIL;
 				goto skip;
 			}
 
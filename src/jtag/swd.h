@@ -291,6 +291,19 @@ struct swd_driver {
 	 */
 	int (*run)(void);
 
+	/**
+	 * Optional. Report how many transactions of the most recently
+	 * executed queue completed with an OK ACK before the first WAIT,
+	 * FAULT or protocol error.
+	 *
+	 * With this information the transport can resume a queue which
+	 * stalled on a WAIT response from the failing transaction, instead
+	 * of failing the whole batch back to the caller.
+	 *
+	 * @return number of transactions completed by the last run().
+	 */
+	unsigned int (*completed_count)(void);
+
 	/**
 	 * Configures data collection from the Single-wire
 	 * trace (SWO) signal.
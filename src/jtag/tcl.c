@@ -218,6 +218,417 @@ COMMAND_HANDLER(handle_jtag_flush_count)
 	return ERROR_OK;
 }
 
+/*
+ * Deferred scans for "jtag queue": scans are only added to the JTAG queue,
+ * each one returns a handle, and "jtag queue flush" executes them all at
+ * once. The captured values stay available until the first scan queued
+ * after the flush starts a new batch.
+ */
+struct jtag_queued_scan {
+	unsigned int num_fields;
+	struct scan_field *fields;
+	/* optional check of all fields, first field in the least significant bits */
+	uint8_t *expected;
+	uint8_t *mask;
+};
+
+static struct {
+	struct jtag_queued_scan *scans;
+	unsigned int count;
+	unsigned int size;
+	bool flushed;
+} jtag_scan_queue;
+
+static void jtag_queued_scan_free(struct jtag_queued_scan *scan)
+{
+	for (unsigned int i = 0; i < scan->num_fields; i++)
+		free(scan->fields[i].in_value);
+	free(scan->fields);
+	free(scan->expected);
+	free(scan->mask);
+}
+
+static void jtag_scan_queue_clear(void)
+{
+	for (unsigned int i = 0; i < jtag_scan_queue.count; i++)
+		jtag_queued_scan_free(&jtag_scan_queue.scans[i]);
+
+	jtag_scan_queue.count = 0;
+	jtag_scan_queue.flushed = false;
+}
+
+static struct jtag_queued_scan *jtag_scan_queue_add(void)
+{
+	if (jtag_scan_queue.flushed)
+		jtag_scan_queue_clear();
+
+	if (jtag_scan_queue.count == jtag_scan_queue.size) {
+		unsigned int size = jtag_scan_queue.size ? 2 * jtag_scan_queue.size : 64;
+		struct jtag_queued_scan *scans = realloc(jtag_scan_queue.scans,
+				size * sizeof(*scans));
+		if (!scans) {
+			LOG_ERROR("Out of memory");
+			return NULL;
+		}
+		jtag_scan_queue.scans = scans;
+		jtag_scan_queue.size = size;
+	}
+
+	struct jtag_queued_scan *scan = &jtag_scan_queue.scans[jtag_scan_queue.count];
+	memset(scan, 0, sizeof(*scan));
+	return scan;
+}
+
+static unsigned int jtag_queued_scan_bits(const struct jtag_queued_scan *scan)
+{
+	unsigned int bits = 0;
+
+	for (unsigned int i = 0; i < scan->num_fields; i++)
+		bits += scan->fields[i].num_bits;
+	return bits;
+}
+
+/*
+ * Strip the trailing '-endstate' and '-expect' options of a queued scan.
+ * The expected value and mask can only be parsed once the fields are known.
+ */
+static COMMAND_HELPER(handle_jtag_queue_scan_options, enum tap_state *endstate,
+	const char **expected, const char **mask)
+{
+	*endstate = TAP_IDLE;
+	*expected = NULL;
+	*mask = NULL;
+
+	while (CMD_ARGC > 2) {
+		if (CMD_ARGC > 3 && !strcmp("-expect", CMD_ARGV[CMD_ARGC - 3])) {
+			*expected = CMD_ARGV[CMD_ARGC - 2];
+			*mask = CMD_ARGV[CMD_ARGC - 1];
+			CMD_ARGC -= 3;
+		} else if (!strcmp("-endstate", CMD_ARGV[CMD_ARGC - 2])) {
+			const char *state_name = CMD_ARGV[CMD_ARGC - 1];
+			*endstate = tap_state_by_name(state_name);
+			if (*endstate < 0) {
+				command_print(CMD, "endstate: %s invalid", state_name);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+			if (!scan_is_safe(*endstate))
+				LOG_WARNING("scan with unsafe endstate \"%s\"", state_name);
+			CMD_ARGC -= 2;
+		} else {
+			break;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static COMMAND_HELPER(handle_jtag_queue_scan_expect, struct jtag_queued_scan *scan,
+	const char *expected, const char *mask)
+{
+	if (!expected)
+		return ERROR_OK;
+
+	unsigned int bits = jtag_queued_scan_bits(scan);
+	scan->expected = calloc(1, DIV_ROUND_UP(bits, 8));
+	scan->mask = calloc(1, DIV_ROUND_UP(bits, 8));
+	if (!scan->expected || !scan->mask) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = CALL_COMMAND_HANDLER(command_parse_str_to_buf, expected,
+			scan->expected, bits);
+	if (retval == ERROR_OK)
+		retval = CALL_COMMAND_HANDLER(command_parse_str_to_buf, mask,
+				scan->mask, bits);
+	return retval;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_drscan)
+{
+	enum tap_state endstate;
+	const char *expected, *mask;
+
+	int retval = CALL_COMMAND_HANDLER(handle_jtag_queue_scan_options,
+			&endstate, &expected, &mask);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC < 3 || (CMD_ARGC % 2) != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct jtag_tap *tap = jtag_tap_by_string(CMD_ARGV[0]);
+	if (!tap) {
+		command_print(CMD, "Tap '%s' could not be found", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (tap->bypass) {
+		command_print(CMD, "Can't execute as the selected tap is in BYPASS");
+		return ERROR_FAIL;
+	}
+
+	struct jtag_queued_scan *scan = jtag_scan_queue_add();
+	if (!scan)
+		return ERROR_FAIL;
+
+	scan->num_fields = (CMD_ARGC - 1) / 2;
+	scan->fields = calloc(scan->num_fields, sizeof(struct scan_field));
+	if (!scan->fields) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = CALL_COMMAND_HANDLER(handle_jtag_command_drscan_fields, scan->fields);
+	if (retval == ERROR_OK)
+		retval = CALL_COMMAND_HANDLER(handle_jtag_queue_scan_expect, scan,
+				expected, mask);
+	if (retval != ERROR_OK) {
+		jtag_queued_scan_free(scan);
+		return retval;
+	}
+
+	jtag_add_dr_scan(tap, scan->num_fields, scan->fields, endstate);
+
+	command_print(CMD, "%u", jtag_scan_queue.count++);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_irscan)
+{
+	enum tap_state endstate;
+	const char *expected, *mask;
+
+	int retval = CALL_COMMAND_HANDLER(handle_jtag_queue_scan_options,
+			&endstate, &expected, &mask);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct jtag_tap *tap = jtag_tap_by_string(CMD_ARGV[0]);
+	if (!tap) {
+		command_print(CMD, "Tap '%s' could not be found", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	uint64_t value;
+	retval = parse_u64(CMD_ARGV[1], &value);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct jtag_queued_scan *scan = jtag_scan_queue_add();
+	if (!scan)
+		return ERROR_FAIL;
+
+	scan->num_fields = 1;
+	scan->fields = calloc(1, sizeof(struct scan_field));
+	if (!scan->fields) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	uint8_t *v = calloc(1, DIV_ROUND_UP(tap->ir_length, 8));
+	if (!v) {
+		LOG_ERROR("Out of memory");
+		jtag_queued_scan_free(scan);
+		return ERROR_FAIL;
+	}
+	buf_set_u64(v, 0, tap->ir_length, value);
+	scan->fields[0].num_bits = tap->ir_length;
+	scan->fields[0].out_value = v;
+	scan->fields[0].in_value = v;
+
+	retval = CALL_COMMAND_HANDLER(handle_jtag_queue_scan_expect, scan,
+			expected, mask);
+	if (retval != ERROR_OK) {
+		jtag_queued_scan_free(scan);
+		return retval;
+	}
+
+	jtag_add_ir_scan(tap, scan->fields, endstate);
+
+	command_print(CMD, "%u", jtag_scan_queue.count++);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_runtest)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int num_clocks;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], num_clocks);
+
+	jtag_add_runtest(num_clocks, TAP_IDLE);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_pathmove)
+{
+	enum tap_state states[8];
+
+	if (CMD_ARGC < 1 || CMD_ARGC > ARRAY_SIZE(states))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (unsigned int i = 0; i < CMD_ARGC; i++) {
+		states[i] = tap_state_by_name(CMD_ARGV[i]);
+		if (states[i] < 0) {
+			command_print(CMD, "endstate: %s invalid", CMD_ARGV[i]);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	int retval = jtag_add_statemove(states[0]);
+	if (retval != ERROR_OK)
+		return retval;
+
+	jtag_add_pathmove(CMD_ARGC - 1, states + 1);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_flush)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int retval = jtag_execute_queue();
+	jtag_scan_queue.flushed = true;
+	if (retval != ERROR_OK) {
+		command_print(CMD, "jtag queue flush: jtag execute failed");
+		return retval;
+	}
+
+	/* report the first scan that doesn't match its expected value */
+	for (unsigned int i = 0; i < jtag_scan_queue.count; i++) {
+		struct jtag_queued_scan *scan = &jtag_scan_queue.scans[i];
+
+		if (!scan->expected)
+			continue;
+
+		unsigned int bits = jtag_queued_scan_bits(scan);
+		uint8_t *captured = calloc(1, DIV_ROUND_UP(bits, 8));
+		if (!captured) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+
+		unsigned int offset = 0;
+		for (unsigned int j = 0; j < scan->num_fields; j++) {
+			buf_set_buf(scan->fields[j].in_value, 0, captured, offset,
+					scan->fields[j].num_bits);
+			offset += scan->fields[j].num_bits;
+		}
+
+		bool match = buf_eq_mask(captured, scan->expected, scan->mask, bits);
+		if (!match) {
+			char *got = buf_to_hex_str(captured, bits);
+			char *exp = buf_to_hex_str(scan->expected, bits);
+			char *msk = buf_to_hex_str(scan->mask, bits);
+			command_print(CMD, "scan %u: captured 0x%s, expected 0x%s, mask 0x%s",
+					i, got, exp, msk);
+			free(got);
+			free(exp);
+			free(msk);
+		}
+		free(captured);
+
+		if (!match)
+			return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_results)
+{
+	unsigned int first = 0, last = jtag_scan_queue.count;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!jtag_scan_queue.flushed) {
+		command_print(CMD, "jtag queue results: the queue has not been flushed");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], first);
+		if (first >= jtag_scan_queue.count) {
+			command_print(CMD, "jtag queue results: no scan %u", first);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		last = first + 1;
+	}
+
+	for (unsigned int i = first; i < last; i++) {
+		struct jtag_queued_scan *scan = &jtag_scan_queue.scans[i];
+
+		for (unsigned int j = 0; j < scan->num_fields; j++) {
+			char *str = buf_to_hex_str(scan->fields[j].in_value,
+					scan->fields[j].num_bits);
+			command_print(CMD, "%s", str);
+			free(str);
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration jtag_queue_command_handlers[] = {
+	{
+		.name = "drscan",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_drscan,
+		.help = "Queue a Data Register (DR) scan for one TAP and "
+			"return its handle. Other TAPs must be in BYPASS mode.",
+		.usage = "tap_name (num_bits value)+ ['-endstate' state_name] "
+			"['-expect' expected mask]",
+	},
+	{
+		.name = "irscan",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_irscan,
+		.help = "Queue an Instruction Register (IR) scan for one TAP "
+			"and return its handle. Other TAPs are put in BYPASS.",
+		.usage = "tap_name instruction ['-endstate' state_name] "
+			"['-expect' expected mask]",
+	},
+	{
+		.name = "runtest",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_runtest,
+		.help = "Queue a move to Run-Test/Idle and num_cycles TCK cycles.",
+		.usage = "num_cycles",
+	},
+	{
+		.name = "pathmove",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_pathmove,
+		.help = "Queue a move of the JTAG state machine to "
+			"start_state, then state1, state2, etc.",
+		.usage = "start_state state1 [state2 [state3 ...]]",
+	},
+	{
+		.name = "flush",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_flush,
+		.help = "Execute the queued operations and check the "
+			"captured values against the expected ones.",
+		.usage = "",
+	},
+	{
+		.name = "results",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_results,
+		.help = "Return the values captured by all scans since the "
+			"last flush, or by the given scan, one per field.",
+		.usage = "[handle]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 /* REVISIT Just what about these should "move" ... ?
  * These registrations, into the main JTAG table?
  *
@@ -774,6 +1185,14 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.help = "Returns list of all JTAG tap names.",
 		.usage = "",
 	},
+	{
+		.name = "queue",
+		.mode = COMMAND_EXEC,
+		.help = "Queue scans, execute them with a single flush and "
+			"fetch their results afterwards.",
+		.usage = "",
+		.chain = jtag_queue_command_handlers,
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
@@ -151,45 +151,41 @@ static int freertos_update_threads(struct rtos *rtos)
 		return -2;
 	}
 
-	uint32_t thread_list_size = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
-			&thread_list_size);
-	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
-										rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
-										thread_list_size);
-
+	/* read the thread count, the current thread, the scheduler state and
+	 * the top used priority in one go */
+	uint8_t globals_buf[4][4];
+	struct target_memory_gather globals[] = {
+		{ rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address, 4, 1, globals_buf[0] },
+		{ rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address, 4, 1, globals_buf[1] },
+		{ rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address, 4, 1, globals_buf[2] },
+		{ rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address, 4, 1, globals_buf[3] },
+	};
+	unsigned int num_globals = ARRAY_SIZE(globals);
+	if (rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address == 0)
+		num_globals--;
+
+	retval = target_read_memory_gather(rtos->target, globals, num_globals);
 	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read FreeRTOS thread count from target");
+		LOG_ERROR("Could not read FreeRTOS thread count and scheduler state from target");
 		return retval;
 	}
 
+	uint32_t thread_list_size = target_buffer_get_u32(rtos->target, globals_buf[0]);
+	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
+										rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
+										thread_list_size);
+
 	/* wipe out previous thread details if any */
 	rtos_free_threadlist(rtos);
 
 	/* read the current thread */
-	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
-			&pointer_casts_are_bad);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
-		return retval;
-	}
-	rtos->current_thread = pointer_casts_are_bad;
+	rtos->current_thread = target_buffer_get_u32(rtos->target, globals_buf[1]);
 	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64,
 										rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
 										rtos->current_thread);
 
 	/* read scheduler running */
-	uint32_t scheduler_running;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
-			&scheduler_running);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading FreeRTOS scheduler state");
-		return retval;
-	}
+	uint32_t scheduler_running = target_buffer_get_u32(rtos->target, globals_buf[2]);
 	LOG_DEBUG("FreeRTOS: Read xSchedulerRunning at 0x%" PRIx64 ", value 0x%" PRIx32,
 										rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
 										scheduler_running);
@@ -233,12 +229,7 @@ static int freertos_update_threads(struct rtos *rtos)
 		LOG_ERROR("FreeRTOS: uxTopUsedPriority is not defined, consult the OpenOCD manual for a work-around");
 		return ERROR_FAIL;
 	}
-	uint32_t top_used_priority = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
-			&top_used_priority);
-	if (retval != ERROR_OK)
-		return retval;
+	uint32_t top_used_priority = target_buffer_get_u32(rtos->target, globals_buf[3]);
 	LOG_DEBUG("FreeRTOS: Read uxTopUsedPriority at 0x%" PRIx64 ", value %" PRIu32,
 										rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
 										top_used_priority);
@@ -273,83 +264,70 @@ static int freertos_update_threads(struct rtos *rtos)
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
 
+	/* Read the number of threads and the location of the first item of all
+	 * lists at once */
+	struct target_memory_gather *items = calloc(2 * num_lists, sizeof(*items));
+	uint8_t (*list_buf)[2][4] = calloc(num_lists, sizeof(*list_buf));
+	if (!items || !list_buf) {
+		LOG_ERROR("Error allocating memory for %u priorities", config_max_priorities);
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	unsigned int num_items = 0;
 	for (unsigned int i = 0; i < num_lists; i++) {
 		if (list_of_lists[i] == 0)
 			continue;
+		items[num_items++] = (struct target_memory_gather){ list_of_lists[i], 4, 1, list_buf[i][0] };
+		items[num_items++] = (struct target_memory_gather){
+			list_of_lists[i] + param->list_next_offset, 4, 1, list_buf[i][1] };
+	}
+	retval = target_read_memory_gather(rtos->target, items, num_items);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading FreeRTOS thread lists");
+		goto out;
+	}
 
-		/* Read the number of threads in this list */
-		uint32_t list_thread_count = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i],
-				&list_thread_count);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading number of threads in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
+	unsigned int first_task = tasks_found;
+	for (unsigned int i = 0; i < num_lists; i++) {
+		if (list_of_lists[i] == 0)
+			continue;
+
+		uint32_t list_thread_count = target_buffer_get_u32(rtos->target, list_buf[i][0]);
 		LOG_DEBUG("FreeRTOS: Read thread count for list %u at 0x%" PRIx64 ", value %" PRIu32,
 										i, list_of_lists[i], list_thread_count);
 
 		if (list_thread_count == 0)
 			continue;
 
-		/* Read the location of first list item */
 		uint32_t prev_list_elem_ptr = -1;
-		uint32_t list_elem_ptr = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i] + param->list_next_offset,
-				&list_elem_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
+		uint32_t list_elem_ptr = target_buffer_get_u32(rtos->target, list_buf[i][1]);
 		LOG_DEBUG("FreeRTOS: Read first item for list %u at 0x%" PRIx64 ", value 0x%" PRIx32,
 										i, list_of_lists[i] + param->list_next_offset, list_elem_ptr);
 
 		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
 				(list_elem_ptr != prev_list_elem_ptr) &&
 				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			retval = target_read_u32(rtos->target,
-					list_elem_ptr + param->list_elem_content_offset,
-					&pointer_casts_are_bad);
+			/* Get the location of the thread structure and of the next item */
+			uint8_t elem_buf[2][4];
+			const struct target_memory_gather elem[] = {
+				{ list_elem_ptr + param->list_elem_content_offset, 4, 1, elem_buf[0] },
+				{ list_elem_ptr + param->list_elem_next_offset, 4, 1, elem_buf[1] },
+			};
+			retval = target_read_memory_gather(rtos->target, elem, ARRAY_SIZE(elem));
 			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
+				LOG_ERROR("Error reading thread list item in FreeRTOS thread list");
+				/* still name the threads found so far */
+				goto names;
 			}
-			rtos->thread_details[tasks_found].threadid = pointer_casts_are_bad;
+			rtos->thread_details[tasks_found].threadid =
+				target_buffer_get_u32(rtos->target, elem_buf[0]);
 			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx64,
 										list_elem_ptr + param->list_elem_content_offset,
 										rtos->thread_details[tasks_found].threadid);
 
-			/* get thread name */
-
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
-
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
-
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
-			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
+			/* the name is read for all threads at once below */
+			rtos->thread_details[tasks_found].thread_name_str = NULL;
 			rtos->thread_details[tasks_found].exists = true;
 
 			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
@@ -366,23 +344,61 @@ static int freertos_update_threads(struct rtos *rtos)
 			rtos->thread_count = tasks_found;
 
 			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
+			list_elem_ptr = target_buffer_get_u32(rtos->target, elem_buf[1]);
 			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx32 ", value 0x%" PRIx32,
 										prev_list_elem_ptr + param->list_elem_next_offset,
 										list_elem_ptr);
 		}
 	}
 
+names:
+	/* get thread names */
+
+	#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+	int walk_retval = retval;
+	unsigned int num_names = tasks_found - first_task;
+	char (*names)[FREERTOS_THREAD_NAME_STR_SIZE] = calloc(num_names ? num_names : 1, sizeof(*names));
+	struct target_memory_gather *name_items = calloc(num_names ? num_names : 1, sizeof(*name_items));
+	if (!names || !name_items) {
+		free(names);
+		free(name_items);
+		LOG_ERROR("Error allocating memory for %u thread names", num_names);
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	for (unsigned int i = 0; i < num_names; i++)
+		name_items[i] = (struct target_memory_gather){
+			rtos->thread_details[first_task + i].threadid + param->thread_name_offset,
+			1, FREERTOS_THREAD_NAME_STR_SIZE, (uint8_t *)names[i] };
+
+	/* names that can't be read are left empty */
+	retval = target_read_memory_gather(rtos->target, name_items, num_names);
+	if (retval != ERROR_OK)
+		LOG_ERROR("Error reading thread names in FreeRTOS thread list");
+	if (walk_retval != ERROR_OK)
+		retval = walk_retval;
+
+	for (unsigned int i = 0; i < num_names; i++) {
+		char *tmp_str = names[i];
+		tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
+		LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
+										name_items[i].address, tmp_str);
+
+		if (tmp_str[0] == '\x00')
+			strcpy(tmp_str, "No Name");
+
+		rtos->thread_details[first_task + i].thread_name_str = strdup(tmp_str);
+	}
+
+	free(names);
+	free(name_items);
+
+out:
+	free(items);
+	free(list_buf);
 	free(list_of_lists);
-	return 0;
+	return retval;
 }
 
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
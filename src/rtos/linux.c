@@ -134,6 +134,24 @@ static int linux_read_memory(struct target *target,
 	return ERROR_OK;
 }
 
+static int linux_read_memory_gather(struct target *target,
+	const struct target_memory_gather *items, unsigned int num_items)
+{
+	for (unsigned int i = 0; i < num_items; i++) {
+		if (items[i].address < 0xc0000000) {
+			LOG_ERROR("linux awareness : address in user space");
+			return ERROR_FAIL;
+		}
+	}
+#ifdef PHYS
+	for (unsigned int i = 0; i < num_items; i++)
+		linux_read_memory(target, items[i].address, items[i].size,
+			items[i].count, items[i].buffer);
+	return ERROR_OK;
+#endif
+	return target_read_memory_gather(target, items, num_items);
+}
+
 static int fill_buffer(struct target *target, uint32_t addr, uint8_t *buffer)
 {
 
@@ -283,55 +301,38 @@ int fill_task_pid(struct target *target, struct threads *t)
 static int fill_task(struct target *target, struct threads *t)
 {
 	int retval;
-	uint32_t pid_addr = t->base_addr + PID;
-	uint32_t mem_addr = t->base_addr + MEM;
-	uint32_t on_cpu = t->base_addr + ONCPU;
-	uint8_t *buffer = calloc(1, 4);
-	retval = fill_buffer(target, t->base_addr, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->state = val;
-	} else
-		LOG_ERROR("fill_task: unable to read memory");
-
-	retval = fill_buffer(target, pid_addr, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->pid = val;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
-
-	retval = fill_buffer(target, on_cpu, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->oncpu = val;
-	} else
+	uint8_t buffer[4][4];
+	const struct target_memory_gather items[] = {
+		{ t->base_addr, 4, 1, buffer[0] },
+		{ t->base_addr + PID, 4, 1, buffer[1] },
+		{ t->base_addr + ONCPU, 4, 1, buffer[2] },
+		{ t->base_addr + MEM, 4, 1, buffer[3] },
+	};
+
+	retval = linux_read_memory_gather(target, items, ARRAY_SIZE(items));
+	if (retval != ERROR_OK) {
 		LOG_ERROR("fill task: unable to read memory");
+		return retval;
+	}
 
-	retval = fill_buffer(target, mem_addr, buffer);
+	t->state = get_buffer(target, buffer[0]);
+	t->pid = get_buffer(target, buffer[1]);
+	t->oncpu = get_buffer(target, buffer[2]);
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
+	uint32_t val = get_buffer(target, buffer[3]);
 
-		if (val != 0) {
-			uint32_t asid_addr = val + MM_CTX;
-			retval = fill_buffer(target, asid_addr, buffer);
+	if (val != 0) {
+		uint32_t asid_addr = val + MM_CTX;
+		retval = fill_buffer(target, asid_addr, buffer[0]);
 
-			if (retval == ERROR_OK) {
-				val = get_buffer(target, buffer);
-				t->asid = val;
-			} else
-				LOG_ERROR
-					("fill task: unable to read memory -- ASID");
+		if (retval == ERROR_OK) {
+			val = get_buffer(target, buffer[0]);
+			t->asid = val;
 		} else
-			t->asid = 0;
+			LOG_ERROR
+				("fill task: unable to read memory -- ASID");
 	} else
-		LOG_ERROR("fill task: unable to read memory");
-
-	free(buffer);
+		t->asid = 0;
 
 	return retval;
 }
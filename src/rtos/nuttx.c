@@ -158,8 +158,7 @@ static int nuttx_update_threads(struct rtos *rtos)
 {
 	struct tcbinfo tcbinfo;
 	uint32_t pidhashaddr, npidhash, tcbaddr;
-	uint16_t pid;
-	uint8_t state;
+	uint8_t *tcbs = NULL;
 
 	if (!rtos->symbols) {
 		LOG_ERROR("No symbols for nuttx");
@@ -172,27 +171,49 @@ static int nuttx_update_threads(struct rtos *rtos)
 	/* NuttX provides a hash table that keeps track of all the TCBs.
 	 * We first read its size from g_npidhash and its address from g_pidhash.
 	 * Its content is then read from these values.
+	 * NuttX also provides a struct that contains TCB offsets for required
+	 * members in g_tcbinfo, and the head of the g_readytorun list is the
+	 * currently running task. All of these are fetched in one go.
 	 */
-	int ret = target_read_u32(rtos->target, rtos->symbols[NX_SYM_NPIDHASH].address, &npidhash);
+	uint8_t npidhash_buf[4], pidhashaddr_buf[4], current_thread_buf[4];
+	uint8_t buff[TCBINFO_TARGET_SIZE];
+	const struct target_memory_gather globals[] = {
+		{ rtos->symbols[NX_SYM_NPIDHASH].address, 4, 1, npidhash_buf },
+		{ rtos->symbols[NX_SYM_PIDHASH].address, 4, 1, pidhashaddr_buf },
+		{ rtos->symbols[NX_SYM_TCB_INFO].address, 1, sizeof(buff), buff },
+		{ rtos->symbols[NX_SYM_READYTORUN].address, 4, 1, current_thread_buf },
+	};
+	int ret = target_read_memory_gather(rtos->target, globals, ARRAY_SIZE(globals));
 	if (ret != ERROR_OK) {
-		LOG_ERROR("Failed to read g_npidhash: ret = %d", ret);
+		LOG_ERROR("Failed to read g_npidhash, g_pidhash, g_tcbinfo or g_readytorun: ret = %d", ret);
 		return ERROR_FAIL;
 	}
 
+	npidhash = target_buffer_get_u32(rtos->target, npidhash_buf);
 	LOG_DEBUG("Hash table size (g_npidhash) = %" PRId32, npidhash);
 
-	ret = target_read_u32(rtos->target, rtos->symbols[NX_SYM_PIDHASH].address, &pidhashaddr);
-	if (ret != ERROR_OK) {
-		LOG_ERROR("Failed to read g_pidhash address: ret = %d", ret);
-		return ERROR_FAIL;
-	}
-
+	pidhashaddr = target_buffer_get_u32(rtos->target, pidhashaddr_buf);
 	LOG_DEBUG("Hash table address (g_pidhash) = %" PRIx32, pidhashaddr);
 
+	tcbinfo.pid_off = target_buffer_get_u16(rtos->target, buff);
+	tcbinfo.state_off = target_buffer_get_u16(rtos->target, buff + 2);
+	tcbinfo.pri_off = target_buffer_get_u16(rtos->target, buff + 4);
+	tcbinfo.name_off = target_buffer_get_u16(rtos->target, buff + 6);
+	tcbinfo.regs_off = target_buffer_get_u16(rtos->target, buff + 8);
+	tcbinfo.basic_num = target_buffer_get_u16(rtos->target, buff + 10);
+	tcbinfo.total_num = target_buffer_get_u16(rtos->target, buff + 12);
+	tcbinfo.xcpreg_off = target_buffer_get_addr(rtos->target, buff + 14);
+
+	/* Reading in a temporary variable first to avoid endianness issues,
+	 * rtos->current_thread is int64_t. */
+	rtos->current_thread = target_buffer_get_u32(rtos->target, current_thread_buf);
+
 	uint8_t *pidhash = malloc(npidhash * PTR_WIDTH);
-	if (!pidhash) {
+	struct target_memory_gather *items = calloc(npidhash, 3 * sizeof(*items));
+	if (!pidhash || !items) {
 		LOG_ERROR("Failed to allocate pidhash");
-		return ERROR_FAIL;
+		ret = ERROR_FAIL;
+		goto errout;
 	}
 
 	ret = target_read_buffer(rtos->target, pidhashaddr, PTR_WIDTH * npidhash, pidhash);
@@ -201,34 +222,33 @@ static int nuttx_update_threads(struct rtos *rtos)
 		goto errout;
 	}
 
-	/* NuttX provides a struct that contains TCB offsets for required members.
-	 * Read its content from g_tcbinfo.
-	 */
-	uint8_t buff[TCBINFO_TARGET_SIZE];
-	ret = target_read_buffer(rtos->target, rtos->symbols[NX_SYM_TCB_INFO].address, sizeof(buff), buff);
-	if (ret != ERROR_OK) {
-		LOG_ERROR("Failed to read tcbinfo: ret = %d", ret);
+	/* Per TCB: pid (2 bytes), state (1 byte) and the name */
+	const unsigned int tcb_size = 3 + NAME_SIZE;
+	tcbs = calloc(npidhash, tcb_size);
+	if (!tcbs) {
+		ret = ERROR_FAIL;
 		goto errout;
 	}
-	tcbinfo.pid_off = target_buffer_get_u16(rtos->target, buff);
-	tcbinfo.state_off = target_buffer_get_u16(rtos->target, buff + 2);
-	tcbinfo.pri_off = target_buffer_get_u16(rtos->target, buff + 4);
-	tcbinfo.name_off = target_buffer_get_u16(rtos->target, buff + 6);
-	tcbinfo.regs_off = target_buffer_get_u16(rtos->target, buff + 8);
-	tcbinfo.basic_num = target_buffer_get_u16(rtos->target, buff + 10);
-	tcbinfo.total_num = target_buffer_get_u16(rtos->target, buff + 12);
-	tcbinfo.xcpreg_off = target_buffer_get_addr(rtos->target, buff + 14);
 
-	/* The head of the g_readytorun list is the currently running task.
-	 * Reading in a temporary variable first to avoid endianness issues,
-	 * rtos->current_thread is int64_t. */
-	uint32_t current_thread;
-	ret = target_read_u32(rtos->target, rtos->symbols[NX_SYM_READYTORUN].address, &current_thread);
+	unsigned int num_items = 0;
+	for (unsigned int i = 0; i < npidhash; i++) {
+		tcbaddr = target_buffer_get_u32(rtos->target, &pidhash[i * PTR_WIDTH]);
+		if (!tcbaddr)
+			continue;
+
+		uint8_t *tcb = tcbs + i * tcb_size;
+		items[num_items++] = (struct target_memory_gather){ tcbaddr + tcbinfo.pid_off, 2, 1, tcb };
+		items[num_items++] = (struct target_memory_gather){ tcbaddr + tcbinfo.state_off, 1, 1, tcb + 2 };
+		if (tcbinfo.name_off)
+			items[num_items++] = (struct target_memory_gather){
+				tcbaddr + tcbinfo.name_off, 1, NAME_SIZE, tcb + 3 };
+	}
+
+	ret = target_read_memory_gather(rtos->target, items, num_items);
 	if (ret != ERROR_OK) {
-		LOG_ERROR("Failed to read g_readytorun: ret = %d", ret);
+		LOG_ERROR("Failed to read the TCBs listed in pidhash: ret = %d", ret);
 		goto errout;
 	}
-	rtos->current_thread = current_thread;
 
 	uint32_t thread_count = 0;
 
@@ -238,19 +258,9 @@ static int nuttx_update_threads(struct rtos *rtos)
 		if (!tcbaddr)
 			continue;
 
-		ret = target_read_u16(rtos->target, tcbaddr + tcbinfo.pid_off, &pid);
-		if (ret != ERROR_OK) {
-			LOG_ERROR("Failed to read PID of TCB@0x%x from pidhash[%d]: ret = %d",
-				tcbaddr, i, ret);
-			goto errout;
-		}
-
-		ret = target_read_u8(rtos->target, tcbaddr + tcbinfo.state_off, &state);
-		if (ret != ERROR_OK) {
-			LOG_ERROR("Failed to read state of TCB@0x%x from pidhash[%d]: ret = %d",
-				tcbaddr, i, ret);
-			goto errout;
-		}
+		const uint8_t *tcb = tcbs + i * tcb_size;
+		uint16_t pid = target_buffer_get_u16(rtos->target, tcb);
+		uint8_t state = tcb[2];
 
 		struct thread_detail *new_thread_details = realloc(rtos->thread_details,
 			sizeof(struct thread_detail) * (thread_count + 1));
@@ -284,12 +294,7 @@ static int nuttx_update_threads(struct rtos *rtos)
 				ret = ERROR_FAIL;
 				goto errout;
 			}
-			ret = target_read_buffer(rtos->target, tcbaddr + tcbinfo.name_off,
-				sizeof(char) * NAME_SIZE, (uint8_t *)thread->thread_name_str);
-			if (ret != ERROR_OK) {
-				LOG_ERROR("Failed to read thread's name: ret = %d", ret);
-				goto errout;
-			}
+			memcpy(thread->thread_name_str, tcb + 3, NAME_SIZE);
 		} else {
 			thread->thread_name_str = strdup("None");
 		}
@@ -298,6 +303,8 @@ static int nuttx_update_threads(struct rtos *rtos)
 	ret = ERROR_OK;
 	rtos->thread_count = thread_count;
 errout:
+	free(tcbs);
+	free(items);
 	free(pidhash);
 	return ret;
 }
@@ -393,7 +393,7 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 				target->rtos_auto_detect = false;
 				target->rtos->type->create(target);
 			}
-			target->rtos->type->update_threads(target->rtos);
+			rtos_update_threads(target);
 		}
 		return ERROR_OK;
 	} else if (strncmp(packet, "qfThreadInfo", 12) == 0) {
@@ -499,6 +499,80 @@ static int rtos_put_gdb_reg_list(struct connection *connection,
 	return ERROR_OK;
 }
 
+void rtos_invalidate_reg_cache(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->reg_cache_count; i++)
+		free(rtos->reg_cache[i].reg_list);
+	free(rtos->reg_cache);
+	rtos->reg_cache = NULL;
+	rtos->reg_cache_count = 0;
+}
+
+static struct rtos_thread_regs *rtos_reg_cache_find(struct rtos *rtos,
+		threadid_t threadid)
+{
+	for (int i = 0; i < rtos->reg_cache_count; i++) {
+		if (rtos->reg_cache[i].threadid == threadid)
+			return &rtos->reg_cache[i];
+	}
+	return NULL;
+}
+
+static struct rtos_thread_regs *rtos_reg_cache_fetch(struct rtos *rtos,
+		threadid_t threadid)
+{
+	struct rtos_reg *reg_list;
+	int num_regs;
+
+	int retval = rtos->type->get_thread_reg_list(rtos, threadid, &reg_list, &num_regs);
+	if (retval != ERROR_OK)
+		return NULL;
+
+	struct rtos_thread_regs *cache = realloc(rtos->reg_cache,
+			(rtos->reg_cache_count + 1) * sizeof(*cache));
+	if (!cache) {
+		free(reg_list);
+		return NULL;
+	}
+	rtos->reg_cache = cache;
+
+	struct rtos_thread_regs *regs = &rtos->reg_cache[rtos->reg_cache_count++];
+	regs->threadid = threadid;
+	regs->reg_list = reg_list;
+	regs->num_regs = num_regs;
+	return regs;
+}
+
+/**
+ * Get the register context of a thread, from the cache if it was already
+ * fetched since the last refresh of the thread list.
+ * IDEs query the context of every thread on each stop: once a second
+ * thread is asked for, fetch all the remaining threads in one pass.
+ */
+static struct rtos_thread_regs *rtos_get_thread_regs(struct rtos *rtos,
+		threadid_t threadid)
+{
+	struct rtos_thread_regs *regs = rtos_reg_cache_find(rtos, threadid);
+	if (regs)
+		return regs;
+
+	regs = rtos_reg_cache_fetch(rtos, threadid);
+	if (!regs || rtos->reg_cache_count != 2)
+		return regs;
+
+	for (int i = 0; i < rtos->thread_count; i++) {
+		struct thread_detail *detail = &rtos->thread_details[i];
+		if (!detail->exists || detail->threadid == rtos->current_thread
+				|| rtos_reg_cache_find(rtos, detail->threadid))
+			continue;
+		/* failure here is reported when the thread is really asked for */
+		rtos_reg_cache_fetch(rtos, detail->threadid);
+	}
+
+	/* realloc may have moved the entry */
+	return rtos_reg_cache_find(rtos, threadid);
+}
+
 /** Look through all registers to find this register. */
 int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 {
@@ -518,7 +592,11 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 										target->rtos->current_thread);
 
 		int retval;
-		if (target->rtos->type->get_thread_reg) {
+		struct rtos_thread_regs *regs = rtos_reg_cache_find(target->rtos, current_threadid);
+		if (regs) {
+			reg_list = regs->reg_list;
+			num_regs = regs->num_regs;
+		} else if (target->rtos->type->get_thread_reg) {
 			reg_list = calloc(1, sizeof(*reg_list));
 			num_regs = 1;
 			retval = target->rtos->type->get_thread_reg(target->rtos,
@@ -528,25 +606,26 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 				return retval;
 			}
 		} else {
-			retval = target->rtos->type->get_thread_reg_list(target->rtos,
-					current_threadid,
-					&reg_list,
-					&num_regs);
-			if (retval != ERROR_OK) {
+			regs = rtos_get_thread_regs(target->rtos, current_threadid);
+			if (!regs) {
 				LOG_ERROR("RTOS: failed to get register list");
-				return retval;
+				return ERROR_FAIL;
 			}
+			reg_list = regs->reg_list;
+			num_regs = regs->num_regs;
 		}
 
 		for (int i = 0; i < num_regs; ++i) {
 			if (reg_list[i].number == (uint32_t)reg_num) {
 				rtos_put_gdb_reg_list(connection, reg_list + i, 1);
-				free(reg_list);
+				if (!regs)
+					free(reg_list);
 				return ERROR_OK;
 			}
 		}
 
-		free(reg_list);
+		if (!regs)
+			free(reg_list);
 	}
 	return ERROR_FAIL;
 }
@@ -560,25 +639,19 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 			(current_threadid != 0) &&
 			((current_threadid != target->rtos->current_thread) ||
 			(target->smp))) {	/* in smp several current thread are possible */
-		struct rtos_reg *reg_list;
-		int num_regs;
-
 		LOG_DEBUG("RTOS: getting register list for thread 0x%" PRIx64
 				  ", target->rtos->current_thread=0x%" PRIx64 "\r\n",
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
-				current_threadid,
-				&reg_list,
-				&num_regs);
-		if (retval != ERROR_OK) {
+		struct rtos_thread_regs *regs = rtos_get_thread_regs(target->rtos,
+				current_threadid);
+		if (!regs) {
 			LOG_ERROR("RTOS: failed to get register list");
-			return retval;
+			return ERROR_FAIL;
 		}
 
-		rtos_put_gdb_reg_list(connection, reg_list, num_regs);
-		free(reg_list);
+		rtos_put_gdb_reg_list(connection, regs->reg_list, regs->num_regs);
 
 		return ERROR_OK;
 	}
@@ -594,6 +667,7 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_invalidate_reg_cache(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
@@ -687,13 +761,18 @@ static int rtos_try_next(struct target *target)
 
 int rtos_update_threads(struct target *target)
 {
-	if ((target->rtos) && (target->rtos->type))
+	if ((target->rtos) && (target->rtos->type)) {
+		rtos_invalidate_reg_cache(target->rtos);
+		target->rtos->thread_list_gen++;
 		target->rtos->type->update_threads(target->rtos);
+	}
 	return ERROR_OK;
 }
 
 void rtos_free_threadlist(struct rtos *rtos)
 {
+	rtos_invalidate_reg_cache(rtos);
+
 	if (rtos->thread_details) {
 		int j;
 
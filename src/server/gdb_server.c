@@ -95,8 +95,9 @@ struct gdb_connection {
 	bool extended_protocol;
 	/* temporarily used for target description support */
 	struct target_desc_format target_desc;
-	/* temporarily used for thread list support */
+	/* thread list XML, kept until the RTOS refreshes its threads */
 	char *thread_list;
+	unsigned int thread_list_gen;
 	/* flag to mask the output from gdb_log_callback() */
 	enum gdb_output_flag output_flag;
 	/* Unique index for this GDB connection. */
@@ -351,6 +352,23 @@ static int gdb_write(struct connection *connection, const void *data, int len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+static int gdb_writev(struct connection *connection,
+		const struct connection_iovec *iov, unsigned int count)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	if (gdb_con->closed) {
+		LOG_DEBUG("GDB socket marked as closed, cannot write to it.");
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	if (connection_writev(connection, iov, count) >= 0)
+		return ERROR_OK;
+
+	LOG_WARNING("Error writing to GDB socket. Dropping the connection.");
+	gdb_con->closed = true;
+	return ERROR_SERVER_REMOTE_CLOSED;
+}
+
 static void gdb_log_incoming_packet(struct connection *connection, const char *packet)
 {
 	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
@@ -454,15 +472,14 @@ static int gdb_put_packet_inner(struct connection *connection,
 				return retval;
 		} else {
 			/* larger packets are transmitted directly from caller supplied buffer
-			 * by several calls to gdb_write() to avoid dynamic allocation */
+			 * by a single gather write to avoid dynamic allocation */
 			snprintf(local_buffer + 1, sizeof(local_buffer) - 1, "#%02x", my_checksum);
-			retval = gdb_write(connection, local_buffer, 1);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, buffer, len);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, local_buffer + 1, 3);
+			const struct connection_iovec iov[] = {
+				{ local_buffer, 1 },
+				{ buffer, len },
+				{ local_buffer + 1, 3 },
+			};
+			retval = gdb_writev(connection, iov, ARRAY_SIZE(iov));
 			if (retval != ERROR_OK)
 				return retval;
 		}
@@ -1002,6 +1019,7 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->target_desc.tdesc = NULL;
 	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
+	gdb_connection->thread_list_gen = 0;
 	gdb_connection->output_flag = GDB_OUTPUT_NO;
 	gdb_connection->unique_index = next_unique_id++;
 
@@ -1117,6 +1135,7 @@ static int gdb_connection_closed(struct connection *connection)
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	free(gdb_connection->thread_list);
 	free(connection->priv);
 	connection->priv = NULL;
 
@@ -1535,6 +1554,9 @@ static int gdb_read_memory_packet(struct connection *connection,
 		retval = rtos_read_buffer(target, addr, len, buffer);
 	if (retval == ERROR_NOT_IMPLEMENTED)
 		retval = target_read_buffer(target, addr, len, buffer);
+	/* the flash write cache may hold newer data than the flash itself */
+	if (retval == ERROR_OK)
+		flash_write_cache_read_pending(target, addr, len, buffer);
 
 	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
 		/* TODO : Here we have to lie and send back all zero's lest stack traces won't work.
@@ -1606,10 +1628,17 @@ static int gdb_write_memory_packet(struct connection *connection,
 		LOG_ERROR("unable to decode memory packet");
 
 	retval = ERROR_NOT_IMPLEMENTED;
-	if (target->rtos)
+	if (target->rtos) {
+		/* the write may hit a saved thread context */
+		rtos_invalidate_reg_cache(target->rtos);
 		retval = rtos_write_buffer(target, addr, len, buffer);
-	if (retval == ERROR_NOT_IMPLEMENTED)
-		retval = target_write_buffer(target, addr, len, buffer);
+	}
+	if (retval == ERROR_NOT_IMPLEMENTED) {
+		/* don't let a later commit of the flash write cache undo the write */
+		retval = flash_write_cache_sync_range(target, addr, len);
+		if (retval == ERROR_OK)
+			retval = target_write_buffer(target, addr, len, buffer);
+	}
 
 	if (retval == ERROR_OK)
 		gdb_put_packet(connection, "OK", 2);
@@ -1679,10 +1708,16 @@ static int gdb_write_memory_binary_packet(struct connection *connection,
 		LOG_DEBUG("addr: 0x%" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
 		retval = ERROR_NOT_IMPLEMENTED;
-		if (target->rtos)
+		if (target->rtos) {
+			/* the write may hit a saved thread context */
+			rtos_invalidate_reg_cache(target->rtos);
 			retval = rtos_write_buffer(target, addr, len, (uint8_t *)separator);
-		if (retval == ERROR_NOT_IMPLEMENTED)
-			retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
+		}
+		if (retval == ERROR_NOT_IMPLEMENTED) {
+			retval = flash_write_cache_sync_range(target, addr, len);
+			if (retval == ERROR_OK)
+				retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
+		}
 
 		if (retval != ERROR_OK)
 			gdb_connection->mem_write_error = true;
@@ -2696,14 +2731,24 @@ static int gdb_generate_thread_list(struct target *target, char **thread_list_ou
 }
 
 static int gdb_get_thread_list_chunk(struct target *target, char **thread_list,
-		char **chunk, int32_t offset, uint32_t length)
+		unsigned int *thread_list_gen, char **chunk, int32_t offset, uint32_t length)
 {
+	unsigned int gen = target->rtos ? target->rtos->thread_list_gen : 0;
+
+	/* IDEs query the thread list repeatedly at each stop, rebuild the XML
+	 * only when the RTOS has refreshed its threads */
+	if (*thread_list && *thread_list_gen != gen) {
+		free(*thread_list);
+		*thread_list = NULL;
+	}
+
 	if (!*thread_list) {
 		int retval = gdb_generate_thread_list(target, thread_list);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Unable to Generate Thread List");
 			return ERROR_FAIL;
 		}
+		*thread_list_gen = gen;
 	}
 
 	size_t thread_list_length = strlen(*thread_list);
@@ -2729,12 +2774,6 @@ static int gdb_get_thread_list_chunk(struct target *target, char **thread_list,
 	strncpy((*chunk) + 1, (*thread_list) + offset, length);
 	(*chunk)[1 + length] = '\0';
 
-	/* After gdb-server sends out last chunk, invalidate thread list. */
-	if (transfer_type == 'l') {
-		free(*thread_list);
-		*thread_list = NULL;
-	}
-
 	return ERROR_OK;
 }
 
@@ -2855,6 +2894,48 @@ static int gdb_query_packet(struct connection *connection,
 
 			return ERROR_OK;
 		}
+	} else if (strncmp(packet, "qSearch:memory:", 15) == 0) {
+		/* qSearch:memory:address;length;search-pattern */
+		int retval;
+		char gdb_reply[20];
+		char *separator;
+		bool found;
+		target_addr_t match;
+		const char *end = packet + packet_size;
+
+		packet += 15;
+
+		target_addr_t addr = strtoull(packet, &separator, 16);
+		if (*separator != ';') {
+			LOG_ERROR("incomplete search memory packet received, dropping connection");
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
+
+		uint32_t len = strtoul(separator + 1, &separator, 16);
+		if (*separator != ';') {
+			LOG_ERROR("incomplete search memory packet received, dropping connection");
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
+
+		/* the pattern is binary data and may contain NUL characters */
+		const uint8_t *pattern = (const uint8_t *)separator + 1;
+		uint32_t pattern_len = end - (separator + 1);
+
+		gdb_connection->output_flag = GDB_OUTPUT_NOTIF;
+		retval = target_search_memory(target, addr, len, pattern, pattern_len, &found, &match);
+		gdb_connection->output_flag = GDB_OUTPUT_NO;
+
+		if (retval != ERROR_OK)
+			return gdb_error(connection, retval);
+
+		if (found) {
+			int reply_len = snprintf(gdb_reply, sizeof(gdb_reply), "1,%" PRIx64, (uint64_t)match);
+			gdb_put_packet(connection, gdb_reply, reply_len);
+		} else {
+			gdb_put_packet(connection, "0", 1);
+		}
+
+		return ERROR_OK;
 	} else if (strncmp(packet, "qSupported", 10) == 0) {
 		/* we currently support packet size and qXfer:memory-map:read (if enabled)
 		 * qXfer:features:read is supported for some targets */
@@ -2951,7 +3032,7 @@ static int gdb_query_packet(struct connection *connection,
 		 * chunk of target description.
 		 */
 		retval = gdb_get_thread_list_chunk(target, &gdb_connection->thread_list,
-						   &xml, offset, length);
+						   &gdb_connection->thread_list_gen, &xml, offset, length);
 		if (retval != ERROR_OK) {
 			gdb_error(connection, retval);
 			return retval;
@@ -9,6 +9,7 @@
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
 #include <server/server.h>
+#include <server/trace_ring.h>
 #include <target/target.h>
 #include <pld/pld.h>
 
@@ -24,6 +25,12 @@
 #define IPDBG_MAX_DR_LENGTH 13
 #define IPDBG_TCP_PORT_STR_MAX_LENGTH 6
 #define IPDBG_SCRATCH_MEMORY_SIZE 1024
+/* adaptive polling: tight while data flows, backing off to a slow idle poll */
+#define IPDBG_POLL_MIN_MS 1
+#define IPDBG_POLL_MAX_MS 50
+#define IPDBG_POLL_BURST_MS 10
+/* empty scans used to fetch data from an idle hub */
+#define IPDBG_IDLE_SCANS 16
 
 /* private connection data for IPDBG */
 struct ipdbg_fifo {
@@ -34,7 +41,8 @@ struct ipdbg_fifo {
 
 struct ipdbg_connection {
 	struct ipdbg_fifo dn_fifo;
-	struct ipdbg_fifo up_fifo;
+	/** subscriber of the service's up ring, lossless */
+	struct trace_ring_sub *up_sub;
 	bool closed;
 };
 
@@ -42,6 +50,8 @@ struct ipdbg_service {
 	struct ipdbg_hub *hub;
 	struct ipdbg_service *next;
 	uint16_t port;
+	/** data from the hub to the client, trace ring "ipdbg.<port>" */
+	struct trace_ring *up_ring;
 	struct ipdbg_connection connection;
 	uint8_t tool;
 };
@@ -78,12 +88,20 @@ struct ipdbg_hub {
 	uint8_t flow_control_enabled;
 	struct ipdbg_virtual_ir_info *virtual_ir;
 	struct ipdbg_hub_scratch_memory scratch_memory;
+	/* bytes moved in either direction during the current poll cycle */
+	size_t traffic;
+	size_t empty_scans;
+	unsigned int poll_interval_ms;
+	int64_t next_poll_ms;
 };
 
 static struct ipdbg_hub *ipdbg_first_hub;
 
 static struct ipdbg_service *ipdbg_first_service;
 
+/* hub whose virtual IR and USER instruction are currently shifted in */
+static struct ipdbg_hub *ipdbg_selected_hub;
+
 static void ipdbg_init_fifo(struct ipdbg_fifo *fifo)
 {
 	fifo->count = 0;
@@ -111,15 +129,6 @@ static void ipdbg_zero_rd_idx(struct ipdbg_fifo *fifo)
 	fifo->rd_idx = 0;
 }
 
-static void ipdbg_append_to_fifo(struct ipdbg_fifo *fifo, char data)
-{
-	if (ipdbg_fifo_is_full(fifo))
-		return;
-
-	ipdbg_zero_rd_idx(fifo);
-	fifo->buffer[fifo->count++] = data;
-}
-
 static char ipdbg_get_from_fifo(struct ipdbg_fifo *fifo)
 {
 	if (ipdbg_fifo_is_empty(fifo))
@@ -129,25 +138,25 @@ static char ipdbg_get_from_fifo(struct ipdbg_fifo *fifo)
 	return fifo->buffer[fifo->rd_idx++];
 }
 
-static int ipdbg_move_buffer_to_connection(struct connection *conn, struct ipdbg_fifo *fifo)
+/* Put back the last @a count bytes taken with ipdbg_get_from_fifo(). Only
+ * valid while nothing was appended in between. */
+static void ipdbg_fifo_rewind(struct ipdbg_fifo *fifo, size_t count)
 {
-	if (ipdbg_fifo_is_empty(fifo))
-		return ERROR_OK;
+	fifo->rd_idx -= count;
+	fifo->count += count;
+}
 
+static int ipdbg_move_buffer_to_connection(struct connection *conn)
+{
 	struct ipdbg_connection *connection = conn->priv;
-	if (connection->closed)
+	if (connection->closed || !connection->up_sub)
 		return ERROR_SERVER_REMOTE_CLOSED;
 
-	ipdbg_zero_rd_idx(fifo);
-	size_t bytes_written = connection_write(conn, fifo->buffer, fifo->count);
-	if (bytes_written != fifo->count) {
-		LOG_ERROR("error during write: %zu != %zu", bytes_written, fifo->count);
+	if (trace_ring_flush(connection->up_sub->ring) != ERROR_OK || connection->up_sub->failed) {
 		connection->closed = true;
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
-	fifo->count -= bytes_written;
-
 	return ERROR_OK;
 }
 
@@ -195,6 +204,15 @@ static int ipdbg_create_service(struct ipdbg_hub *hub, uint8_t tool, struct ipdb
 	(*service)->tool = tool;
 	(*service)->port = port;
 
+	char ring_name[32];
+	snprintf(ring_name, sizeof(ring_name), "ipdbg.%u", port);
+	(*service)->up_ring = trace_ring_get(ring_name, IPDBG_BUFFER_SIZE);
+	if (!(*service)->up_ring) {
+		free(*service);
+		*service = NULL;
+		return ERROR_FAIL;
+	}
+
 	return ERROR_OK;
 }
 
@@ -270,6 +288,8 @@ static void ipdbg_free_hub(struct ipdbg_hub *hub)
 {
 	if (!hub)
 		return;
+	if (ipdbg_selected_hub == hub)
+		ipdbg_selected_hub = NULL;
 	free(hub->connections);
 	free(hub->virtual_ir);
 	free(hub->name);
@@ -386,6 +406,31 @@ static int ipdbg_shift_vir(struct ipdbg_hub *hub)
 	return retval;
 }
 
+/* Shift in the virtual IR and USER instruction, unless they still are. */
+static int ipdbg_select_hub(struct ipdbg_hub *hub)
+{
+	struct jtag_tap *tap = hub->tap;
+	if (!tap)
+		return ERROR_FAIL;
+
+	if (ipdbg_selected_hub == hub &&
+			buf_get_u32(tap->cur_instr, 0, tap->ir_length) == hub->user_instruction)
+		return ERROR_OK;
+
+	ipdbg_selected_hub = NULL;
+
+	int ret = ipdbg_shift_vir(hub);
+	if (ret != ERROR_OK)
+		return ret;
+
+	ret = ipdbg_shift_instr(hub, hub->user_instruction);
+	if (ret != ERROR_OK)
+		return ret;
+
+	ipdbg_selected_hub = hub;
+	return ERROR_OK;
+}
+
 static int ipdbg_shift_data(struct ipdbg_hub *hub, uint32_t dn_data, uint32_t *up_data)
 {
 	if (!hub)
@@ -422,15 +467,17 @@ static int ipdbg_distribute_data_from_hub(struct ipdbg_hub *hub, uint32_t up)
 		return ERROR_OK;
 	}
 
+	hub->traffic++;
+
 	struct connection *conn = hub->connections[tool];
 	if (conn) {
 		struct ipdbg_connection *connection = conn->priv;
-		if (ipdbg_fifo_is_full(&connection->up_fifo)) {
-			int retval = ipdbg_move_buffer_to_connection(conn, &connection->up_fifo);
-			if (retval != ERROR_OK)
-				return retval;
-		}
-		ipdbg_append_to_fifo(&connection->up_fifo, up);
+		if (!connection->up_sub)
+			return ERROR_OK;
+
+		/* the ring hands a full buffer to the client before it wraps */
+		const uint8_t up_byte = up & 0xff;
+		trace_ring_append(connection->up_sub->ring, &up_byte, 1);
 	}
 	return ERROR_OK;
 }
@@ -438,9 +485,10 @@ static int ipdbg_distribute_data_from_hub(struct ipdbg_hub *hub, uint32_t up)
 static void ipdbg_check_for_xoff(struct ipdbg_hub *hub, size_t tool,
 								uint32_t rx_data)
 {
-	if ((rx_data & hub->xoff_mask) && hub->last_dn_tool != hub->max_tools) {
+	if ((rx_data & hub->xoff_mask) && hub->last_dn_tool != hub->max_tools &&
+			!(hub->dn_xoff & BIT(hub->last_dn_tool))) {
 		hub->dn_xoff |= BIT(hub->last_dn_tool);
-		LOG_INFO("tool %d sent xoff", hub->last_dn_tool);
+		LOG_DEBUG("tool %d sent xoff", hub->last_dn_tool);
 	}
 
 	hub->last_dn_tool = tool;
@@ -455,9 +503,14 @@ static int ipdbg_shift_empty_data(struct ipdbg_hub *hub)
 	if (!tap)
 		return ERROR_FAIL;
 
+	/* Only probe an idle hub with a few scans, grow to the full queue
+	 * size while it keeps sending. */
+	const size_t num_scans = MIN(MAX(hub->empty_scans, IPDBG_IDLE_SCANS), hub->using_queue_size);
+	const size_t traffic_before = hub->traffic;
+
 	const size_t dreg_buffer_size = DIV_ROUND_UP(hub->data_register_length, 8);
 	memset(hub->scratch_memory.dr_out_vals, 0, dreg_buffer_size);
-	for (size_t i = 0; i < hub->using_queue_size; ++i) {
+	for (size_t i = 0; i < num_scans; ++i) {
 		ipdbg_init_scan_field(hub->scratch_memory.fields + i,
 								hub->scratch_memory.dr_in_vals + i * dreg_buffer_size,
 								hub->data_register_length,
@@ -469,7 +522,7 @@ static int ipdbg_shift_empty_data(struct ipdbg_hub *hub)
 
 	if (retval == ERROR_OK) {
 		uint32_t up_data;
-		for (size_t i = 0; i < hub->using_queue_size; ++i) {
+		for (size_t i = 0; i < num_scans; ++i) {
 			up_data = buf_get_u32(hub->scratch_memory.dr_in_vals +
 									i * dreg_buffer_size, 0,
 									hub->data_register_length);
@@ -484,29 +537,24 @@ static int ipdbg_shift_empty_data(struct ipdbg_hub *hub)
 				ipdbg_check_for_xoff(hub, hub->max_tools, up_data);
 			}
 		}
+
+		const size_t received = hub->traffic - traffic_before;
+		if (received > num_scans / 2)
+			hub->empty_scans = MIN(2 * num_scans, hub->using_queue_size);
+		else if (!received)
+			hub->empty_scans = IPDBG_IDLE_SCANS;
 	}
 
 	return retval;
 }
 
-static int ipdbg_jtag_transfer_byte(struct ipdbg_hub *hub, size_t tool, struct ipdbg_connection *connection)
-{
-	uint32_t dn = hub->valid_mask | ((tool & hub->tool_mask) << 8) |
-				(0x00fful & ipdbg_get_from_fifo(&connection->dn_fifo));
-	uint32_t up = 0;
-	int ret = ipdbg_shift_data(hub, dn, &up);
-	if (ret != ERROR_OK)
-		return ret;
-
-	ret = ipdbg_distribute_data_from_hub(hub, up);
-	if (ret != ERROR_OK)
-		return ret;
-
-	ipdbg_check_for_xoff(hub, tool, up);
-
-	return ERROR_OK;
-}
-
+/*
+ * Send a batch of bytes to @a tool in one queue flush. Each response carries
+ * the xoff flag for the byte sent one scan earlier. For tools with flow
+ * control the batch is sent speculatively: once the tool asks us to stop,
+ * the bytes sent after the one it still accepted are put back into the
+ * fifo and go out again after xon.
+ */
 static int ipdbg_jtag_transfer_bytes(struct ipdbg_hub *hub,
 			size_t tool, struct ipdbg_connection *connection)
 {
@@ -537,39 +585,44 @@ static int ipdbg_jtag_transfer_bytes(struct ipdbg_hub *hub,
 	}
 
 	int retval = jtag_execute_queue();
+	if (retval != ERROR_OK)
+		return retval;
 
-	if (retval == ERROR_OK) {
-		uint32_t up_data;
-		for (size_t i = 0; i < num_tx; ++i) {
-			up_data = buf_get_u32(hub->scratch_memory.dr_in_vals +
-									i * dreg_buffer_size,
-									0, hub->data_register_length);
-			int rv = ipdbg_distribute_data_from_hub(hub, up_data);
-			if (rv != ERROR_OK)
-				retval = rv;
-			if (i == 0) {
-				/* check if xoff sent is only needed on the first transfer which
-				   may contain the xoff of the prev down transfer.
-				   No checks for this channel because this function is only
-				   called for channels without enabled flow control.
-				*/
-				ipdbg_check_for_xoff(hub, tool, up_data);
-			}
+	const bool flow_control = hub->flow_control_enabled & BIT(tool);
+	size_t accepted = num_tx;
+	uint32_t up_data;
+	for (size_t i = 0; i < num_tx; ++i) {
+		up_data = buf_get_u32(hub->scratch_memory.dr_in_vals +
+								i * dreg_buffer_size,
+								0, hub->data_register_length);
+		int rv = ipdbg_distribute_data_from_hub(hub, up_data);
+		if (rv != ERROR_OK)
+			retval = rv;
+
+		/* The first response may hold the xoff of the previous down
+		 * transfer, to whatever tool that went. Later ones only matter
+		 * with flow control, they refer to this batch. */
+		if (i == 0 || (flow_control && accepted == num_tx)) {
+			ipdbg_check_for_xoff(hub, tool, up_data);
+			if (flow_control && (hub->dn_xoff & BIT(tool)) && accepted == num_tx)
+				accepted = i + 1;
 		}
 	}
 
+	if (accepted < num_tx) {
+		LOG_DEBUG_IO("tool %zu xoff, resending %zu bytes after xon", tool, num_tx - accepted);
+		ipdbg_fifo_rewind(&connection->dn_fifo, num_tx - accepted);
+		/* the next response is about a byte that gets resent anyway */
+		hub->last_dn_tool = hub->max_tools;
+	}
+	hub->traffic += accepted;
+
 	return retval;
 }
 
-static int ipdbg_polling_callback(void *priv)
+static int ipdbg_poll_hub(struct ipdbg_hub *hub)
 {
-	struct ipdbg_hub *hub = priv;
-
-	int ret = ipdbg_shift_vir(hub);
-	if (ret != ERROR_OK)
-		return ret;
-
-	ret = ipdbg_shift_instr(hub, hub->user_instruction);
+	int ret = ipdbg_select_hub(hub);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -579,27 +632,26 @@ static int ipdbg_polling_callback(void *priv)
 		if (conn && conn->priv) {
 			struct ipdbg_connection *connection = conn->priv;
 			while (((hub->dn_xoff & BIT(tool)) == 0) && !ipdbg_fifo_is_empty(&connection->dn_fifo)) {
-				if (hub->flow_control_enabled & BIT(tool))
-					ret = ipdbg_jtag_transfer_byte(hub, tool, connection);
-				else
-					ret = ipdbg_jtag_transfer_bytes(hub, tool, connection);
+				ret = ipdbg_jtag_transfer_bytes(hub, tool, connection);
 				if (ret != ERROR_OK)
 					return ret;
 			}
 		}
 	}
 
-	/* some transfers to get data from jtag-hub in case there is no dn data */
-	ret = ipdbg_shift_empty_data(hub);
-	if (ret != ERROR_OK)
-		return ret;
+	/* some transfers to get data from jtag-hub in case there is no dn data,
+	 * the down transfers above already brought the up data with them */
+	if (!hub->traffic) {
+		ret = ipdbg_shift_empty_data(hub);
+		if (ret != ERROR_OK)
+			return ret;
+	}
 
 	/* write from up fifos to sockets */
 	for (size_t tool = 0; tool < hub->max_tools; ++tool) {
 		struct connection *conn = hub->connections[tool];
 		if (conn && conn->priv) {
-			struct ipdbg_connection *connection = conn->priv;
-			int retval = ipdbg_move_buffer_to_connection(conn, &connection->up_fifo);
+			int retval = ipdbg_move_buffer_to_connection(conn);
 			if (retval != ERROR_OK)
 				return retval;
 		}
@@ -608,6 +660,33 @@ static int ipdbg_polling_callback(void *priv)
 	return ERROR_OK;
 }
 
+static int ipdbg_polling_callback(void *priv)
+{
+	struct ipdbg_hub *hub = priv;
+
+	int64_t now = timeval_ms();
+	if (now < hub->next_poll_ms)
+		return ERROR_OK;
+
+	/* keep polling back to back while data flows, but give the other
+	 * services a chance every IPDBG_POLL_BURST_MS */
+	const int64_t end = now + IPDBG_POLL_BURST_MS;
+	do {
+		hub->traffic = 0;
+		int ret = ipdbg_poll_hub(hub);
+		if (ret != ERROR_OK)
+			return ret;
+	} while (hub->traffic && timeval_ms() < end);
+
+	if (hub->traffic)
+		hub->poll_interval_ms = IPDBG_POLL_MIN_MS;
+	else
+		hub->poll_interval_ms = MIN(2 * hub->poll_interval_ms, IPDBG_POLL_MAX_MS);
+	hub->next_poll_ms = timeval_ms() + hub->poll_interval_ms;
+
+	return ERROR_OK;
+}
+
 static int ipdbg_get_flow_control_info_from_hub(struct ipdbg_hub *hub)
 {
 	uint32_t up_data;
@@ -647,11 +726,7 @@ static int ipdbg_start_polling(struct ipdbg_service *service, struct connection
 
 	const uint32_t reset_hub = hub->valid_mask | ((hub->max_tools) << 8);
 
-	int ret = ipdbg_shift_vir(hub);
-	if (ret != ERROR_OK)
-		return ret;
-
-	ret = ipdbg_shift_instr(hub, hub->user_instruction);
+	int ret = ipdbg_select_hub(hub);
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -667,9 +742,12 @@ static int ipdbg_start_polling(struct ipdbg_service *service, struct connection
 
 	LOG_INFO("IPDBG start_polling");
 
-	const int time_ms = 20;
+	/* the callback itself decides how often to really poll */
+	hub->poll_interval_ms = IPDBG_POLL_MIN_MS;
+	hub->next_poll_ms = 0;
+	hub->empty_scans = IPDBG_IDLE_SCANS;
 	const int periodic = 1;
-	return target_register_timer_callback(ipdbg_polling_callback, time_ms, periodic, hub);
+	return target_register_timer_callback(ipdbg_polling_callback, IPDBG_POLL_MIN_MS, periodic, hub);
 }
 
 static int ipdbg_stop_polling(struct ipdbg_service *service)
@@ -691,8 +769,10 @@ static int ipdbg_on_new_connection(struct connection *connection)
 	struct ipdbg_service *service = connection->service->priv;
 	connection->priv = &service->connection;
 	/* initialize ipdbg connection information */
-	ipdbg_init_fifo(&service->connection.up_fifo);
 	ipdbg_init_fifo(&service->connection.dn_fifo);
+	service->connection.up_sub = trace_ring_subscribe_connection(service->up_ring, connection, true);
+	if (!service->connection.up_sub)
+		return ERROR_FAIL;
 
 	int retval = ipdbg_start_polling(service, connection);
 	if (retval != ERROR_OK) {
@@ -726,6 +806,10 @@ static int ipdbg_on_connection_input(struct connection *connection)
 
 	fifo->count += bytes_read;
 
+	/* don't wait for the idle poll interval to send it */
+	struct ipdbg_service *service = connection->service->priv;
+	service->hub->next_poll_ms = 0;
+
 	return ERROR_OK;
 }
 
@@ -733,6 +817,8 @@ static int ipdbg_on_connection_closed(struct connection *connection)
 {
 	struct ipdbg_connection *conn = connection->priv;
 	conn->closed = true;
+	trace_ring_unsubscribe(conn->up_sub);
+	conn->up_sub = NULL;
 	LOG_INFO("Closed IPDBG Connection");
 
 	return ipdbg_stop_polling(connection->service->priv);
@@ -767,9 +853,11 @@ static int ipdbg_stop_service(struct ipdbg_service *service)
 
 	char port_str_buffer[IPDBG_TCP_PORT_STR_MAX_LENGTH];
 	snprintf(port_str_buffer, IPDBG_TCP_PORT_STR_MAX_LENGTH, "%u", service->port);
+	struct trace_ring *up_ring = service->up_ring;
 	retval = remove_service("ipdbg", port_str_buffer);
 	/* The ipdbg_service structure is freed by server.c:remove_service().
 	   There the "priv" pointer is freed.*/
+	trace_ring_free(up_ring);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("BUG: remove_service failed");
 		return retval;
@@ -817,6 +905,7 @@ static int ipdbg_start(struct ipdbg_hub *hub, uint16_t port, uint8_t tool)
 	snprintf(port_str_buffer, IPDBG_TCP_PORT_STR_MAX_LENGTH, "%u", port);
 	retval = add_service(&ipdbg_service_driver, port_str_buffer, 1, service);
 	if (retval != ERROR_OK) {
+		trace_ring_free(service->up_ring);
 		free(service);
 		return retval;
 	}
@@ -13,6 +13,7 @@
 
 #include "server.h"
 #include "rtt_server.h"
+#include "trace_ring.h"
 
 /**
  * @file
@@ -20,9 +21,14 @@
  * RTT server.
  *
  * This server allows access to Real Time Transfer (RTT) channels via TCP
- * connections.
+ * connections. Up-channel data goes through the trace ring "rtt.<channel>",
+ * which all connections to the channel subscribe to. The channel is only
+ * read from the target while at least one client is connected to it, so the
+ * target keeps its data (or blocks) until someone is there to take it.
  */
 
+#define RTT_TRACE_RING_SIZE	(64 * 1024)
+
 struct rtt_service {
 	unsigned int channel;
 	char *hello_message;
@@ -32,35 +38,70 @@ struct rtt_connection_data {
 	unsigned char buffer[64];
 	unsigned int length;
 	unsigned int offset;
+	struct trace_ring *ring;
+	struct trace_ring_sub *sub;
 };
 
 static int read_callback(unsigned int channel, const uint8_t *buffer,
 		size_t length, void *user_data)
 {
-	int ret;
-	struct connection *connection;
-	size_t offset;
+	struct trace_ring *ring = user_data;
 
-	connection = (struct connection *)user_data;
-	offset = 0;
+	/* failing sinks are detached and reported by the ring */
+	trace_ring_write(ring, buffer, length);
 
-	while (offset < length) {
-		ret = connection_write(connection, buffer + offset, length - offset);
+	return ERROR_OK;
+}
+
+/* Number of connected clients per channel, over all RTT servers. */
+static unsigned int *rtt_channel_clients;
+static unsigned int rtt_channel_clients_length;
+
+static struct trace_ring *rtt_channel_ring(unsigned int channel)
+{
+	char name[32];
 
-		if (ret < 0) {
-			LOG_ERROR("Failed to write data to socket.");
+	snprintf(name, sizeof(name), "rtt.%u", channel);
+	return trace_ring_get(name, RTT_TRACE_RING_SIZE);
+}
+
+/* Start reading @a channel into @a ring for its first client. */
+static int rtt_channel_get(unsigned int channel, struct trace_ring *ring)
+{
+	if (channel >= rtt_channel_clients_length) {
+		unsigned int *tmp = realloc(rtt_channel_clients,
+				(channel + 1) * sizeof(*rtt_channel_clients));
+		if (!tmp) {
+			LOG_ERROR("Out of memory");
 			return ERROR_FAIL;
 		}
+		memset(tmp + rtt_channel_clients_length, 0,
+				(channel + 1 - rtt_channel_clients_length) * sizeof(*tmp));
+		rtt_channel_clients = tmp;
+		rtt_channel_clients_length = channel + 1;
+	}
 
-		offset += ret;
+	if (!rtt_channel_clients[channel]) {
+		int ret = rtt_register_sink(channel, &read_callback, ring);
+		if (ret != ERROR_OK)
+			return ret;
 	}
 
+	rtt_channel_clients[channel]++;
 	return ERROR_OK;
 }
 
+/* Stop reading @a channel once its last client is gone. */
+static void rtt_channel_put(unsigned int channel, struct trace_ring *ring)
+{
+	assert(channel < rtt_channel_clients_length && rtt_channel_clients[channel]);
+
+	if (!--rtt_channel_clients[channel])
+		rtt_unregister_sink(channel, &read_callback, ring);
+}
+
 static int rtt_new_connection(struct connection *connection)
 {
-	int ret;
 	struct rtt_service *service;
 	struct rtt_connection_data *data;
 
@@ -76,23 +117,39 @@ static int rtt_new_connection(struct connection *connection)
 
 	LOG_DEBUG("rtt: New connection for channel %u", service->channel);
 
-	ret = rtt_register_sink(service->channel, &read_callback, connection);
-
-	if (ret != ERROR_OK)
-		return ret;
+	data->ring = rtt_channel_ring(service->channel);
+	if (!data->ring)
+		goto error;
 
+	/* before subscribing, which makes the socket non-blocking */
 	if (service->hello_message)
 		connection_write(connection, service->hello_message, strlen(service->hello_message));
 
+	data->sub = trace_ring_subscribe_connection(data->ring, connection, false);
+	if (!data->sub)
+		goto error;
+
+	if (rtt_channel_get(service->channel, data->ring) != ERROR_OK) {
+		trace_ring_unsubscribe(data->sub);
+		goto error;
+	}
+
 	return ERROR_OK;
+
+error:
+	free(data);
+	connection->priv = NULL;
+	return ERROR_FAIL;
 }
 
 static int rtt_connection_closed(struct connection *connection)
 {
 	struct rtt_service *service;
+	struct rtt_connection_data *data = connection->priv;
 
 	service = (struct rtt_service *)connection->service->priv;
-	rtt_unregister_sink(service->channel, &read_callback, connection);
+	trace_ring_unsubscribe(data->sub);
+	rtt_channel_put(service->channel, data->ring);
 
 	free(connection->priv);
 
@@ -170,6 +227,12 @@ COMMAND_HANDLER(handle_rtt_start_command)
 
 	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], service->channel);
 
+	/* the ring outlives the server, it can be read by other trace ring sinks */
+	if (!rtt_channel_ring(service->channel)) {
+		free(service);
+		return ERROR_FAIL;
+	}
+
 	if (CMD_ARGC >= 3) {
 		const char *hello_message = CMD_ARGV[2];
 		size_t hello_length = strlen(hello_message);
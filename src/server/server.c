@@ -24,6 +24,7 @@
 #include "tcl_server.h"
 #include "telnet_server.h"
 #include "ipdbg.h"
+#include "trace_ring.h"
 
 #include <signal.h>
 
@@ -33,8 +34,14 @@
 
 #ifndef _WIN32
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 #endif
 
+/* corked output beyond this size is flushed early */
+#define CONNECTION_OUT_BUF_MAX	(64 * 1024)
+/* fragments handed to a single writev() */
+#define CONNECTION_IOV_MAX		8
+
 static struct service *services;
 
 enum shutdown_reason {
@@ -70,6 +77,11 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	c->input_pending = false;
 	c->priv = NULL;
 	c->next = NULL;
+	c->cork_depth = 0;
+	c->out_buf = NULL;
+	c->out_len = 0;
+	c->out_size = 0;
+	c->out_error = false;
 
 	if (service->type == CONNECTION_TCP) {
 		address_size = sizeof(c->sin);
@@ -173,6 +185,7 @@ static int remove_connection(struct service *service, struct connection *connect
 
 			/* delete connection */
 			*p = c->next;
+			free(c->out_buf);
 			free(c);
 
 			if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
@@ -716,6 +729,7 @@ void server_free(void)
 	telnet_service_free();
 	jsp_service_free();
 	ipdbg_server_free();
+	trace_ring_free_all();
 
 	free(bindto_name);
 }
@@ -729,16 +743,180 @@ void exit_on_signal(int sig)
 #endif
 }
 
+static int connection_write_raw(struct connection *connection, const void *data, size_t len)
+{
+	if (connection->service->type == CONNECTION_TCP)
+		return write_socket(connection->fd_out, data, len);
+	else
+		return write(connection->fd_out, data, len);
+}
+
+/* Write all of the buffer, retrying after short writes. */
+static int connection_write_all(struct connection *connection, const void *data, size_t len)
+{
+	const char *p = data;
+	size_t done = 0;
+
+	while (done < len) {
+		int retval = connection_write_raw(connection, p + done, len - done);
+		if (retval <= 0)
+			return -1;
+		done += retval;
+	}
+
+	return done;
+}
+
+static int connection_flush(struct connection *connection)
+{
+	int retval = 0;
+
+	if (connection->out_len > 0 && !connection->out_error) {
+		if (connection_write_all(connection, connection->out_buf,
+				connection->out_len) < 0)
+			connection->out_error = true;
+	}
+	connection->out_len = 0;
+
+	if (connection->out_error) {
+		connection->out_error = false;
+		retval = -1;
+	}
+
+	return retval;
+}
+
+static int connection_append(struct connection *connection, const void *data, size_t len)
+{
+	if (connection->out_len + len > connection->out_size) {
+		size_t size = MAX(connection->out_size * 2, connection->out_len + len);
+		size = MAX(size, 256);
+		char *buf = realloc(connection->out_buf, size);
+		if (!buf) {
+			/* can't coalesce, push out what we have and write through */
+			if (connection_flush(connection) < 0)
+				connection->out_error = true;
+			else if (connection_write_all(connection, data, len) < 0)
+				connection->out_error = true;
+			return len;
+		}
+		connection->out_buf = buf;
+		connection->out_size = size;
+	}
+
+	memcpy(connection->out_buf + connection->out_len, data, len);
+	connection->out_len += len;
+
+	/* don't let a chatty producer hold back an unbounded amount of output */
+	if (connection->out_len >= CONNECTION_OUT_BUF_MAX && connection_flush(connection) < 0)
+		connection->out_error = true;
+
+	return len;
+}
+
+/**
+ * Hold back output on @a connection until the matching connection_uncork(),
+ * so that a logical message produced by several writes leaves in a single
+ * system call and TCP segment. Calls nest.
+ */
+void connection_cork(struct connection *connection)
+{
+	connection->cork_depth++;
+}
+
+/**
+ * Release output held back by connection_cork(). Returns 0 on success, or
+ * -1 if any of the coalesced output could not be written.
+ */
+int connection_uncork(struct connection *connection)
+{
+	if (connection->cork_depth == 0 || --connection->cork_depth > 0)
+		return 0;
+
+	return connection_flush(connection);
+}
+
 int connection_write(struct connection *connection, const void *data, int len)
 {
 	if (len == 0) {
 		/* successful no-op. Sockets and pipes behave differently here... */
 		return 0;
 	}
-	if (connection->service->type == CONNECTION_TCP)
-		return write_socket(connection->fd_out, data, len);
-	else
-		return write(connection->fd_out, data, len);
+	if (connection->cork_depth > 0)
+		return connection_append(connection, data, len);
+
+	return connection_write_raw(connection, data, len);
+}
+
+#ifndef _WIN32
+static int connection_writev_gather(struct connection *connection,
+		const struct connection_iovec *iov, unsigned int count, size_t total)
+{
+	struct iovec vec[CONNECTION_IOV_MAX];
+
+	for (unsigned int i = 0; i < count; i++) {
+		vec[i].iov_base = (void *)iov[i].data;
+		vec[i].iov_len = iov[i].len;
+	}
+
+	struct iovec *v = vec;
+	unsigned int n = count;
+	size_t left = total;
+	while (left > 0) {
+		ssize_t written = writev(connection->fd_out, v, n);
+		if (written <= 0)
+			return -1;
+		left -= written;
+
+		/* short write, skip what went out and retry with the rest */
+		while (n > 0 && (size_t)written >= v->iov_len) {
+			written -= v->iov_len;
+			v++;
+			n--;
+		}
+		if (n > 0) {
+			v->iov_base = (char *)v->iov_base + written;
+			v->iov_len -= written;
+		}
+	}
+
+	return total;
+}
+#endif
+
+/**
+ * Write the fragments in @a iov back to back, as a single gather write
+ * where the host supports it. Returns the total number of bytes written,
+ * or -1 on error.
+ */
+int connection_writev(struct connection *connection,
+		const struct connection_iovec *iov, unsigned int count)
+{
+	size_t total = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+		total += iov[i].len;
+
+	if (connection->cork_depth > 0) {
+		for (unsigned int i = 0; i < count; i++)
+			if (iov[i].len)
+				connection_append(connection, iov[i].data, iov[i].len);
+		return total;
+	}
+
+#ifndef _WIN32
+	if (count <= CONNECTION_IOV_MAX)
+		return connection_writev_gather(connection, iov, count, total);
+#endif
+
+	connection_cork(connection);
+	for (unsigned int i = 0; i < count; i++)
+		if (iov[i].len)
+			connection_append(connection, iov[i].data, iov[i].len);
+	if (connection_uncork(connection) < 0)
+		return -1;
+
+	return total;
 }
 
 int connection_read(struct connection *connection, void *data, int len)
@@ -841,6 +1019,10 @@ int server_register_commands(struct command_context *cmd_ctx)
 	if (retval != ERROR_OK)
 		return retval;
 
+	retval = trace_ring_register_commands(cmd_ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return register_commands(cmd_ctx, NULL, server_command_handlers);
 }
 
@@ -42,6 +42,18 @@ struct connection {
 	bool input_pending;
 	void *priv;
 	struct connection *next;
+	/* output coalesced while corked, see connection_cork() */
+	unsigned int cork_depth;
+	char *out_buf;
+	size_t out_len;
+	size_t out_size;
+	bool out_error;
+};
+
+/** One fragment of a scatter/gather write, see connection_writev(). */
+struct connection_iovec {
+	const void *data;
+	size_t len;
 };
 
 struct service_driver {
@@ -102,6 +114,10 @@ int server_loop(struct command_context *command_context);
 int server_register_commands(struct command_context *context);
 
 int connection_write(struct connection *connection, const void *data, int len);
+int connection_writev(struct connection *connection,
+		const struct connection_iovec *iov, unsigned int count);
+void connection_cork(struct connection *connection);
+int connection_uncork(struct connection *connection);
 int connection_read(struct connection *connection, void *data, int len);
 
 bool openocd_is_shutdown_pending(void);
@@ -232,11 +232,19 @@ static int tcl_input(struct connection *connection)
 			tclc->tc_line[tclc->tc_lineoffset-1] = '\0';
 			command_run_line(connection->cmd_ctx, tclc->tc_line);
 			result = Jim_GetString(Jim_GetResult(interp), &reslen);
+			/* send result and terminator in the same segment */
+			connection_cork(connection);
 			retval = tcl_output(connection, result, reslen);
+			/* Always output ctrl-z as end of line to allow multiline results */
+			if (retval == ERROR_OK)
+				tcl_output(connection, "\x1a", 1);
+			if (connection_uncork(connection) < 0 && retval == ERROR_OK) {
+				LOG_ERROR("error during write");
+				tclc->tc_outerror = 1;
+				retval = ERROR_SERVER_REMOTE_CLOSED;
+			}
 			if (retval != ERROR_OK)
 				return retval;
-			/* Always output ctrl-z as end of line to allow multiline results */
-			tcl_output(connection, "\x1a", 1);
 		}
 
 		tclc->tc_lineoffset = 0;
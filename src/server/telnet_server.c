@@ -64,8 +64,11 @@ static int telnet_prompt(struct connection *connection)
 
 static int telnet_outputline(struct connection *connection, const char *line)
 {
+	struct telnet_connection *t_con = connection->priv;
 	int len;
 
+	connection_cork(connection);
+
 	/* process lines in buffer */
 	while (*line) {
 		char *line_end = strchr(line, '\n');
@@ -83,6 +86,9 @@ static int telnet_outputline(struct connection *connection, const char *line)
 			line += len;
 	}
 
+	if (connection_uncork(connection) < 0)
+		t_con->closed = true;
+
 	return ERROR_OK;
 }
 
@@ -107,6 +113,9 @@ static void telnet_log_callback(void *priv, const char *file, unsigned int line,
 		return;
 	}
 
+	/* Redraw in one go rather than one segment per fragment */
+	connection_cork(connection);
+
 	/* Clear the command line. */
 	tmp = strlen(t_con->prompt) + t_con->line_size;
 
@@ -129,6 +138,9 @@ static void telnet_log_callback(void *priv, const char *file, unsigned int line,
 
 	for (i = t_con->line_cursor; i < t_con->line_size; i++)
 		telnet_write(connection, "\b", 1);
+
+	if (connection_uncork(connection) < 0)
+		t_con->closed = true;
 }
 
 static void telnet_load_history(struct telnet_connection *t_con)
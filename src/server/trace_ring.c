@@ -0,0 +1,674 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include <helper/time_support.h>
+#include <target/target.h>
+
+#include "server.h"
+#include "trace_ring.h"
+
+/**
+ * @file
+ *
+ * Trace ring.
+ *
+ * Streaming data from the target (RTT channels, SWO, apptrace, ipdbg) is
+ * copied once into a ring buffer per stream. Any number of subscribers
+ * read from the ring at their own position and are handed pointers into
+ * the ring storage, so fanning out to several sinks costs no extra copies.
+ *
+ * OpenOCD runs the producers and the sinks from the same thread, so the
+ * ring only needs monotonically increasing positions, no locks. A
+ * subscriber that falls more than the ring size behind loses the oldest
+ * data and has it counted as dropped; a lossless subscriber instead makes
+ * the producer wait until the sink has taken the data. A lossless sink that
+ * stays busy for TRACE_RING_STALL_MS loses data too, which is counted the
+ * same way.
+ */
+
+#define TRACE_RING_MIN_SIZE		256
+#define TRACE_RING_DEFAULT_SIZE	(64 * 1024)
+#define TRACE_RING_RETRY_MS		10
+/* longest a busy lossless sink stalls the producer before it loses data */
+#define TRACE_RING_STALL_MS		1000
+
+#ifdef _WIN32
+#define TRACE_RING_SHUT_RDWR	SD_BOTH
+#else
+#define TRACE_RING_SHUT_RDWR	SHUT_RDWR
+#endif
+
+struct trace_ring {
+	struct list_head lh;
+	char *name;
+	uint8_t *buf;
+	/** power of two */
+	size_t size;
+	/** absolute stream position of the next byte to be written */
+	uint64_t head;
+	struct list_head subs;
+	/** a sink was busy, retry from a timer callback */
+	bool retry_pending;
+	/** guard against sinks (Tcl procs) feeding the ring they read */
+	bool flushing;
+};
+
+static OOCD_LIST_HEAD(all_trace_rings);
+
+struct trace_ring *trace_ring_find(const char *name)
+{
+	struct trace_ring *ring;
+
+	list_for_each_entry(ring, &all_trace_rings, lh)
+		if (!strcmp(ring->name, name))
+			return ring;
+
+	return NULL;
+}
+
+struct trace_ring *trace_ring_get(const char *name, size_t size)
+{
+	struct trace_ring *ring = trace_ring_find(name);
+	if (ring)
+		return ring;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+
+	ring->size = TRACE_RING_MIN_SIZE;
+	while (ring->size < size)
+		ring->size *= 2;
+
+	ring->name = strdup(name);
+	ring->buf = malloc(ring->size);
+	if (!ring->name || !ring->buf) {
+		LOG_ERROR("Out of memory");
+		free(ring->name);
+		free(ring->buf);
+		free(ring);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&ring->subs);
+	list_add_tail(&ring->lh, &all_trace_rings);
+
+	LOG_DEBUG("trace_ring: created %s, %zu bytes", ring->name, ring->size);
+	return ring;
+}
+
+static int trace_ring_retry(void *priv);
+
+void trace_ring_free(struct trace_ring *ring)
+{
+	if (!ring)
+		return;
+
+	struct trace_ring_sub *sub, *tmp;
+	list_for_each_entry_safe(sub, tmp, &ring->subs, lh) {
+		if (!sub->sink->orphan) {
+			trace_ring_unsubscribe(sub);
+			continue;
+		}
+		/* the owner still holds the subscriber and unsubscribes later */
+		list_del(&sub->lh);
+		sub->ring = NULL;
+		sub->sink->orphan(sub->priv);
+	}
+
+	if (ring->retry_pending)
+		target_unregister_timer_callback(trace_ring_retry, ring);
+
+	list_del(&ring->lh);
+	free(ring->name);
+	free(ring->buf);
+	free(ring);
+}
+
+void trace_ring_free_all(void)
+{
+	struct trace_ring *ring, *tmp;
+
+	list_for_each_entry_safe(ring, tmp, &all_trace_rings, lh)
+		trace_ring_free(ring);
+}
+
+/* Offer @a len bytes to the sink until it stops taking them.
+ * Returns the number of bytes taken, or -1 if the sink failed. */
+static int trace_ring_deliver(struct trace_ring_sub *sub, const uint8_t *data, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		int retval = sub->sink->write(sub->priv, data + done, len - done);
+		if (retval < 0) {
+			LOG_ERROR("trace_ring: %s sink %s failed, detaching it",
+				sub->ring->name, sub->desc);
+			sub->failed = true;
+			return -1;
+		}
+		if (!retval)
+			break;
+		done += retval;
+	}
+
+	return done;
+}
+
+static int trace_ring_flush_sub(struct trace_ring_sub *sub)
+{
+	struct trace_ring *ring = sub->ring;
+
+	while (sub->cursor < ring->head) {
+		size_t offset = sub->cursor & (ring->size - 1);
+		size_t len = MIN(ring->head - sub->cursor, ring->size - offset);
+
+		int retval = trace_ring_deliver(sub, ring->buf + offset, len);
+		if (retval < 0)
+			return ERROR_FAIL;
+		sub->cursor += retval;
+		if ((size_t)retval < len)
+			break;
+	}
+
+	return ERROR_OK;
+}
+
+void trace_ring_append(struct trace_ring *ring, const uint8_t *data, size_t len)
+{
+	struct trace_ring_sub *sub;
+
+	if (!len)
+		return;
+
+	/* Lossless subscribers get what they are about to lose first, the
+	 * producer waits while their sink is busy. If the chunk is larger than
+	 * the whole ring, they get its head directly. */
+	list_for_each_entry(sub, &ring->subs, lh) {
+		int64_t timeout = timeval_ms() + TRACE_RING_STALL_MS;
+
+		while (sub->lossless && !sub->failed && ring->head + len - sub->cursor > ring->size) {
+			uint64_t cursor = sub->cursor;
+
+			trace_ring_flush_sub(sub);
+			if (!sub->failed && sub->cursor >= ring->head) {
+				size_t done = sub->cursor - ring->head;
+				int retval = trace_ring_deliver(sub, data + done, len - ring->size - done);
+				if (retval > 0)
+					sub->cursor += retval;
+			}
+
+			if (sub->cursor != cursor) {
+				timeout = timeval_ms() + TRACE_RING_STALL_MS;
+				continue;
+			}
+			/* give up, the data is counted as dropped below */
+			if (timeval_ms() > timeout)
+				break;
+			alive_sleep(1);
+		}
+	}
+
+	if (len > ring->size) {
+		data += len - ring->size;
+		ring->head += len - ring->size;
+		len = ring->size;
+	}
+
+	size_t offset = ring->head & (ring->size - 1);
+	size_t first = MIN(len, ring->size - offset);
+	memcpy(ring->buf + offset, data, first);
+	memcpy(ring->buf, data + first, len - first);
+	ring->head += len;
+
+	list_for_each_entry(sub, &ring->subs, lh) {
+		if (sub->failed || ring->head - sub->cursor <= ring->size)
+			continue;
+
+		uint64_t lost = ring->head - ring->size - sub->cursor;
+		if (!sub->dropped)
+			LOG_WARNING("trace_ring: %s sink %s can't keep up, dropping data",
+				ring->name, sub->desc);
+		sub->dropped += lost;
+		sub->cursor += lost;
+	}
+}
+
+int trace_ring_flush(struct trace_ring *ring)
+{
+	struct trace_ring_sub *sub, *tmp;
+	bool pending = false;
+	int retval = ERROR_OK;
+
+	if (ring->flushing)
+		return ERROR_OK;
+	ring->flushing = true;
+
+	list_for_each_entry_safe(sub, tmp, &ring->subs, lh) {
+		if (sub->failed)
+			continue;
+		if (trace_ring_flush_sub(sub) != ERROR_OK)
+			retval = ERROR_FAIL;
+		else if (sub->cursor < ring->head)
+			pending = true;
+	}
+
+	ring->flushing = false;
+
+	if (pending && !ring->retry_pending)
+		target_register_timer_callback(trace_ring_retry, TRACE_RING_RETRY_MS,
+			TARGET_TIMER_TYPE_PERIODIC, ring);
+	else if (!pending && ring->retry_pending)
+		target_unregister_timer_callback(trace_ring_retry, ring);
+	ring->retry_pending = pending;
+
+	return retval;
+}
+
+static int trace_ring_retry(void *priv)
+{
+	trace_ring_flush(priv);
+	return ERROR_OK;
+}
+
+int trace_ring_write(struct trace_ring *ring, const uint8_t *data, size_t len)
+{
+	trace_ring_append(ring, data, len);
+	return trace_ring_flush(ring);
+}
+
+struct trace_ring_sub *trace_ring_subscribe(struct trace_ring *ring,
+		const struct trace_ring_sink *sink, void *priv, const char *desc)
+{
+	struct trace_ring_sub *sub = calloc(1, sizeof(*sub));
+	if (!sub) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+
+	sub->desc = strdup(desc);
+	if (!sub->desc) {
+		LOG_ERROR("Out of memory");
+		free(sub);
+		return NULL;
+	}
+
+	sub->ring = ring;
+	sub->sink = sink;
+	sub->priv = priv;
+	sub->cursor = ring->head;
+	list_add_tail(&sub->lh, &ring->subs);
+
+	LOG_DEBUG("trace_ring: %s sink %s %s attached", ring->name, sink->name, desc);
+	return sub;
+}
+
+void trace_ring_unsubscribe(struct trace_ring_sub *sub)
+{
+	if (!sub)
+		return;
+
+	if (sub->ring) {
+		LOG_DEBUG("trace_ring: %s sink %s %s detached, %" PRIu64 " bytes dropped",
+			sub->ring->name, sub->sink->name, sub->desc, sub->dropped);
+
+		list_del(&sub->lh);
+		if (sub->sink->close)
+			sub->sink->close(sub->priv);
+	}
+	free(sub->desc);
+	free(sub);
+}
+
+static int trace_ring_connection_write(void *priv, const uint8_t *data, size_t len)
+{
+	struct connection *connection = priv;
+
+	int retval = connection_write(connection, data, len);
+	if (retval >= 0)
+		return retval;
+
+#ifdef _WIN32
+	bool busy = (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+	bool busy = (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+
+	return busy ? 0 : -1;
+}
+
+/* The ring is gone, make the server close the connection */
+static void trace_ring_connection_orphan(void *priv)
+{
+	struct connection *connection = priv;
+
+	if (connection->service->type == CONNECTION_TCP)
+		shutdown(connection->fd, TRACE_RING_SHUT_RDWR);
+}
+
+static const struct trace_ring_sink trace_ring_connection_sink = {
+	.name = "tcp",
+	.write = trace_ring_connection_write,
+	.orphan = trace_ring_connection_orphan,
+};
+
+struct trace_ring_sub *trace_ring_subscribe_connection(struct trace_ring *ring,
+		struct connection *connection, bool lossless)
+{
+	char desc[48];
+
+	if (connection->service->type == CONNECTION_TCP) {
+		snprintf(desc, sizeof(desc), "port %s, client port %u", connection->service->port,
+			ntohs(connection->sin.sin_port));
+		if (!lossless)
+			socket_nonblock(connection->fd_out);
+	} else {
+		snprintf(desc, sizeof(desc), "%s", connection->service->port);
+	}
+
+	struct trace_ring_sub *sub = trace_ring_subscribe(ring, &trace_ring_connection_sink,
+		connection, desc);
+	if (sub)
+		sub->lossless = lossless;
+	return sub;
+}
+
+static int trace_ring_file_write(void *priv, const uint8_t *data, size_t len)
+{
+	FILE *file = priv;
+
+	if (fwrite(data, 1, len, file) != len || fflush(file))
+		return -1;
+
+	return len;
+}
+
+static void trace_ring_file_close(void *priv)
+{
+	fclose(priv);
+}
+
+static const struct trace_ring_sink trace_ring_file_sink = {
+	.name = "file",
+	.write = trace_ring_file_write,
+	.close = trace_ring_file_close,
+};
+
+struct trace_ring_sub *trace_ring_subscribe_file(struct trace_ring *ring, const char *path)
+{
+	FILE *file = fopen(path, "ab");
+	if (!file) {
+		LOG_ERROR("Can't open trace destination file \"%s\"", path);
+		return NULL;
+	}
+
+	struct trace_ring_sub *sub = trace_ring_subscribe(ring, &trace_ring_file_sink, file, path);
+	if (!sub) {
+		fclose(file);
+		return NULL;
+	}
+
+	/* a file never pushes back, there is no reason to drop data for it */
+	sub->lossless = true;
+	return sub;
+}
+
+struct trace_ring_tcl {
+	Jim_Interp *interp;
+	Jim_Obj *cmd;
+};
+
+static int trace_ring_tcl_write(void *priv, const uint8_t *data, size_t len)
+{
+	struct trace_ring_tcl *tcl = priv;
+
+	Jim_Obj *arg = Jim_NewStringObj(tcl->interp, (const char *)data, len);
+	Jim_IncrRefCount(arg);
+	int retval = Jim_EvalObjPrefix(tcl->interp, tcl->cmd, 1, &arg);
+	Jim_DecrRefCount(tcl->interp, arg);
+
+	if (retval != JIM_OK) {
+		LOG_ERROR("trace_ring: Tcl sink %s: %s", Jim_GetString(tcl->cmd, NULL),
+			Jim_GetString(Jim_GetResult(tcl->interp), NULL));
+		return -1;
+	}
+
+	return len;
+}
+
+static void trace_ring_tcl_close(void *priv)
+{
+	struct trace_ring_tcl *tcl = priv;
+
+	Jim_DecrRefCount(tcl->interp, tcl->cmd);
+	free(tcl);
+}
+
+static const struct trace_ring_sink trace_ring_tcl_sink = {
+	.name = "tcl",
+	.write = trace_ring_tcl_write,
+	.close = trace_ring_tcl_close,
+};
+
+static int trace_ring_service_new_connection(struct connection *connection)
+{
+	const char *name = connection->service->priv;
+
+	struct trace_ring *ring = trace_ring_get(name, TRACE_RING_DEFAULT_SIZE);
+	if (!ring)
+		return ERROR_FAIL;
+
+	connection->priv = trace_ring_subscribe_connection(ring, connection, false);
+	return connection->priv ? ERROR_OK : ERROR_FAIL;
+}
+
+static int trace_ring_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	char dummy[64];
+	int bytes_read = connection_read(connection, dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read < 0) {
+#ifdef _WIN32
+		if (WSAGetLastError() == WSAEWOULDBLOCK)
+			return ERROR_OK;
+#else
+		if (errno == EAGAIN)
+			return ERROR_OK;
+#endif
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int trace_ring_service_connection_closed(struct connection *connection)
+{
+	trace_ring_unsubscribe(connection->priv);
+	connection->priv = NULL;
+	return ERROR_OK;
+}
+
+static const struct service_driver trace_ring_service_driver = {
+	.name = "trace_ring",
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = trace_ring_service_new_connection,
+	.input_handler = trace_ring_service_input,
+	.connection_closed_handler = trace_ring_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+COMMAND_HANDLER(handle_trace_ring_list_command)
+{
+	struct trace_ring *ring;
+	struct trace_ring_sub *sub;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	list_for_each_entry(ring, &all_trace_rings, lh) {
+		command_print(CMD, "%s: %zu bytes, %" PRIu64 " written",
+			ring->name, ring->size, ring->head);
+		list_for_each_entry(sub, &ring->subs, lh)
+			command_print(CMD, "    %-4s %-32s pending %" PRIu64 ", dropped %" PRIu64 "%s%s",
+				sub->sink->name, sub->desc, ring->head - sub->cursor, sub->dropped,
+				sub->lossless ? ", lossless" : "", sub->failed ? ", FAILED" : "");
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_trace_ring_file_command)
+{
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct trace_ring *ring = trace_ring_get(CMD_ARGV[0], TRACE_RING_DEFAULT_SIZE);
+	if (!ring)
+		return ERROR_FAIL;
+
+	struct trace_ring_sub *sub = trace_ring_subscribe_file(ring, CMD_ARGV[1]);
+	if (!sub)
+		return ERROR_FAIL;
+	sub->from_command = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_trace_ring_tcl_command)
+{
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct trace_ring *ring = trace_ring_get(CMD_ARGV[0], TRACE_RING_DEFAULT_SIZE);
+	if (!ring)
+		return ERROR_FAIL;
+
+	struct trace_ring_tcl *tcl = malloc(sizeof(*tcl));
+	if (!tcl) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	tcl->interp = CMD_CTX->interp;
+	tcl->cmd = Jim_NewStringObj(tcl->interp, CMD_ARGV[1], -1);
+	Jim_IncrRefCount(tcl->cmd);
+
+	struct trace_ring_sub *sub = trace_ring_subscribe(ring, &trace_ring_tcl_sink, tcl, CMD_ARGV[1]);
+	if (!sub) {
+		trace_ring_tcl_close(tcl);
+		return ERROR_FAIL;
+	}
+	sub->lossless = true;
+	sub->from_command = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_trace_ring_server_command)
+{
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	char *name = strdup(CMD_ARGV[0]);
+	if (!name) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = add_service(&trace_ring_service_driver, CMD_ARGV[1],
+		CONNECTION_LIMIT_UNLIMITED, name);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "Can't start trace ring server on port %s", CMD_ARGV[1]);
+		free(name);
+	}
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_trace_ring_stop_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct trace_ring *ring = trace_ring_find(CMD_ARGV[0]);
+	if (!ring) {
+		/* maybe a server port */
+		if (remove_service(trace_ring_service_driver.name, CMD_ARGV[0]) == ERROR_OK)
+			return ERROR_OK;
+		command_print(CMD, "No trace ring or trace ring server \"%s\"", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct trace_ring_sub *sub, *tmp;
+	list_for_each_entry_safe(sub, tmp, &ring->subs, lh)
+		if (sub->from_command)
+			trace_ring_unsubscribe(sub);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration trace_ring_subcommand_handlers[] = {
+	{
+		.name = "list",
+		.handler = handle_trace_ring_list_command,
+		.mode = COMMAND_ANY,
+		.help = "List trace rings with their subscribers",
+		.usage = "",
+	},
+	{
+		.name = "file",
+		.handler = handle_trace_ring_file_command,
+		.mode = COMMAND_ANY,
+		.help = "Append the data of a trace ring to a file",
+		.usage = "ring filename",
+	},
+	{
+		.name = "tcl",
+		.handler = handle_trace_ring_tcl_command,
+		.mode = COMMAND_ANY,
+		.help = "Call a Tcl command with each chunk of data of a trace ring",
+		.usage = "ring command",
+	},
+	{
+		.name = "server",
+		.handler = handle_trace_ring_server_command,
+		.mode = COMMAND_ANY,
+		.help = "Serve the data of a trace ring to TCP clients",
+		.usage = "ring port",
+	},
+	{
+		.name = "stop",
+		.handler = handle_trace_ring_stop_command,
+		.mode = COMMAND_ANY,
+		.help = "Remove the file and Tcl subscribers of a trace ring, "
+			"or stop a trace ring server",
+		.usage = "ring|port",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration trace_ring_command_handlers[] = {
+	{
+		.name = "trace_ring",
+		.mode = COMMAND_ANY,
+		.help = "streaming trace data rings",
+		.usage = "",
+		.chain = trace_ring_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int trace_ring_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, trace_ring_command_handlers);
+}
@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_SERVER_TRACE_RING_H
+#define OPENOCD_SERVER_TRACE_RING_H
+
+#include <helper/command.h>
+#include <helper/list.h>
+
+struct connection;
+
+/**
+ * A consumer of trace ring data. The ring hands out pointers into its own
+ * storage, so a sink must not keep them past the call.
+ */
+struct trace_ring_sink {
+	/** Short type name, shown by "trace_ring list". */
+	const char *name;
+	/**
+	 * Consume up to @a len bytes at @a data.
+	 * @returns the number of bytes taken, 0 if the sink is busy and wants
+	 * the data offered again later, or a negative value on a fatal error.
+	 */
+	int (*write)(void *priv, const uint8_t *data, size_t len);
+	/** Release @a priv, called when the subscriber goes away. Optional. */
+	void (*close)(void *priv);
+	/**
+	 * Called instead of close() when the ring is freed under a subscriber
+	 * that its owner still holds, e.g. in a connection's priv. The owner
+	 * must still call trace_ring_unsubscribe(), which then only frees the
+	 * subscriber. Optional; without it the subscriber is freed with the ring.
+	 */
+	void (*orphan)(void *priv);
+};
+
+struct trace_ring;
+
+/** One reader of a ring, with its own position and overflow count. */
+struct trace_ring_sub {
+	struct list_head lh;
+	/** NULL once the ring was freed under an orphaned subscriber */
+	struct trace_ring *ring;
+	const struct trace_ring_sink *sink;
+	void *priv;
+	/** user visible description, e.g. the file name */
+	char *desc;
+	/** absolute stream position of the next byte to hand to the sink */
+	uint64_t cursor;
+	/** bytes overwritten before this subscriber could take them */
+	uint64_t dropped;
+	/** never drop data for this subscriber, stall the producer instead */
+	bool lossless;
+	/** the sink returned an error, no more data is delivered */
+	bool failed;
+	/** created by the "trace_ring" command, removed by "trace_ring stop" */
+	bool from_command;
+};
+
+/**
+ * Find the ring called @a name, or create it with room for at least
+ * @a size bytes. Producers own the rings they create.
+ */
+struct trace_ring *trace_ring_get(const char *name, size_t size);
+struct trace_ring *trace_ring_find(const char *name);
+/** Remove @a ring and all of its subscribers. */
+void trace_ring_free(struct trace_ring *ring);
+void trace_ring_free_all(void);
+
+/** Queue @a len bytes without handing them to the sinks yet. */
+void trace_ring_append(struct trace_ring *ring, const uint8_t *data, size_t len);
+/**
+ * Hand all pending data to the sinks. Sinks that are busy are retried from
+ * a timer until they catch up.
+ * @returns ERROR_FAIL if a subscriber failed during this call.
+ */
+int trace_ring_flush(struct trace_ring *ring);
+/** trace_ring_append() followed by trace_ring_flush(). */
+int trace_ring_write(struct trace_ring *ring, const uint8_t *data, size_t len);
+
+struct trace_ring_sub *trace_ring_subscribe(struct trace_ring *ring,
+		const struct trace_ring_sink *sink, void *priv, const char *desc);
+void trace_ring_unsubscribe(struct trace_ring_sub *sub);
+
+/**
+ * Subscribe a server connection. A lossless subscriber keeps its socket
+ * blocking and stalls the producer; otherwise the socket is switched to
+ * non-blocking and data the client can't take in time is counted as dropped.
+ */
+struct trace_ring_sub *trace_ring_subscribe_connection(struct trace_ring *ring,
+		struct connection *connection, bool lossless);
+/** Append everything written to @a ring to the file @a path. */
+struct trace_ring_sub *trace_ring_subscribe_file(struct trace_ring *ring, const char *path);
+
+int trace_ring_register_commands(struct command_context *cmd_ctx);
+
+#endif /* OPENOCD_SERVER_TRACE_RING_H */
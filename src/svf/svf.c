@@ -861,6 +861,13 @@ static int svf_set_padding(struct svf_xxr_para *para, int len, unsigned char tdi
 	return error;
 }
 
+/* value + 1 of each hex digit accepted in SVF data, 0 for anything else */
+static const uint8_t svf_hex_digit[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
 static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_len, int bit_len)
 {
 	int i, str_len = strlen(str), str_hbyte_len = (bit_len + 3) >> 2;
@@ -871,8 +878,25 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 		return ERROR_FAIL;
 	}
 
-	/* fill from LSB (end of str) to MSB (beginning of str) */
-	for (i = 0; i < str_hbyte_len; i++) {
+	/*
+	 * Fill from LSB (end of str) to MSB (beginning of str). Long runs of
+	 * digits without whitespace, the common case in large SVF files, are
+	 * converted a whole byte at a time.
+	 */
+	i = 0;
+	while (i + 1 < str_hbyte_len && str_len >= 2) {
+		uint8_t lo = svf_hex_digit[(uint8_t)str[str_len - 1]];
+		uint8_t hi = svf_hex_digit[(uint8_t)str[str_len - 2]];
+		if (!lo || !hi)
+			break;
+
+		(*bin)[i / 2] = (lo - 1) | ((hi - 1) << 4);
+		str_len -= 2;
+		i += 2;
+		ch = hi - 1;
+	}
+
+	for (; i < str_hbyte_len; i++) {
 		ch = 0;
 		while (str_len > 0) {
 			ch = str[--str_len];
@@ -884,11 +908,8 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 			 * a hard limit on line length.
 			 */
 			if (!isspace(ch)) {
-				if ((ch >= '0') && (ch <= '9')) {
-					ch = ch - '0';
-					break;
-				} else if ((ch >= 'A') && (ch <= 'F')) {
-					ch = ch - 'A' + 10;
+				if (svf_hex_digit[ch]) {
+					ch = svf_hex_digit[ch] - 1;
 					break;
 				} else {
 					LOG_ERROR("invalid hex string");
@@ -924,18 +945,51 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 	return ERROR_OK;
 }
 
+/**
+ * Assemble header, body and trailer of a scan into the shared scan buffers
+ * at @a buffer_index and register the TDO check for it.
+ * @returns the number of bits in the scan.
+ */
+static int svf_assemble_scan(struct svf_xxr_para *head, struct svf_xxr_para *body,
+		struct svf_xxr_para *tail, int buffer_index)
+{
+	struct svf_xxr_para *parts[] = { head, body, tail };
+	int len = 0;
+
+	/* with byte aligned parts, buf_set_buf() reduces to a single copy each */
+	for (unsigned int n = 0; n < ARRAY_SIZE(parts); n++) {
+		if (!parts[n]->len)
+			continue;
+
+		buf_set_buf(parts[n]->tdi, 0, &svf_tdi_buffer[buffer_index], len, parts[n]->len);
+		if (body->data_mask & XXR_TDO) {
+			buf_set_buf(parts[n]->mask, 0, &svf_mask_buffer[buffer_index], len, parts[n]->len);
+			buf_set_buf(parts[n]->tdo, 0, &svf_tdo_buffer[buffer_index], len, parts[n]->len);
+		}
+		len += parts[n]->len;
+	}
+
+	svf_add_check_para((body->data_mask & XXR_TDO) ? 1 : 0, buffer_index, len);
+
+	return len;
+}
+
 static int svf_check_tdo(void)
 {
 	int i, len, index_var;
+	unsigned int mismatch;
 
 	for (i = 0; i < svf_check_tdo_para_index; i++) {
+		if (!svf_check_tdo_para[i].enabled)
+			continue;
+
 		index_var = svf_check_tdo_para[i].buffer_offset;
 		len = svf_check_tdo_para[i].bit_len;
-		if ((svf_check_tdo_para[i].enabled)
-				&& !buf_eq_mask(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
-				&svf_mask_buffer[index_var], len)) {
-			LOG_ERROR("tdo check error at line %d",
-				svf_check_tdo_para[i].line_num);
+		mismatch = buf_find_mask_mismatch(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
+				&svf_mask_buffer[index_var], len);
+		if (mismatch != (unsigned int)len) {
+			LOG_ERROR("tdo check error at line %d, first mismatch at bit %u",
+				svf_check_tdo_para[i].line_num, mismatch);
 			SVF_BUF_LOG(ERROR, &svf_tdi_buffer[index_var], len, "READ");
 			SVF_BUF_LOG(ERROR, &svf_tdo_buffer[index_var], len, "WANT");
 			SVF_BUF_LOG(ERROR, &svf_mask_buffer[index_var], len, "MASK");
@@ -1198,73 +1252,8 @@ xxr_common:
 					}
 				}
 
-				/* assemble dr data */
-				i = 0;
-				buf_set_buf(svf_para.hdr_para.tdi,
-						0,
-						&svf_tdi_buffer[svf_buffer_index],
-						i,
-						svf_para.hdr_para.len);
-				i += svf_para.hdr_para.len;
-				buf_set_buf(svf_para.sdr_para.tdi,
-						0,
-						&svf_tdi_buffer[svf_buffer_index],
-						i,
-						svf_para.sdr_para.len);
-				i += svf_para.sdr_para.len;
-				buf_set_buf(svf_para.tdr_para.tdi,
-						0,
-						&svf_tdi_buffer[svf_buffer_index],
-						i,
-						svf_para.tdr_para.len);
-				i += svf_para.tdr_para.len;
-
-				/* add check data */
-				if (svf_para.sdr_para.data_mask & XXR_TDO) {
-					/* assemble dr mask data */
-					i = 0;
-					buf_set_buf(svf_para.hdr_para.mask,
-							0,
-							&svf_mask_buffer[svf_buffer_index],
-							i,
-							svf_para.hdr_para.len);
-					i += svf_para.hdr_para.len;
-					buf_set_buf(svf_para.sdr_para.mask,
-							0,
-							&svf_mask_buffer[svf_buffer_index],
-							i,
-							svf_para.sdr_para.len);
-					i += svf_para.sdr_para.len;
-					buf_set_buf(svf_para.tdr_para.mask,
-							0,
-							&svf_mask_buffer[svf_buffer_index],
-							i,
-							svf_para.tdr_para.len);
-
-					/* assemble dr check data */
-					i = 0;
-					buf_set_buf(svf_para.hdr_para.tdo,
-							0,
-							&svf_tdo_buffer[svf_buffer_index],
-							i,
-							svf_para.hdr_para.len);
-					i += svf_para.hdr_para.len;
-					buf_set_buf(svf_para.sdr_para.tdo,
-							0,
-							&svf_tdo_buffer[svf_buffer_index],
-							i,
-							svf_para.sdr_para.len);
-					i += svf_para.sdr_para.len;
-					buf_set_buf(svf_para.tdr_para.tdo,
-							0,
-							&svf_tdo_buffer[svf_buffer_index],
-							i,
-							svf_para.tdr_para.len);
-					i += svf_para.tdr_para.len;
-
-					svf_add_check_para(1, svf_buffer_index, i);
-				} else
-					svf_add_check_para(0, svf_buffer_index, i);
+				i = svf_assemble_scan(&svf_para.hdr_para, &svf_para.sdr_para,
+						&svf_para.tdr_para, svf_buffer_index);
 				field.num_bits = i;
 				field.out_value = &svf_tdi_buffer[svf_buffer_index];
 				field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
@@ -1291,73 +1280,8 @@ xxr_common:
 					}
 				}
 
-				/* assemble ir data */
-				i = 0;
-				buf_set_buf(svf_para.hir_para.tdi,
-						0,
-						&svf_tdi_buffer[svf_buffer_index],
-						i,
-						svf_para.hir_para.len);
-				i += svf_para.hir_para.len;
-				buf_set_buf(svf_para.sir_para.tdi,
-						0,
-						&svf_tdi_buffer[svf_buffer_index],
-						i,
-						svf_para.sir_para.len);
-				i += svf_para.sir_para.len;
-				buf_set_buf(svf_para.tir_para.tdi,
-						0,
-						&svf_tdi_buffer[svf_buffer_index],
-						i,
-						svf_para.tir_para.len);
-				i += svf_para.tir_para.len;
-
-				/* add check data */
-				if (svf_para.sir_para.data_mask & XXR_TDO) {
-					/* assemble dr mask data */
-					i = 0;
-					buf_set_buf(svf_para.hir_para.mask,
-							0,
-							&svf_mask_buffer[svf_buffer_index],
-							i,
-							svf_para.hir_para.len);
-					i += svf_para.hir_para.len;
-					buf_set_buf(svf_para.sir_para.mask,
-							0,
-							&svf_mask_buffer[svf_buffer_index],
-							i,
-							svf_para.sir_para.len);
-					i += svf_para.sir_para.len;
-					buf_set_buf(svf_para.tir_para.mask,
-							0,
-							&svf_mask_buffer[svf_buffer_index],
-							i,
-							svf_para.tir_para.len);
-
-					/* assemble dr check data */
-					i = 0;
-					buf_set_buf(svf_para.hir_para.tdo,
-							0,
-							&svf_tdo_buffer[svf_buffer_index],
-							i,
-							svf_para.hir_para.len);
-					i += svf_para.hir_para.len;
-					buf_set_buf(svf_para.sir_para.tdo,
-							0,
-							&svf_tdo_buffer[svf_buffer_index],
-							i,
-							svf_para.sir_para.len);
-					i += svf_para.sir_para.len;
-					buf_set_buf(svf_para.tir_para.tdo,
-							0,
-							&svf_tdo_buffer[svf_buffer_index],
-							i,
-							svf_para.tir_para.len);
-					i += svf_para.tir_para.len;
-
-					svf_add_check_para(1, svf_buffer_index, i);
-				} else
-					svf_add_check_para(0, svf_buffer_index, i);
+				i = svf_assemble_scan(&svf_para.hir_para, &svf_para.sir_para,
+						&svf_para.tir_para, svf_buffer_index);
 				field.num_bits = i;
 				field.out_value = &svf_tdi_buffer[svf_buffer_index];
 				field.in_value = (xxr_para_tmp->data_mask & XXR_TDO) ? &svf_tdi_buffer[svf_buffer_index] : NULL;
@@ -29,6 +29,7 @@
 #include "arm_adi_v5.h"
 #include <helper/time_support.h>
 #include <helper/list.h>
+#include <jtag/adapter.h>
 #include <jtag/swd.h>
 
 /*#define DEBUG_WAIT*/
@@ -453,6 +454,7 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 		} else {
 			LOG_ERROR("Invalid ACK (%1x) in DAP response", el->ack);
 			log_dap_cmd(dap, "ERR", el);
+			adapter_speed_auto_error();
 			retval = ERROR_JTAG_DEVICE_ERROR;
 			goto done;
 		}
@@ -518,6 +520,7 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 					if (tmp->ack != JTAG_ACK_WAIT) {
 						LOG_ERROR("Invalid ACK (%1x) in DAP response", tmp->ack);
 						log_dap_cmd(dap, "ERR", tmp);
+						adapter_speed_auto_error();
 						retval = ERROR_JTAG_DEVICE_ERROR;
 						break;
 					}
@@ -39,6 +39,7 @@
 #include <helper/time_support.h>
 
 #include <transport/transport.h>
+#include <jtag/adapter.h>
 #include <jtag/interface.h>
 
 #include <jtag/swd.h>
@@ -50,42 +51,201 @@ static struct adiv5_dap *swd_multidrop_selected_dap;
 
 static bool swd_multidrop_in_swd_state;
 
+/* Give up resuming a queue stalled by WAIT after this time */
+#define SWD_WAIT_RECOVERY_TIMEOUT	1000
+/* Range of the idle cycles learned after WAIT responses */
+#define SWD_WAIT_IDLE_MIN	8
+#define SWD_WAIT_IDLE_MAX	1024
+
+/*
+ * Journal of the transactions queued to the SWD driver since the last run.
+ * When the driver reports how far the queue got, a batch stalled by WAIT
+ * is resumed from the failing transaction instead of being failed back to
+ * the caller as a whole.
+ */
+struct swd_journal_entry {
+	uint8_t cmd;
+	uint32_t data;
+	uint32_t *dst;
+	/* AP of an AP access, NULL for DP access */
+	struct adiv5_ap *ap;
+};
+
+static struct swd_journal_entry *swd_journal;
+static unsigned int swd_journal_len;
+static unsigned int swd_journal_size;
+/* false if the journal does not mirror the driver queue (sequences, OOM) */
+static bool swd_journal_valid = true;
+
 
 static int swd_queue_dp_write_inner(struct adiv5_dap *dap, unsigned int reg,
 		uint32_t data);
 
 
+static void swd_journal_reset(void)
+{
+	swd_journal_len = 0;
+	swd_journal_valid = true;
+}
+
+static void swd_journal_add(uint8_t cmd, uint32_t data, uint32_t *dst,
+		struct adiv5_ap *ap)
+{
+	if (!swd_journal_valid)
+		return;
+
+	if (swd_journal_len == swd_journal_size) {
+		unsigned int size = swd_journal_size ? 2 * swd_journal_size : 64;
+		struct swd_journal_entry *journal = realloc(swd_journal, size * sizeof(*journal));
+		if (!journal) {
+			swd_journal_valid = false;
+			return;
+		}
+		swd_journal = journal;
+		swd_journal_size = size;
+	}
+
+	struct swd_journal_entry *el = &swd_journal[swd_journal_len++];
+	el->cmd = cmd;
+	el->data = data;
+	el->dst = dst;
+	el->ap = ap;
+}
+
+/* Idle cycles after an AP access: configured plus learned from WAITs */
+static uint32_t swd_ap_delay(struct adiv5_ap *ap)
+{
+	return ap ? ap->memaccess_tck + ap->wait_idle_tck : 0;
+}
+
+static void swd_queue_read_reg(struct adiv5_dap *dap, uint8_t cmd,
+		uint32_t *dst, struct adiv5_ap *ap)
+{
+	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
+	assert(swd);
+
+	swd_journal_add(cmd, 0, dst, ap);
+	swd->read_reg(cmd, dst, swd_ap_delay(ap));
+}
+
+static void swd_queue_write_reg(struct adiv5_dap *dap, uint8_t cmd,
+		uint32_t data, struct adiv5_ap *ap)
+{
+	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
+	assert(swd);
+
+	swd_journal_add(cmd, data, NULL, ap);
+	swd->write_reg(cmd, data, swd_ap_delay(ap));
+}
+
 static int swd_send_sequence(struct adiv5_dap *dap, enum swd_special_seq seq)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
 	assert(swd);
 
+	/* sequences are not journaled, the queue cannot be resumed */
+	swd_journal_valid = false;
+
 	return swd->switch_seq(seq);
 }
 
 static void swd_finish_read(struct adiv5_dap *dap)
 {
-	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
 	if (dap->last_read) {
-		swd->read_reg(swd_cmd(true, false, DP_RDBUFF), dap->last_read, 0);
+		swd_queue_read_reg(dap, swd_cmd(true, false, DP_RDBUFF), dap->last_read, NULL);
 		dap->last_read = NULL;
 	}
 }
 
 static void swd_clear_sticky_errors(struct adiv5_dap *dap)
+{
+	swd_queue_write_reg(dap, swd_cmd(false, false, DP_ABORT),
+		STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, NULL);
+}
+
+static int swd_run_inner(struct adiv5_dap *dap)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
-	assert(swd);
 
-	swd->write_reg(swd_cmd(false, false, DP_ABORT),
-		STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, 0);
+	int retval = swd->run();
+	swd_journal_reset();
+	/* JUNK and parity errors; FAULT is the target refusing the access */
+	if (retval == ERROR_SWD_FAIL)
+		adapter_speed_auto_error();
+
+	return retval;
 }
 
-static int swd_run_inner(struct adiv5_dap *dap)
+/**
+ * The AP access which kept the AP busy is the failing transaction itself
+ * or the last AP access before it. Give that AP more idle cycles after
+ * each access so the following batches do not stall again.
+ */
+static void swd_wait_learn(unsigned int failed)
+{
+	for (unsigned int i = failed + 1; i-- > 0; ) {
+		struct adiv5_ap *ap = swd_journal[i].ap;
+		if (!ap)
+			continue;
+
+		if (ap->wait_idle_tck < SWD_WAIT_IDLE_MAX) {
+			ap->wait_idle_tck = MAX(2 * ap->wait_idle_tck, SWD_WAIT_IDLE_MIN);
+			ap->wait_idle_tck = MIN(ap->wait_idle_tck, SWD_WAIT_IDLE_MAX);
+			LOG_DEBUG("AP#0x%" PRIx64 " stalled (WAIT), idle cycles after access raised to %" PRIu32,
+				ap->ap_num, swd_ap_delay(ap));
+		}
+		return;
+	}
+}
+
+/**
+ * Run the queue and resume it after WAIT responses. The transactions
+ * before the failing one have completed, sticky overrun is cleared and
+ * the rest of the batch is queued again with the learned idle cycles.
+ */
+static int swd_run_resume(struct adiv5_dap *dap)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
+	int64_t timeout = timeval_ms() + SWD_WAIT_RECOVERY_TIMEOUT;
+	int retval;
+
+	for (;;) {
+		retval = swd->run();
+		if (retval != ERROR_WAIT || !swd->completed_count || !swd_journal_valid)
+			break;
 
-	return swd->run();
+		unsigned int completed = swd->completed_count();
+		if (completed >= swd_journal_len || timeval_ms() > timeout)
+			break;
+
+		swd_wait_learn(completed);
+
+		unsigned int count = swd_journal_len - completed;
+		struct swd_journal_entry *replay = malloc(count * sizeof(*replay));
+		if (!replay)
+			break;
+		memcpy(replay, &swd_journal[completed], count * sizeof(*replay));
+
+		LOG_DEBUG_IO("SWD WAIT at transaction %u, resending %u", completed, count);
+
+		swd_journal_reset();
+		swd_clear_sticky_errors(dap);
+		for (unsigned int i = 0; i < count; i++) {
+			struct swd_journal_entry *el = &replay[i];
+			if (el->cmd & SWD_CMD_RNW)
+				swd_queue_read_reg(dap, el->cmd, el->dst, el->ap);
+			else
+				swd_queue_write_reg(dap, el->cmd, el->data, el->ap);
+		}
+		free(replay);
+	}
+
+	swd_journal_reset();
+	/* JUNK and parity errors; FAULT is the target refusing the access */
+	if (retval == ERROR_SWD_FAIL)
+		adapter_speed_auto_error();
+
+	return retval;
 }
 
 static inline int check_sync(struct adiv5_dap *dap)
@@ -122,14 +282,11 @@ static int swd_queue_dp_bankselect(struct adiv5_dap *dap, unsigned int reg)
 static int swd_queue_dp_read_inner(struct adiv5_dap *dap, unsigned int reg,
 		uint32_t *data)
 {
-	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
-	assert(swd);
-
 	int retval = swd_queue_dp_bankselect(dap, reg);
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->read_reg(swd_cmd(true, false, reg), data, 0);
+	swd_queue_read_reg(dap, swd_cmd(true, false, reg), data, NULL);
 
 	return check_sync(dap);
 }
@@ -138,15 +295,13 @@ static int swd_queue_dp_write_inner(struct adiv5_dap *dap, unsigned int reg,
 		uint32_t data)
 {
 	int retval = ERROR_OK;
-	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
-	assert(swd);
 
 	swd_finish_read(dap);
 
 	if (reg == DP_SELECT) {
 		dap->select = data | (dap->select & (0xffffffffull << 32));
 
-		swd->write_reg(swd_cmd(false, false, reg), data, 0);
+		swd_queue_write_reg(dap, swd_cmd(false, false, reg), data, NULL);
 
 		retval = check_sync(dap);
 		dap->select_valid = (retval == ERROR_OK);
@@ -164,7 +319,7 @@ static int swd_queue_dp_write_inner(struct adiv5_dap *dap, unsigned int reg,
 		retval = swd_queue_dp_bankselect(dap, reg);
 
 	if (retval == ERROR_OK) {
-		swd->write_reg(swd_cmd(false, false, reg), data, 0);
+		swd_queue_write_reg(dap, swd_cmd(false, false, reg), data, NULL);
 
 		retval = check_sync(dap);
 	}
@@ -325,12 +480,44 @@ static int swd_connect_multidrop(struct adiv5_dap *dap)
 	}
 
 	swd_multidrop_in_swd_state = true;
+	dap->dpidr = dpidr;
 	LOG_INFO("SWD DPIDR 0x%08" PRIx32 ", DLPIDR 0x%08" PRIx32,
 			  dpidr, dlpidr);
 
 	return retval;
 }
 
+/* "adapter speed auto" link check: line reset, then DPIDR must read back
+ * the value seen at connect time on every access.
+ */
+static int swd_speed_test(void *priv)
+{
+	struct adiv5_dap *dap = priv;
+	uint32_t dpidr[4];
+	int retval;
+
+	swd_send_sequence(dap, LINE_RESET);
+	dap_invalidate_cache(dap);
+	dap->select_dpbanksel_valid = true;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(dpidr); i++) {
+		dpidr[i] = ~dap->dpidr;
+		retval = swd_queue_dp_read_inner(dap, DP_DPIDR, &dpidr[i]);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	retval = swd_run_inner(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(dpidr); i++) {
+		if (dpidr[i] != dap->dpidr)
+			return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 static int swd_connect_single(struct adiv5_dap *dap)
 {
 	int retval;
@@ -382,8 +569,16 @@ static int swd_connect_single(struct adiv5_dap *dap)
 		return retval;
 	}
 
+	/* a reconnect reading a different DPIDR means a garbled link */
+	if (dap->dpidr && dpidr != dap->dpidr)
+		adapter_speed_auto_error();
+
+	dap->dpidr = dpidr;
 	LOG_INFO("SWD DPIDR 0x%08" PRIx32, dpidr);
 
+	if (adapter_speed_is_auto())
+		adapter_speed_autotune(swd_speed_test, dap);
+
 	do {
 		dap->do_reconnect = false;
 
@@ -469,9 +664,6 @@ static int swd_check_reconnect(struct adiv5_dap *dap)
 
 static int swd_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 {
-	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
-	assert(swd);
-
 	/* TODO: Send DAPABORT in swd_multidrop_select_inner()
 	 * in the case the multidrop dap is not selected?
 	 * swd_queue_ap_abort() is not currently used anyway...
@@ -480,8 +672,8 @@ static int swd_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->write_reg(swd_cmd(false, false, DP_ABORT),
-		DAPABORT | STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, 0);
+	swd_queue_write_reg(dap, swd_cmd(false, false, DP_ABORT),
+		DAPABORT | STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, NULL);
 	return check_sync(dap);
 }
 
@@ -568,8 +760,6 @@ static int swd_queue_ap_read(struct adiv5_ap *ap, unsigned int reg,
 		uint32_t *data)
 {
 	struct adiv5_dap *dap = ap->dap;
-	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
-	assert(swd);
 
 	int retval = swd_check_reconnect(dap);
 	if (retval != ERROR_OK)
@@ -583,7 +773,7 @@ static int swd_queue_ap_read(struct adiv5_ap *ap, unsigned int reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->read_reg(swd_cmd(true, true, reg), dap->last_read, ap->memaccess_tck);
+	swd_queue_read_reg(dap, swd_cmd(true, true, reg), dap->last_read, ap);
 	dap->last_read = data;
 
 	return check_sync(dap);
@@ -593,8 +783,6 @@ static int swd_queue_ap_write(struct adiv5_ap *ap, unsigned int reg,
 		uint32_t data)
 {
 	struct adiv5_dap *dap = ap->dap;
-	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
-	assert(swd);
 
 	int retval = swd_check_reconnect(dap);
 	if (retval != ERROR_OK)
@@ -610,7 +798,7 @@ static int swd_queue_ap_write(struct adiv5_ap *ap, unsigned int reg,
 	if (retval != ERROR_OK)
 		return retval;
 
-	swd->write_reg(swd_cmd(false, true, reg), data, ap->memaccess_tck);
+	swd_queue_write_reg(dap, swd_cmd(false, true, reg), data, ap);
 
 	return check_sync(dap);
 }
@@ -624,7 +812,7 @@ static int swd_run(struct adiv5_dap *dap)
 
 	swd_finish_read(dap);
 
-	retval = swd_run_inner(dap);
+	retval = swd_run_resume(dap);
 	if (retval != ERROR_OK) {
 		/* fault response */
 		dap->do_reconnect = true;
@@ -669,6 +857,11 @@ static void swd_quit(struct adiv5_dap *dap)
 
 	/* flush the queue to shift out the sequence before exit */
 	swd->run();
+
+	swd_journal_reset();
+	free(swd_journal);
+	swd_journal = NULL;
+	swd_journal_size = 0;
 }
 
 const struct dap_ops swd_dap_ops = {
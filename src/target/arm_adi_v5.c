@@ -512,6 +512,16 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 	if (ap->unaligned_access_bad && (address % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
+	if (dap->ops->mem_ap_write_buf && !dap->ti_be_32_quirks) {
+		retval = dap->ops->mem_ap_write_buf(ap, buffer, size, count, address, addrinc);
+		if (retval != ERROR_NOT_IMPLEMENTED) {
+			/* The adapter left CSW and TAR in an unknown state */
+			ap->csw_value = 0;
+			ap->tar_valid = false;
+			return retval;
+		}
+	}
+
 	/* Nuvoton NPCX quirks prevent packed writes */
 	bool pack = !dap->nu_npcx_quirks;
 
@@ -601,12 +611,83 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
  *  should normally be true, except when reading from e.g. a FIFO.
  * @return ERROR_OK on success, otherwise an error code.
  */
+/**
+ * Queue the DRW reads of one memory read. Each read stores the entire DRW word
+ * at *read_ptr, which is advanced past them. How many useful bytes a word
+ * contains, and their location in the word, depends on the type of transfer and
+ * alignment; mem_ap_read_unpack() sorts that out once the queue has run.
+ */
+static int mem_ap_read_queue(struct adiv5_ap *ap, uint32_t size, uint32_t count,
+		target_addr_t address, bool addrinc, uint32_t **read_ptr)
+{
+	size_t nbytes = size * count;
+	int retval = ERROR_OK;
+
+	while (nbytes > 0) {
+		unsigned int this_size;
+		retval = mem_ap_setup_transfer_verify_size_packing_fallback(ap,
+					size, address,
+					addrinc, nbytes >= 4, &this_size);
+		if (retval != ERROR_OK)
+			break;
+
+
+		unsigned int drw_ops = DIV_ROUND_UP(this_size, 4);
+		while (drw_ops--) {
+			retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW(ap->dap), (*read_ptr)++);
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		nbytes -= this_size;
+		if (addrinc)
+			address += this_size;
+
+		mem_ap_update_tar_cache(ap);
+	}
+
+	return retval;
+}
+
+/* Replay loop to populate caller's buffer from the correct word and byte lane */
+static const uint32_t *mem_ap_read_unpack(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size,
+		size_t nbytes, target_addr_t address, bool addrinc, const uint32_t *read_ptr)
+{
+	target_addr_t ti_be_lane_xor = ap->dap->ti_be_32_quirks ? 3 : 0;
+
+	while (nbytes > 0) {
+		/* Convert transfers longer than 32-bit on word-at-a-time basis */
+		unsigned int this_size = MIN(size, 4);
+
+		if (size < 4 && addrinc && ap->packed_transfers_supported && nbytes >= 4
+				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
+			this_size = 4;	/* Packed read of 4 bytes or 2 halfwords */
+		}
+
+		switch (this_size) {
+		case 4:
+			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
+			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
+			/* fallthrough */
+		case 2:
+			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
+			/* fallthrough */
+		case 1:
+			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
+		}
+
+		read_ptr++;
+		nbytes -= this_size;
+	}
+
+	return read_ptr;
+}
+
 static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint32_t count,
 		target_addr_t adr, bool addrinc)
 {
 	struct adiv5_dap *dap = ap->dap;
 	size_t nbytes = size * count;
-	target_addr_t address = adr;
 	int retval = ERROR_OK;
 
 	/* TI BE-32 Quirks mode:
@@ -624,6 +705,16 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	if (ap->unaligned_access_bad && (adr % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
+	if (dap->ops->mem_ap_read_buf && !dap->ti_be_32_quirks) {
+		retval = dap->ops->mem_ap_read_buf(ap, buffer, size, count, adr, addrinc);
+		if (retval != ERROR_NOT_IMPLEMENTED) {
+			/* The adapter left CSW and TAR in an unknown state */
+			ap->csw_value = 0;
+			ap->tar_valid = false;
+			return retval;
+		}
+	}
+
 	/* Allocate buffer to hold the sequence of DRW reads that will be made. This is a significant
 	 * over-allocation if packed transfers are going to be used, but determining the real need at
 	 * this point would be messy. */
@@ -636,40 +727,12 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 		return ERROR_FAIL;
 	}
 
-	/* Queue up all reads. Each read will store the entire DRW word in the read buffer. How many
-	 * useful bytes it contains, and their location in the word, depends on the type of transfer
-	 * and alignment. */
-	while (nbytes > 0) {
-		unsigned int this_size;
-		retval = mem_ap_setup_transfer_verify_size_packing_fallback(ap,
-					size, address,
-					addrinc, nbytes >= 4, &this_size);
-		if (retval != ERROR_OK)
-			break;
-
-
-		unsigned int drw_ops = DIV_ROUND_UP(this_size, 4);
-		while (drw_ops--) {
-			retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW(dap), read_ptr++);
-			if (retval != ERROR_OK)
-				break;
-		}
-
-		nbytes -= this_size;
-		if (addrinc)
-			address += this_size;
-
-		mem_ap_update_tar_cache(ap);
-	}
+	/* Queue up all reads */
+	retval = mem_ap_read_queue(ap, size, count, adr, addrinc, &read_ptr);
 
 	if (retval == ERROR_OK)
 		retval = dap_run(dap);
 
-	/* Restore state */
-	address = adr;
-	nbytes = size * count;
-	read_ptr = read_buf;
-
 	/* If something failed, read TAR to find out how much data was successfully read, so we can
 	 * at least give the caller what we have. */
 	if (retval == ERROR_TARGET_SIZE_NOT_SUPPORTED) {
@@ -679,41 +742,15 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 		if (mem_ap_read_tar(ap, &tar) == ERROR_OK) {
 			/* TAR is incremented after failed transfer on some devices (eg Cortex-M4) */
 			LOG_ERROR("Failed to read memory at " TARGET_ADDR_FMT, tar);
-			if (nbytes > tar - address)
-				nbytes = tar - address;
+			if (nbytes > tar - adr)
+				nbytes = tar - adr;
 		} else {
 			LOG_ERROR("Failed to read memory and, additionally, failed to find out where");
 			nbytes = 0;
 		}
 	}
 
-	target_addr_t ti_be_lane_xor = dap->ti_be_32_quirks ? 3 : 0;
-
-	/* Replay loop to populate caller's buffer from the correct word and byte lane */
-	while (nbytes > 0) {
-		/* Convert transfers longer than 32-bit on word-at-a-time basis */
-		unsigned int this_size = MIN(size, 4);
-
-		if (size < 4 && addrinc && ap->packed_transfers_supported && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;	/* Packed read of 4 bytes or 2 halfwords */
-		}
-
-		switch (this_size) {
-		case 4:
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
-			/* fallthrough */
-		case 2:
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
-			/* fallthrough */
-		case 1:
-			*buffer++ = *read_ptr >> 8 * ((address++ & 3) ^ ti_be_lane_xor);
-		}
-
-		read_ptr++;
-		nbytes -= this_size;
-	}
+	mem_ap_read_unpack(ap, buffer, size, nbytes, adr, addrinc, read_buf);
 
 	free(read_buf);
 	return retval;
@@ -743,6 +780,68 @@ int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 	return mem_ap_write(ap, buffer, size, count, address, false);
 }
 
+/* Read the items one by one, filling in all that can be read. Returns the first error. */
+static int mem_ap_read_each(struct adiv5_ap *ap,
+		const struct target_memory_gather *items, unsigned int num_items)
+{
+	int first_err = ERROR_OK;
+
+	for (unsigned int i = 0; i < num_items; i++) {
+		int retval = mem_ap_read(ap, items[i].buffer, items[i].size, items[i].count,
+				items[i].address, true);
+		if (first_err == ERROR_OK)
+			first_err = retval;
+	}
+
+	return first_err;
+}
+
+int mem_ap_read_buf_gather(struct adiv5_ap *ap,
+		const struct target_memory_gather *items, unsigned int num_items)
+{
+	struct adiv5_dap *dap = ap->dap;
+	size_t words = 0;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < num_items; i++) {
+		const struct target_memory_gather *item = &items[i];
+		if ((dap->ti_be_32_quirks && item->size > 4)
+				|| (ap->unaligned_access_bad && item->size && item->address % item->size))
+			return mem_ap_read_each(ap, items, num_items);
+		words += (size_t)item->count * MAX(sizeof(uint32_t), item->size) / sizeof(uint32_t);
+	}
+
+	uint32_t *read_buf = calloc(words ? words : 1, sizeof(uint32_t));
+	if (!read_buf) {
+		LOG_ERROR("Failed to allocate read buffer");
+		return ERROR_FAIL;
+	}
+
+	/* Queue every item and run the lot in one go */
+	uint32_t *read_ptr = read_buf;
+	for (unsigned int i = 0; i < num_items && retval == ERROR_OK; i++)
+		retval = mem_ap_read_queue(ap, items[i].size, items[i].count,
+				items[i].address, true, &read_ptr);
+
+	if (retval == ERROR_OK)
+		retval = dap_run(dap);
+
+	if (retval != ERROR_OK) {
+		/* Some item faulted. Redo them one by one, so that every item that can
+		 * be read is filled in and the bad address gets reported. */
+		free(read_buf);
+		return mem_ap_read_each(ap, items, num_items);
+	}
+
+	const uint32_t *p = read_buf;
+	for (unsigned int i = 0; i < num_items; i++)
+		p = mem_ap_read_unpack(ap, items[i].buffer, items[i].size,
+				(size_t)items[i].size * items[i].count, items[i].address, true, p);
+
+	free(read_buf);
+	return ERROR_OK;
+}
+
 /*--------------------------------------------------------------------------*/
 
 
@@ -1112,6 +1211,30 @@ int dap_find_get_ap(struct adiv5_dap *dap, enum ap_type type_to_find, struct adi
 		return ERROR_FAIL;
 	}
 
+	char key[32];
+	uint64_t cached_ap_num;
+
+	snprintf(key, sizeof(key), "ap.%d", type_to_find);
+
+	/* validate a cached result with a single IDR read */
+	if (dap_probe_cache_get(dap, key, &cached_ap_num) && cached_ap_num <= DP_APSEL_MAX) {
+		struct adiv5_ap *ap = dap_get_ap(dap, cached_ap_num);
+		if (ap) {
+			uint32_t id_val = 0;
+
+			int retval = dap_queue_ap_read(ap, AP_REG_IDR(dap), &id_val);
+			if (retval == ERROR_OK)
+				retval = dap_run(dap);
+			if (retval == ERROR_OK && (id_val & AP_TYPE_MASK) == type_to_find) {
+				LOG_DEBUG("Found %s at cached AP index: %" PRIu64,
+							ap_type_to_description(type_to_find), cached_ap_num);
+				*ap_out = ap;
+				return ERROR_OK;
+			}
+			dap_put_ap(ap);
+		}
+	}
+
 	/* Maximum AP number is 255 since the SELECT register is 8 bits */
 	for (unsigned int ap_num = 0; ap_num <= DP_APSEL_MAX; ap_num++) {
 		struct adiv5_ap *ap = dap_get_ap(dap, ap_num);
@@ -1137,6 +1260,7 @@ int dap_find_get_ap(struct adiv5_dap *dap, enum ap_type type_to_find, struct adi
 						ap_type_to_description(type_to_find),
 						ap_num, id_val);
 
+			dap_probe_cache_put(dap, key, ap_num);
 			*ap_out = ap;
 			return ERROR_OK;
 		}
@@ -1220,6 +1344,7 @@ int dap_put_ap(struct adiv5_ap *ap)
 		/* defaults from dap_instance_init() */
 		ap->ap_num = DP_APSEL_INVALID;
 		ap->memaccess_tck = 255;
+		ap->wait_idle_tck = 0;
 		ap->tar_autoincr_block = (1 << 10);
 		ap->csw_default = CSW_AHB_DEFAULT;
 		ap->cfg_reg = MEM_AP_REG_CFG_INVALID;
@@ -2298,6 +2423,27 @@ int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
 		.rom_table_entry = NULL,
 		.priv            = &lookup,
 	};
+	char key[48];
+	uint64_t cached_base;
+
+	snprintf(key, sizeof(key), "cs.%" PRIx64 ".%u.%" PRId32, ap->ap_num, type, core_id);
+
+	/*
+	 * Skip the ROM table walk if the cached component still identifies
+	 * as a CoreSight component of the requested type.
+	 */
+	if (dap_probe_cache_get(ap->dap, key, &cached_base) && IS_ALIGNED(cached_base, ARM_CS_ALIGN)) {
+		struct cs_component_vals v;
+
+		if (rtp_read_cs_regs(CS_ACCESS_MEM_AP, ap, cached_base, &v) == ERROR_OK
+				&& is_valid_arm_cs_cidr(v.cid)
+				&& ARM_CS_CIDR_CLASS(v.cid) == ARM_CS_CLASS_0X9_CS_COMPONENT
+				&& (v.devtype_memtype & ARM_CS_C9_DEVTYPE_MASK) == type) {
+			LOG_DEBUG("CS lookup found in cache at 0x%" PRIx64, cached_base);
+			*addr = cached_base;
+			return ERROR_OK;
+		}
+	}
 
 	int retval = rtp_ap(&dap_lookup_cs_component_ops, ap, 0);
 	if (retval == CORESIGHT_COMPONENT_FOUND) {
@@ -2307,6 +2453,7 @@ int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
 			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 		}
 		LOG_DEBUG("CS lookup found at 0x%" PRIx64, lookup.component_base);
+		dap_probe_cache_put(ap->dap, key, lookup.component_base);
 		*addr = lookup.component_base;
 		return ERROR_OK;
 	}
@@ -2635,15 +2782,21 @@ COMMAND_HANDLER(dap_memaccess_command)
 		}
 		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], memaccess_tck);
 		ap->memaccess_tck = memaccess_tck;
+		/* explicit setting overrides the delay learned from WAITs */
+		ap->wait_idle_tck = 0;
 		break;
 	default:
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 
+	uint32_t wait_idle_tck = ap->wait_idle_tck;
 	dap_put_ap(ap);
 
 	command_print(CMD, "memory bus access delay set to %" PRIu32 " tck",
 			memaccess_tck);
+	if (wait_idle_tck)
+		command_print(CMD, "SWD WAIT recovery added %" PRIu32 " idle cycles",
+				wait_idle_tck);
 
 	return ERROR_OK;
 }
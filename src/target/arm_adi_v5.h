@@ -305,6 +305,12 @@ struct adiv5_ap {
 	 */
 	uint32_t memaccess_tck;
 
+	/**
+	 * Extra idle cycles learned by the SWD transport after the MEM-AP
+	 * answered with WAIT. Added to memaccess_tck for SWD AP accesses.
+	 */
+	uint32_t wait_idle_tck;
+
 	/* Size of TAR autoincrement block, ARM ADI Specification requires at least 10 bits */
 	uint32_t tar_autoincr_block;
 
@@ -424,6 +430,9 @@ struct adiv5_dap {
 	/** TINSTANCE field of multidrop_targetsel has been configured */
 	bool multidrop_instance_id_valid;
 
+	/** DPIDR read while connecting over SWD, zero otherwise */
+	uint32_t dpidr;
+
 	/**
 	 * Record if enter in SWD required passing through DORMANT
 	 */
@@ -479,6 +488,15 @@ struct dap_ops {
 
 	/** Optional; called at OpenOCD exit */
 	void (*quit)(struct adiv5_dap *dap);
+
+	/** Optional; reads a whole MEM-AP buffer synchronously, bypassing the
+	 * per-word TAR/DRW queue. Returns ERROR_NOT_IMPLEMENTED if the generic
+	 * path has to handle this transfer. */
+	int (*mem_ap_read_buf)(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size,
+			uint32_t count, target_addr_t address, bool addrinc);
+	/** Optional; write counterpart of mem_ap_read_buf. */
+	int (*mem_ap_write_buf)(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size,
+			uint32_t count, target_addr_t address, bool addrinc);
 };
 
 /*
@@ -724,6 +742,12 @@ int mem_ap_read_buf_noincr(struct adiv5_ap *ap,
 int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 		const uint8_t *buffer, uint32_t size, uint32_t count, target_addr_t address);
 
+struct target_memory_gather;
+
+/* Synchronous MEM-AP reads of scattered blocks, queued as one DAP run. */
+int mem_ap_read_buf_gather(struct adiv5_ap *ap,
+		const struct target_memory_gather *items, unsigned int num_items);
+
 /* Initialisation of the debug system, power domains and registers */
 int dap_dp_init(struct adiv5_dap *dap);
 int dap_dp_init_or_reconnect(struct adiv5_dap *dap);
@@ -762,6 +786,10 @@ static inline bool dap_is_multidrop(struct adiv5_dap *dap)
 int dap_lookup_cs_component(struct adiv5_ap *ap,
 			uint8_t type, target_addr_t *addr, int32_t idx);
 
+/* Persistent cache of discovery results, see the "dap probe_cache" command */
+bool dap_probe_cache_get(struct adiv5_dap *dap, const char *key, uint64_t *value);
+void dap_probe_cache_put(struct adiv5_dap *dap, const char *key, uint64_t value);
+
 struct target;
 
 /* Put debug link into SWD mode */
@@ -30,6 +30,21 @@ struct arm_dap_object {
 	const struct swd_driver *swd;
 };
 
+/*
+ * Probe cache: results of AP and CoreSight component discovery, keyed by a
+ * fingerprint of the adapter and the identification registers of the DP.
+ * Entries are only trusted after the caller has validated them on target.
+ */
+struct dap_probe_cache_entry {
+	struct list_head lh;
+	char *fingerprint;
+	char *key;
+	uint64_t value;
+};
+
+static OOCD_LIST_HEAD(probe_cache);
+static char *probe_cache_filename;
+
 static void dap_instance_init(struct adiv5_dap *dap)
 {
 	int i;
@@ -39,6 +54,7 @@ static void dap_instance_init(struct adiv5_dap *dap)
 		dap->ap[i].ap_num = DP_APSEL_INVALID;
 		/* memaccess_tck max is 255 */
 		dap->ap[i].memaccess_tck = 255;
+		dap->ap[i].wait_idle_tck = 0;
 		/* Number of bits for tar autoincrement, impl. dep. at least 10 */
 		dap->ap[i].tar_autoincr_block = (1<<10);
 		/* default CSW value */
@@ -113,6 +129,9 @@ static int dap_init_all(void)
 			dap->ops = adapter_driver->dap_swd_ops;
 		} else if (transport_is_dapdirect_jtag()) {
 			dap->ops = adapter_driver->dap_jtag_ops;
+		} else if (adapter_driver->dap_jtag_ops) {
+			/* adapter native DAP accesses, falls back to jtag_dp_ops on connect */
+			dap->ops = adapter_driver->dap_jtag_ops;
 		} else
 			dap->ops = &jtag_dp_ops;
 
@@ -157,6 +176,154 @@ static int dap_init_all(void)
 	return ERROR_OK;
 }
 
+static void dap_probe_cache_fingerprint(struct adiv5_dap *dap, char *buf, size_t size)
+{
+	snprintf(buf, size, "%s/%08" PRIx32 "/%08" PRIx32 "/%08" PRIx32,
+			adapter_driver ? adapter_driver->name : "none",
+			dap->tap ? dap->tap->idcode : 0, dap->dpidr, dap->multidrop_targetsel);
+}
+
+static struct dap_probe_cache_entry *dap_probe_cache_find(const char *fingerprint,
+		const char *key)
+{
+	struct dap_probe_cache_entry *entry;
+
+	list_for_each_entry(entry, &probe_cache, lh) {
+		if (!strcmp(entry->fingerprint, fingerprint) && !strcmp(entry->key, key))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static int dap_probe_cache_add(const char *fingerprint, const char *key, uint64_t value)
+{
+	struct dap_probe_cache_entry *entry = dap_probe_cache_find(fingerprint, key);
+	if (entry) {
+		entry->value = value;
+		return ERROR_OK;
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	entry->fingerprint = strdup(fingerprint);
+	entry->key = strdup(key);
+	if (!entry->fingerprint || !entry->key) {
+		LOG_ERROR("Out of memory");
+		free(entry->fingerprint);
+		free(entry->key);
+		free(entry);
+		return ERROR_FAIL;
+	}
+
+	entry->value = value;
+	list_add_tail(&entry->lh, &probe_cache);
+
+	return ERROR_OK;
+}
+
+static void dap_probe_cache_clear(void)
+{
+	struct dap_probe_cache_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, &probe_cache, lh) {
+		list_del(&entry->lh);
+		free(entry->fingerprint);
+		free(entry->key);
+		free(entry);
+	}
+
+	free(probe_cache_filename);
+	probe_cache_filename = NULL;
+}
+
+static int dap_probe_cache_load(const char *filename)
+{
+	char line[256], fingerprint[128], key[64];
+	uint64_t value;
+
+	FILE *f = fopen(filename, "r");
+	if (!f) {
+		/* first run, the file is created on the first cache miss */
+		LOG_DEBUG("probe cache %s not found", filename);
+		return ERROR_OK;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%127s %63s %" SCNx64, fingerprint, key, &value) != 3)
+			continue;
+
+		if (dap_probe_cache_add(fingerprint, key, value) != ERROR_OK) {
+			fclose(f);
+			return ERROR_FAIL;
+		}
+	}
+
+	fclose(f);
+
+	return ERROR_OK;
+}
+
+static int dap_probe_cache_save(void)
+{
+	struct dap_probe_cache_entry *entry;
+
+	FILE *f = fopen(probe_cache_filename, "w");
+	if (!f) {
+		LOG_WARNING("cannot write probe cache %s", probe_cache_filename);
+		return ERROR_FAIL;
+	}
+
+	list_for_each_entry(entry, &probe_cache, lh)
+		fprintf(f, "%s %s 0x%" PRIx64 "\n", entry->fingerprint, entry->key, entry->value);
+
+	if (fclose(f) != 0) {
+		LOG_WARNING("cannot write probe cache %s", probe_cache_filename);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+bool dap_probe_cache_get(struct adiv5_dap *dap, const char *key, uint64_t *value)
+{
+	char fingerprint[128];
+
+	if (!probe_cache_filename)
+		return false;
+
+	dap_probe_cache_fingerprint(dap, fingerprint, sizeof(fingerprint));
+
+	struct dap_probe_cache_entry *entry = dap_probe_cache_find(fingerprint, key);
+	if (!entry)
+		return false;
+
+	*value = entry->value;
+
+	return true;
+}
+
+void dap_probe_cache_put(struct adiv5_dap *dap, const char *key, uint64_t value)
+{
+	char fingerprint[128];
+
+	if (!probe_cache_filename)
+		return;
+
+	dap_probe_cache_fingerprint(dap, fingerprint, sizeof(fingerprint));
+
+	struct dap_probe_cache_entry *entry = dap_probe_cache_find(fingerprint, key);
+	if (entry && entry->value == value)
+		return;
+
+	if (dap_probe_cache_add(fingerprint, key, value) == ERROR_OK)
+		dap_probe_cache_save();
+}
+
 int dap_cleanup_all(void)
 {
 	struct arm_dap_object *obj, *tmp;
@@ -175,6 +342,8 @@ int dap_cleanup_all(void)
 		free(obj);
 	}
 
+	dap_probe_cache_clear();
+
 	return ERROR_OK;
 }
 
@@ -492,6 +661,30 @@ COMMAND_HANDLER(handle_dap_info_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_dap_probe_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "%s", probe_cache_filename ? probe_cache_filename : "disabled");
+		return ERROR_OK;
+	}
+
+	dap_probe_cache_clear();
+
+	if (!strcmp(CMD_ARGV[0], "disable"))
+		return ERROR_OK;
+
+	probe_cache_filename = strdup(CMD_ARGV[0]);
+	if (!probe_cache_filename) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	return dap_probe_cache_load(probe_cache_filename);
+}
+
 static const struct command_registration dap_subcommand_handlers[] = {
 	{
 		.name = "create",
@@ -522,6 +715,13 @@ static const struct command_registration dap_subcommand_handlers[] = {
 			"or the ADIv6 root ROM table of current target's DAP",
 		.usage = "[ap_num | 'root']",
 	},
+	{
+		.name = "probe_cache",
+		.handler = handle_dap_probe_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "cache AP and CoreSight component discovery results in a file",
+		.usage = "[filename | 'disable']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -33,6 +33,7 @@
 #include <helper/types.h>
 #include <jtag/interface.h>
 #include <server/server.h>
+#include <server/trace_ring.h>
 #include <target/arm_adi_v5.h>
 #include <target/target.h>
 #include <transport/transport.h>
@@ -99,7 +100,9 @@ struct arm_tpiu_swo_object {
 	/** Handle to output trace data in INTERNAL capture mode */
 	/** Synchronous output port width */
 	uint32_t port_width;
-	FILE *file;
+	/** Captured trace data, fanned out to the file and the TCP clients */
+	struct trace_ring *ring;
+	struct trace_ring_sub *file_sub;
 	/** output mode */
 	unsigned int pin_protocol;
 	/** Enable formatter */
@@ -110,18 +113,11 @@ struct arm_tpiu_swo_object {
 	unsigned int swo_pin_freq;
 	/** where to dump the captured output trace data */
 	char *out_filename;
-	/** track TCP connections */
-	struct list_head connections;
 	/* START_DEPRECATED_TPIU */
 	bool recheck_ap_cur_target;
 	/* END_DEPRECATED_TPIU */
 };
 
-struct arm_tpiu_swo_connection {
-	struct list_head lh;
-	struct connection *connection;
-};
-
 struct arm_tpiu_swo_priv_connection {
 	struct arm_tpiu_swo_object *obj;
 };
@@ -129,13 +125,13 @@ struct arm_tpiu_swo_priv_connection {
 static OOCD_LIST_HEAD(all_tpiu_swo);
 
 #define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
+#define ARM_TPIU_SWO_TRACE_RING_SIZE	(64 * 1024)
 
 static int arm_tpiu_swo_poll_trace(void *priv)
 {
 	struct arm_tpiu_swo_object *obj = priv;
 	uint8_t buf[ARM_TPIU_SWO_TRACE_BUF_SIZE];
 	size_t size = sizeof(buf);
-	struct arm_tpiu_swo_connection *c;
 
 	int retval = adapter_poll_trace(buf, &size);
 	if (retval != ERROR_OK || !size)
@@ -143,21 +139,7 @@ static int arm_tpiu_swo_poll_trace(void *priv)
 
 	target_call_trace_callbacks(/*target*/NULL, size, buf);
 
-	if (obj->file) {
-		if (fwrite(buf, 1, size, obj->file) == size) {
-			fflush(obj->file);
-		} else {
-			LOG_ERROR("Error writing to the SWO trace destination file");
-			return ERROR_FAIL;
-		}
-	}
-
-	if (obj->out_filename[0] == ':')
-		list_for_each_entry(c, &obj->connections, lh)
-			if (connection_write(c->connection, buf, size) != (int)size)
-				LOG_ERROR("Error writing to connection"); /* FIXME: which connection? */
-
-	return ERROR_OK;
+	return trace_ring_write(obj->ring, buf, size);
 }
 
 static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_tpiu_swo_event event)
@@ -198,9 +180,9 @@ static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_t
 
 static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 {
-	if (obj->file) {
-		fclose(obj->file);
-		obj->file = NULL;
+	if (obj->file_sub) {
+		trace_ring_unsubscribe(obj->file_sub);
+		obj->file_sub = NULL;
 	}
 	if (obj->out_filename[0] == ':')
 		remove_service(TCP_SERVICE_NAME, &obj->out_filename[1]);
@@ -238,6 +220,7 @@ int arm_tpiu_swo_cleanup_all(void)
 		if (obj->ap)
 			dap_put_ap(obj->ap);
 
+		trace_ring_free(obj->ring);
 		free(obj->name);
 		free(obj->out_filename);
 		free(obj);
@@ -250,14 +233,9 @@ static int arm_tpiu_swo_service_new_connection(struct connection *connection)
 {
 	struct arm_tpiu_swo_priv_connection *priv = connection->service->priv;
 	struct arm_tpiu_swo_object *obj = priv->obj;
-	struct arm_tpiu_swo_connection *c = malloc(sizeof(*c));
-	if (!c) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
-	c->connection = connection;
-	list_add(&c->lh, &obj->connections);
-	return ERROR_OK;
+
+	connection->priv = trace_ring_subscribe_connection(obj->ring, connection, false);
+	return connection->priv ? ERROR_OK : ERROR_FAIL;
 }
 
 static int arm_tpiu_swo_service_input(struct connection *connection)
@@ -278,18 +256,9 @@ static int arm_tpiu_swo_service_input(struct connection *connection)
 
 static int arm_tpiu_swo_service_connection_closed(struct connection *connection)
 {
-	struct arm_tpiu_swo_priv_connection *priv = connection->service->priv;
-	struct arm_tpiu_swo_object *obj = priv->obj;
-	struct arm_tpiu_swo_connection *c, *tmp;
-
-	list_for_each_entry_safe(c, tmp, &obj->connections, lh)
-		if (c->connection == connection) {
-			list_del(&c->lh);
-			free(c);
-			return ERROR_OK;
-		}
-	LOG_ERROR("Failed to find connection to close!");
-	return ERROR_FAIL;
+	trace_ring_unsubscribe(connection->priv);
+	connection->priv = NULL;
+	return ERROR_OK;
 }
 
 COMMAND_HANDLER(handle_arm_tpiu_swo_event_list)
@@ -734,8 +703,8 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 				return retval;
 			}
 		} else if (strcmp(obj->out_filename, "-")) {
-			obj->file = fopen(obj->out_filename, "ab");
-			if (!obj->file) {
+			obj->file_sub = trace_ring_subscribe_file(obj->ring, obj->out_filename);
+			if (!obj->file_sub) {
 				command_print(CMD, "Can't open trace destination file \"%s\"", obj->out_filename);
 				return ERROR_FAIL;
 			}
@@ -958,7 +927,6 @@ static int jim_arm_tpiu_swo_create(Jim_Interp *interp, int argc, Jim_Obj *const
 		LOG_ERROR("Out of memory");
 		return JIM_ERR;
 	}
-	INIT_LIST_HEAD(&obj->connections);
 	adiv5_mem_ap_spot_init(&obj->spot);
 	obj->spot.base = TPIU_SWO_DEFAULT_BASE;
 	obj->port_width = 1;
@@ -987,6 +955,10 @@ static int jim_arm_tpiu_swo_create(Jim_Interp *interp, int argc, Jim_Obj *const
 		goto err_exit;
 	}
 
+	obj->ring = trace_ring_get(obj->name, ARM_TPIU_SWO_TRACE_RING_SIZE);
+	if (!obj->ring)
+		goto err_exit;
+
 	e = arm_tpiu_swo_create(goi.interp, obj);
 	if (e != JIM_OK)
 		goto err_exit;
@@ -994,6 +966,7 @@ static int jim_arm_tpiu_swo_create(Jim_Interp *interp, int argc, Jim_Obj *const
 	return JIM_OK;
 
 err_exit:
+	trace_ring_free(obj->ring);
 	free(obj->name);
 	free(obj->out_filename);
 	free(obj);
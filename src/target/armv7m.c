@@ -1096,6 +1096,136 @@ cleanup1:
 	return retval;
 }
 
+/** Computes the CRC and erase state of an array of memory regions in one run. */
+int armv7m_survey_memory(struct target *target,
+	struct target_memory_survey_block *blocks, int num_blocks, uint8_t erased_value)
+{
+	struct working_area *survey_algorithm;
+	struct working_area *survey_params;
+	struct reg_param reg_params[2];
+	struct armv7m_algorithm armv7m_info;
+	int retval;
+
+	static const uint8_t survey_code[] = {
+#include "../../contrib/loaders/checksum/armv7m_survey.inc"
+	};
+
+	const uint32_t code_size = sizeof(survey_code);
+
+	if (target_alloc_working_area(target, code_size, &survey_algorithm) != ERROR_OK)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	retval = target_write_buffer(target, survey_algorithm->address, code_size, survey_code);
+	if (retval != ERROR_OK)
+		goto cleanup1;
+
+	/* prepare blocks array for algo */
+	struct algo_block {
+		uint32_t address;
+		uint32_t size;
+		uint32_t crc;
+		uint32_t blank_offset;
+	};
+
+	uint32_t avail = target_get_working_area_avail(target);
+	int blocks_to_survey = avail / sizeof(struct algo_block) - 1;
+	if (num_blocks < blocks_to_survey)
+		blocks_to_survey = num_blocks;
+
+	/* a zero size terminates the array in the algorithm */
+	for (int i = 0; i < blocks_to_survey; i++) {
+		if (blocks[i].size == 0) {
+			blocks_to_survey = i;
+			break;
+		}
+	}
+
+	if (num_blocks > 0 && blocks[0].size == 0) {
+		blocks[0].crc = 0xffffffff;
+		blocks[0].blank_offset = 0;
+		retval = 1;
+		goto cleanup1;
+	}
+
+	if (blocks_to_survey < 1) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup1;
+	}
+
+	struct algo_block *params = calloc(blocks_to_survey + 1, sizeof(struct algo_block));
+	if (!params) {
+		retval = ERROR_FAIL;
+		goto cleanup1;
+	}
+
+	uint32_t total_size = 0;
+	for (int i = 0; i < blocks_to_survey; i++) {
+		total_size += blocks[i].size;
+		target_buffer_set_u32(target, (uint8_t *)&params[i].address, blocks[i].address);
+		target_buffer_set_u32(target, (uint8_t *)&params[i].size, blocks[i].size);
+	}
+
+	uint32_t param_size = (blocks_to_survey + 1) * sizeof(struct algo_block);
+	if (target_alloc_working_area(target, param_size, &survey_params) != ERROR_OK) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup2;
+	}
+
+	retval = target_write_buffer(target, survey_params->address, param_size, (uint8_t *)params);
+	if (retval != ERROR_OK)
+		goto cleanup3;
+
+	LOG_TARGET_DEBUG(target, "Starting survey of %d blocks, parameters@"
+		 TARGET_ADDR_FMT, blocks_to_survey, survey_params->address);
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	buf_set_u32(reg_params[0].value, 0, 32, survey_params->address);
+
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	buf_set_u32(reg_params[1].value, 0, 32, erased_value);
+
+	/* same budget as armv7m_checksum_memory(), which dominates the run time */
+	unsigned int timeout = 20000 * (1 + (total_size / (1024 * 1024)));
+
+	/* the exit point is the bkpt in front of the aligned CRC polynomial */
+	retval = target_run_algorithm(target, 0, NULL,
+			ARRAY_SIZE(reg_params), reg_params,
+			survey_algorithm->address,
+			survey_algorithm->address + (code_size - 8),
+			timeout, &armv7m_info);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "error executing cortex_m survey algorithm");
+		goto cleanup4;
+	}
+
+	retval = target_read_buffer(target, survey_params->address, param_size, (uint8_t *)params);
+	if (retval != ERROR_OK)
+		goto cleanup4;
+
+	for (int i = 0; i < blocks_to_survey; i++) {
+		blocks[i].crc = target_buffer_get_u32(target, (uint8_t *)&params[i].crc);
+		blocks[i].blank_offset = target_buffer_get_u32(target, (uint8_t *)&params[i].blank_offset);
+	}
+
+	retval = blocks_to_survey;	/* return number of blocks really surveyed */
+
+cleanup4:
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+
+cleanup3:
+	target_free_working_area(target, survey_params);
+cleanup2:
+	free(params);
+cleanup1:
+	target_free_working_area(target, survey_algorithm);
+
+	return retval;
+}
+
 int armv7m_maybe_skip_bkpt_inst(struct target *target, bool *inst_found)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
@@ -1262,6 +1262,15 @@ COMMAND_HANDLER(armv8_pauth_command)
 				    "pauth feature");
 }
 
+COMMAND_HANDLER(armv8_dpm_queue_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv8_common *armv8 = target_to_armv8(target);
+	return CALL_COMMAND_HANDLER(handle_command_parse_bool,
+				    &armv8->dpm_queue,
+				    "queued DPM operations");
+}
+
 int armv8_handle_cache_info_command(struct command_invocation *cmd,
 	struct armv8_cache_common *armv8_cache)
 {
@@ -1290,6 +1299,7 @@ int armv8_init_arch_info(struct target *target, struct armv8_common *armv8)
 	armv8->arm.target = target;
 	armv8->arm.common_magic = ARM_COMMON_MAGIC;
 	armv8->common_magic = ARMV8_COMMON_MAGIC;
+	armv8->dpm_queue = true;
 
 	armv8->armv8_mmu.armv8_cache.l2_cache = NULL;
 	armv8->armv8_mmu.armv8_cache.info = -1;
@@ -1940,6 +1950,14 @@ const struct command_registration armv8_command_handlers[] = {
 			"pauth feature.",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "dpm_queue",
+		.handler = armv8_dpm_queue_command,
+		.mode = COMMAND_ANY,
+		.help = "enable or disable queueing the instructions and DTR "
+			"accesses of debug operations and checking DSCR once per queue",
+		.usage = "[on|off]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -213,6 +213,9 @@ struct armv8_common {
 	/* True if OpenOCD provides pointer auth related info to GDB */
 	bool enable_pauth;
 
+	/* True if DPM operations are queued and checked once, see armv8_dpm.c */
+	bool dpm_queue;
+
 	bool sticky_reset;
 
 	/* last run-control command issued to this target (resume, halt, step) */
@@ -259,8 +259,203 @@ static int dpmv8_exec_opcode(struct arm_dpm *dpm,
 	return retval;
 }
 
+/*
+ * Queued DPM operations.
+ *
+ * dpmv8_exec_opcode() polls DSCR before and after every instruction, which
+ * costs at least two transport round trips each. In queued mode the DTR
+ * writes, ITR writes and DTR reads of an operation go into a single MEM-AP
+ * queue, followed by one DSCR read. The MEM-AP access time (plus
+ * memaccess_tck on JTAG) is normally enough for each instruction to complete
+ * before the next access. If it is not, the PE flags an overrun (ITO, RXO or
+ * TXU) and sets the sticky DSCR.ERR, so the trailing DSCR read is sufficient
+ * to validate the whole queue. After an overrun the DTR is drained and the
+ * operation is replayed step by step.
+ */
+#define DSCR_OVERRUN (DSCR_ITO | DSCR_RTO | DSCR_TXU)
+
+static bool dpmv8_queue_usable(struct arm_dpm *dpm)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+
+	return armv8->dpm_queue && (dpm->dscr & (DSCR_ITE | DSCR_ERR)) == DSCR_ITE;
+}
+
+static int dpmv8_wait_ite(struct armv8_common *armv8, uint32_t *dscr)
+{
+	int retval;
+
+	long long then = timeval_ms();
+	while ((*dscr & DSCR_ITE) == 0) {
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, dscr);
+		if (retval != ERROR_OK)
+			return retval;
+		if (timeval_ms() > then + 1000) {
+			LOG_ERROR("Timeout waiting for ITE, dscr = 0x%08" PRIx32, *dscr);
+			return ERROR_FAIL;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static int dpmv8_queue_dtr_write(struct armv8_common *armv8, uint64_t data,
+	unsigned int words)
+{
+	int retval;
+
+	retval = mem_ap_write_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DTRRX, data);
+	if (retval == ERROR_OK && words > 1)
+		retval = mem_ap_write_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRTX, data >> 32);
+	return retval;
+}
+
+static int dpmv8_queue_dtr_read(struct armv8_common *armv8, uint32_t *lower,
+	uint32_t *higher)
+{
+	int retval;
+
+	retval = mem_ap_read_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DTRTX, lower);
+	if (retval == ERROR_OK && higher)
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRRX, higher);
+	return retval;
+}
+
+static int dpmv8_queue_itr(struct arm_dpm *dpm, uint32_t opcode)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		opcode = T32_FMTITR(opcode);
+
+	return mem_ap_write_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_ITR, opcode);
+}
+
+/*
+ * Clear the sticky error and empty the DTR after a failed queue, so that the
+ * operation can be replayed. R0 is the scratch register and may be clobbered.
+ */
+static int dpmv8_queue_recover(struct arm_dpm *dpm, uint32_t dscr)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	uint32_t dummy;
+	int retval;
+
+	retval = mem_ap_write_atomic_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DRCR, DRCR_CSE);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, &dscr);
+	if (retval == ERROR_OK && (dscr & DSCR_DTR_TX_FULL))
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRTX, &dummy);
+	if (retval != ERROR_OK)
+		return retval;
+
+	dpm->dscr = dscr & ~DSCR_DTR_TX_FULL;
+	if (dscr & DSCR_DTR_RX_FULL)
+		retval = dpmv8_exec_opcode(dpm, armv8_opcode(armv8, READ_REG_DTRRX), NULL);
+
+	return retval;
+}
+
+/*
+ * Run the queue built by the dpmv8_queue_*() helpers with a trailing DSCR
+ * read. Sets @replay if an overrun spoiled the queue and the operation must
+ * be done again step by step.
+ */
+static int dpmv8_queue_run(struct arm_dpm *dpm, bool *replay)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	unsigned int el = dpm->last_el;
+	uint32_t dscr;
+	int retval;
+
+	*replay = false;
+
+	retval = mem_ap_read_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DSCR, &dscr);
+	if (retval == ERROR_OK)
+		retval = dap_run(armv8->debug_ap->dap);
+	if (retval == ERROR_OK)
+		retval = dpmv8_wait_ite(armv8, &dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* update dscr and el after each command execution */
+	dpm->dscr = dscr;
+	if (dpm->last_el != ((dscr >> 8) & 3))
+		LOG_DEBUG("EL %i -> %" PRIu32, dpm->last_el, (dscr >> 8) & 3);
+	dpm->last_el = (dscr >> 8) & 3;
+
+	if (!(dscr & DSCR_ERR))
+		return ERROR_OK;
+
+	retval = dpmv8_queue_recover(dpm, dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* an instruction took an exception, replaying would not help */
+	if (!(dscr & DSCR_OVERRUN) || dpm->last_el != el) {
+		LOG_ERROR("Queued DPM operation, DSCR.ERR=1, DSCR.EL=%i", dpm->last_el);
+		armv8_dpm_handle_exception(dpm, true);
+		return ERROR_FAIL;
+	}
+
+	LOG_DEBUG("DPM queue overrun, dscr = 0x%08" PRIx32 ", replaying", dscr);
+	*replay = true;
+	return ERROR_OK;
+}
+
+/*
+ * Do one DPM operation in queued mode: write @n_wdata words of @wdata to the
+ * DTR, execute @n_opcodes instructions and read @n_rdata words of the DTR
+ * into @rdata. Returns false if the caller has to do the operation step by
+ * step, otherwise true with the result in @retval.
+ */
+static bool dpmv8_queue_op(struct arm_dpm *dpm, uint64_t wdata, unsigned int n_wdata,
+	const uint32_t *opcodes, unsigned int n_opcodes,
+	uint64_t *rdata, unsigned int n_rdata, int *retval)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	uint32_t lower = 0, higher = 0;
+	bool replay;
+
+	if (!dpmv8_queue_usable(dpm))
+		return false;
+
+	*retval = ERROR_OK;
+	if (n_wdata)
+		*retval = dpmv8_queue_dtr_write(armv8, wdata, n_wdata);
+	for (unsigned int i = 0; i < n_opcodes && *retval == ERROR_OK; i++)
+		*retval = dpmv8_queue_itr(dpm, opcodes[i]);
+	if (*retval == ERROR_OK && n_rdata)
+		*retval = dpmv8_queue_dtr_read(armv8, &lower, n_rdata > 1 ? &higher : NULL);
+	if (*retval == ERROR_OK)
+		*retval = dpmv8_queue_run(dpm, &replay);
+	if (*retval != ERROR_OK)
+		return true;
+	if (replay)
+		return false;
+
+	if (n_rdata)
+		*rdata = (uint64_t)higher << 32 | lower;
+	return true;
+}
+
 static int dpmv8_instr_execute(struct arm_dpm *dpm, uint32_t opcode)
 {
+	int retval;
+
+	if (dpmv8_queue_op(dpm, 0, 0, &opcode, 1, NULL, 0, &retval))
+		return retval;
+
 	return dpmv8_exec_opcode(dpm, opcode, NULL);
 }
 
@@ -270,6 +465,9 @@ static int dpmv8_instr_write_data_dcc(struct arm_dpm *dpm,
 	struct armv8_common *armv8 = dpm->arm->arch_info;
 	int retval;
 
+	if (dpmv8_queue_op(dpm, data, 1, &opcode, 1, NULL, 0, &retval))
+		return retval;
+
 	retval = dpmv8_write_dcc(armv8, data);
 	if (retval != ERROR_OK)
 		return retval;
@@ -283,6 +481,9 @@ static int dpmv8_instr_write_data_dcc_64(struct arm_dpm *dpm,
 	struct armv8_common *armv8 = dpm->arm->arch_info;
 	int retval;
 
+	if (dpmv8_queue_op(dpm, data, 2, &opcode, 1, NULL, 0, &retval))
+		return retval;
+
 	retval = dpmv8_write_dcc_64(armv8, data);
 	if (retval != ERROR_OK)
 		return retval;
@@ -297,6 +498,10 @@ static int dpmv8_instr_write_data_r0(struct arm_dpm *dpm,
 	uint32_t dscr = DSCR_ITE;
 	int retval;
 
+	const uint32_t opcodes[] = { armv8_opcode(armv8, READ_REG_DTRRX), opcode };
+	if (dpmv8_queue_op(dpm, data, 1, opcodes, 2, NULL, 0, &retval))
+		return retval;
+
 	retval = dpmv8_write_dcc(armv8, data);
 	if (retval != ERROR_OK)
 		return retval;
@@ -318,6 +523,10 @@ static int dpmv8_instr_write_data_r0_64(struct arm_dpm *dpm,
 	if (dpm->arm->core_state != ARM_STATE_AARCH64)
 		return dpmv8_instr_write_data_r0(dpm, opcode, data);
 
+	const uint32_t opcodes[] = { ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, 0), opcode };
+	if (dpmv8_queue_op(dpm, data, 2, opcodes, 2, NULL, 0, &retval))
+		return retval;
+
 	/* transfer data from DCC to R0 */
 	retval = dpmv8_write_dcc_64(armv8, data);
 	if (retval == ERROR_OK)
@@ -335,6 +544,13 @@ static int dpmv8_instr_cpsr_sync(struct arm_dpm *dpm)
 	int retval;
 	struct armv8_common *armv8 = dpm->arm->arch_info;
 
+	const uint32_t opcodes[] = {
+		armv8_opcode(armv8, ARMV8_OPC_DSB_SY),
+		armv8_opcode(armv8, ARMV8_OPC_ISB_SY),
+	};
+	if (dpmv8_queue_op(dpm, 0, 0, opcodes, 2, NULL, 0, &retval))
+		return retval;
+
 	/* "Prefetch flush" after modifying execution status in CPSR */
 	retval = dpmv8_exec_opcode(dpm, armv8_opcode(armv8, ARMV8_OPC_DSB_SY), &dpm->dscr);
 	if (retval == ERROR_OK)
@@ -346,8 +562,15 @@ static int dpmv8_instr_read_data_dcc(struct arm_dpm *dpm,
 	uint32_t opcode, uint32_t *data)
 {
 	struct armv8_common *armv8 = dpm->arm->arch_info;
+	uint64_t value;
 	int retval;
 
+	if (dpmv8_queue_op(dpm, 0, 0, &opcode, 1, &value, 1, &retval)) {
+		if (retval == ERROR_OK)
+			*data = value;
+		return retval;
+	}
+
 	/* the opcode, writing data to DCC */
 	retval = dpmv8_exec_opcode(dpm, opcode, &dpm->dscr);
 	if (retval != ERROR_OK)
@@ -362,6 +585,9 @@ static int dpmv8_instr_read_data_dcc_64(struct arm_dpm *dpm,
 	struct armv8_common *armv8 = dpm->arm->arch_info;
 	int retval;
 
+	if (dpmv8_queue_op(dpm, 0, 0, &opcode, 1, data, 2, &retval))
+		return retval;
+
 	/* the opcode, writing data to DCC */
 	retval = dpmv8_exec_opcode(dpm, opcode, &dpm->dscr);
 	if (retval != ERROR_OK)
@@ -374,8 +600,16 @@ static int dpmv8_instr_read_data_r0(struct arm_dpm *dpm,
 	uint32_t opcode, uint32_t *data)
 {
 	struct armv8_common *armv8 = dpm->arm->arch_info;
+	uint64_t value;
 	int retval;
 
+	const uint32_t opcodes[] = { opcode, armv8_opcode(armv8, WRITE_REG_DTRTX) };
+	if (dpmv8_queue_op(dpm, 0, 0, opcodes, 2, &value, 1, &retval)) {
+		if (retval == ERROR_OK)
+			*data = value;
+		return retval;
+	}
+
 	/* the opcode, writing data to R0 */
 	retval = dpmv8_exec_opcode(dpm, opcode, &dpm->dscr);
 	if (retval != ERROR_OK)
@@ -403,6 +637,10 @@ static int dpmv8_instr_read_data_r0_64(struct arm_dpm *dpm,
 		return retval;
 	}
 
+	const uint32_t opcodes[] = { opcode, ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, 0) };
+	if (dpmv8_queue_op(dpm, 0, 0, opcodes, 2, data, 2, &retval))
+		return retval;
+
 	/* the opcode, writing data to R0 */
 	retval = dpmv8_exec_opcode(dpm, opcode, &dpm->dscr);
 	if (retval != ERROR_OK)
@@ -723,6 +961,92 @@ static int dpmv8_write_reg(struct arm_dpm *dpm, struct reg *r, unsigned int regn
 	return retval;
 }
 
+/*
+ * In AArch64 state X0..X30 are each moved through the DTR by a single
+ * MSR/MRS DBGDTR_EL0, without a scratch register. Transfer all the ones
+ * that need it in one queue; after an overrun the registers are left
+ * untouched and the caller falls back to moving them one by one.
+ */
+static int dpmv8_read_gp_regs_queued(struct arm_dpm *dpm)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	struct reg_cache *cache = dpm->arm->core_cache;
+	uint32_t lower[ARMV8_R30 + 1], higher[ARMV8_R30 + 1];
+	unsigned int count = 0;
+	bool replay = false;
+	int retval = ERROR_OK;
+
+	if (!dpmv8_queue_usable(dpm) || armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		return ERROR_OK;
+
+	for (unsigned int i = ARMV8_R0; i <= ARMV8_R30 && retval == ERROR_OK; i++) {
+		if (cache->reg_list[i].valid)
+			continue;
+		retval = dpmv8_queue_itr(dpm, ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, i));
+		if (retval == ERROR_OK)
+			retval = dpmv8_queue_dtr_read(armv8, &lower[i], &higher[i]);
+		count++;
+	}
+	if (retval == ERROR_OK && count)
+		retval = dpmv8_queue_run(dpm, &replay);
+	if (retval != ERROR_OK || replay)
+		return retval;
+
+	for (unsigned int i = ARMV8_R0; i <= ARMV8_R30; i++) {
+		struct reg *r = cache->reg_list + i;
+		uint64_t value_64 = (uint64_t)higher[i] << 32 | lower[i];
+
+		if (r->valid)
+			continue;
+		buf_set_u64(r->value, 0, 64, value_64);
+		r->valid = true;
+		r->dirty = false;
+		LOG_DEBUG("READ: %s, %16.8llx", r->name, (unsigned long long)value_64);
+	}
+
+	return ERROR_OK;
+}
+
+static int dpmv8_write_gp_regs_queued(struct arm_dpm *dpm)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	struct reg_cache *cache = dpm->arm->core_cache;
+	unsigned int count = 0;
+	bool replay = false;
+	int retval = ERROR_OK;
+
+	if (!dpmv8_queue_usable(dpm) || armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		return ERROR_OK;
+
+	/* R0 is the scratch register, it's written last */
+	for (unsigned int i = ARMV8_R1; i <= ARMV8_R30 && retval == ERROR_OK; i++) {
+		struct reg *r = cache->reg_list + i;
+
+		if (!r->valid || !r->dirty)
+			continue;
+		retval = dpmv8_queue_dtr_write(armv8, buf_get_u64(r->value, 0, 64), 2);
+		if (retval == ERROR_OK)
+			retval = dpmv8_queue_itr(dpm, ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, i));
+		count++;
+	}
+	if (retval == ERROR_OK && count)
+		retval = dpmv8_queue_run(dpm, &replay);
+	if (retval != ERROR_OK || replay)
+		return retval;
+
+	for (unsigned int i = ARMV8_R1; i <= ARMV8_R30; i++) {
+		struct reg *r = cache->reg_list + i;
+
+		if (!r->valid || !r->dirty)
+			continue;
+		r->dirty = false;
+		LOG_DEBUG("WRITE: %s, %16.8llx", r->name,
+			(unsigned long long)buf_get_u64(r->value, 0, 64));
+	}
+
+	return ERROR_OK;
+}
+
 /**
  * Read basic registers of the current context:  R0 to R15, and CPSR in AArch32
  * state or R0 to R31, PC and CPSR in AArch64 state;
@@ -746,6 +1070,10 @@ int armv8_dpm_read_current_registers(struct arm_dpm *dpm)
 
 	cache = arm->core_cache;
 
+	retval = dpmv8_read_gp_regs_queued(dpm);
+	if (retval != ERROR_OK)
+		goto fail;
+
 	/* read R0 first (it's used for scratch), then CPSR */
 	r = cache->reg_list + ARMV8_R0;
 	if (!r->valid) {
@@ -918,6 +1246,10 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	if (retval != ERROR_OK)
 		goto done;
 
+	retval = dpmv8_write_gp_regs_queued(dpm);
+	if (retval != ERROR_OK)
+		goto done;
+
 	/* check everything except our scratch register R0 */
 	for (unsigned int i = 1; i < cache->num_regs; i++) {
 		struct arm_reg *r;
@@ -445,18 +445,123 @@ static int cortex_m_store_core_reg_u32(struct target *target,
 	return retval;
 }
 
+static bool cortex_m_dwt_has_mask(struct cortex_m_common *cortex_m)
+{
+	return (cortex_m->dwt_devarch & 0x1FFFFF) != DWT_DEVARCH_ARMV8M_V2_0
+		&& (cortex_m->dwt_devarch & 0x1FFFFF) != DWT_DEVARCH_ARMV8M_V2_1;
+}
+
+static int cortex_m_queue_comparator_write(struct target *target,
+	uint32_t address, uint32_t value, uint32_t *shadow, unsigned int *count)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = &cortex_m->armv7m;
+	int retval;
+
+	if (cortex_m->comparator_shadow_valid && *shadow == value)
+		return ERROR_OK;
+
+	if (armv7m->is_hla_target)
+		retval = target_write_u32(target, address, value);
+	else
+		retval = mem_ap_write_u32(armv7m->debug_ap, address, value);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*shadow = value;
+	(*count)++;
+	return ERROR_OK;
+}
+
+/* Queue writes for the FPB and DWT comparators which differ from the
+ * value last written to the hardware. Nothing is written for comparators
+ * which have not changed since the previous resume. */
+static int cortex_m_queue_comparators(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct cortex_m_fp_comparator *fp_list = cortex_m->fp_comparator_list;
+	struct cortex_m_dwt_comparator *dwt_list = cortex_m->dwt_comparator_list;
+	unsigned int count = 0;
+	int retval;
+
+	for (unsigned int i = 0; i < cortex_m->fp_num_code + cortex_m->fp_num_lit; i++) {
+		retval = cortex_m_queue_comparator_write(target, fp_list[i].fpcr_address,
+				fp_list[i].fpcr_value, &fp_list[i].fpcr_shadow, &count);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (unsigned int i = 0; i < cortex_m->dwt_num_comp; i++) {
+		retval = cortex_m_queue_comparator_write(target, dwt_list[i].dwt_comparator_address + 0,
+				dwt_list[i].comp, &dwt_list[i].comp_shadow, &count);
+		if (retval != ERROR_OK)
+			return retval;
+		if (cortex_m_dwt_has_mask(cortex_m)) {
+			retval = cortex_m_queue_comparator_write(target, dwt_list[i].dwt_comparator_address + 4,
+					dwt_list[i].mask, &dwt_list[i].mask_shadow, &count);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		retval = cortex_m_queue_comparator_write(target, dwt_list[i].dwt_comparator_address + 8,
+				dwt_list[i].function, &dwt_list[i].function_shadow, &count);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	cortex_m->comparator_shadow_valid = true;
+	if (count)
+		LOG_TARGET_DEBUG(target, "%u FPB/DWT comparator writes queued", count);
+
+	return ERROR_OK;
+}
+
+/* Propagate a comparator change to the hardware. While the core is halted
+ * the writes are deferred and go out with the DHCSR write restarting it. */
+static int cortex_m_sync_comparators(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = &cortex_m->armv7m;
+
+	if (!target_was_examined(target))
+		return ERROR_TARGET_NOT_EXAMINED;
+
+	if (target->state == TARGET_HALTED && !armv7m->is_hla_target)
+		return ERROR_OK;
+
+	int retval = cortex_m_queue_comparators(target);
+	if (retval == ERROR_OK && !armv7m->is_hla_target)
+		retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		cortex_m->comparator_shadow_valid = false;
+
+	return retval;
+}
+
 static int cortex_m_write_debug_halt_mask(struct target *target,
 	uint32_t mask_on, uint32_t mask_off)
 {
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
+	bool restart = (mask_off & C_HALT) || (mask_on & C_STEP);
+	int retval;
+
+	/* flush deferred comparator updates in the same transaction */
+	if (restart) {
+		retval = cortex_m_queue_comparators(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
 
 	/* mask off status bits */
 	cortex_m->dcb_dhcsr &= ~((0xFFFFul << 16) | mask_off);
 	/* create new register mask */
 	cortex_m->dcb_dhcsr |= DBGKEY | C_DEBUGEN | mask_on;
 
-	return mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DHCSR, cortex_m->dcb_dhcsr);
+	retval = mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DHCSR, cortex_m->dcb_dhcsr);
+	if (retval != ERROR_OK && restart)
+		cortex_m->comparator_shadow_valid = false;
+
+	return retval;
 }
 
 static int cortex_m_set_maskints(struct target *target, bool mask)
@@ -609,8 +714,6 @@ static int cortex_m_endreset_event(struct target *target)
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
 	struct adiv5_dap *swjdp = cortex_m->armv7m.arm.dap;
-	struct cortex_m_fp_comparator *fp_list = cortex_m->fp_comparator_list;
-	struct cortex_m_dwt_comparator *dwt_list = cortex_m->dwt_comparator_list;
 
 	/* REVISIT The four debug monitor bits are currently ignored... */
 	retval = mem_ap_read_atomic_u32(armv7m->debug_ap, DCB_DEMCR, &dcb_demcr);
@@ -661,31 +764,15 @@ static int cortex_m_endreset_event(struct target *target)
 
 	cortex_m->fpb_enabled = true;
 
-	/* Restore FPB registers */
-	for (unsigned int i = 0; i < cortex_m->fp_num_code + cortex_m->fp_num_lit; i++) {
-		retval = target_write_u32(target, fp_list[i].fpcr_address, fp_list[i].fpcr_value);
-		if (retval != ERROR_OK)
-			return retval;
-	}
-
-	/* Restore DWT registers */
-	for (unsigned int i = 0; i < cortex_m->dwt_num_comp; i++) {
-		retval = target_write_u32(target, dwt_list[i].dwt_comparator_address + 0,
-				dwt_list[i].comp);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_write_u32(target, dwt_list[i].dwt_comparator_address + 4,
-				dwt_list[i].mask);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_write_u32(target, dwt_list[i].dwt_comparator_address + 8,
-				dwt_list[i].function);
-		if (retval != ERROR_OK)
-			return retval;
-	}
-	retval = dap_run(swjdp);
-	if (retval != ERROR_OK)
+	/* Restore FPB and DWT registers */
+	cortex_m->comparator_shadow_valid = false;
+	retval = cortex_m_queue_comparators(target);
+	if (retval == ERROR_OK)
+		retval = dap_run(swjdp);
+	if (retval != ERROR_OK) {
+		cortex_m->comparator_shadow_valid = false;
 		return retval;
+	}
 
 	register_cache_invalidate(armv7m->arm.core_cache);
 
@@ -1908,8 +1995,7 @@ int cortex_m_set_breakpoint(struct target *target, struct breakpoint *breakpoint
 		}
 		comparator_list[fp_num].used = true;
 		comparator_list[fp_num].fpcr_value = fpcr_value;
-		target_write_u32(target, comparator_list[fp_num].fpcr_address,
-			comparator_list[fp_num].fpcr_value);
+		cortex_m_sync_comparators(target);
 		LOG_TARGET_DEBUG(target, "fpc_num %i fpcr_value 0x%" PRIx32 "",
 			fp_num,
 			comparator_list[fp_num].fpcr_value);
@@ -1982,8 +2068,7 @@ int cortex_m_unset_breakpoint(struct target *target, struct breakpoint *breakpoi
 		}
 		comparator_list[fp_num].used = false;
 		comparator_list[fp_num].fpcr_value = 0;
-		target_write_u32(target, comparator_list[fp_num].fpcr_address,
-			comparator_list[fp_num].fpcr_value);
+		cortex_m_sync_comparators(target);
 	} else {
 		/* restore original instruction (kept in target endianness) */
 		retval = target_write_memory(target, breakpoint->address & 0xFFFFFFFE,
@@ -2044,11 +2129,8 @@ static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *wat
 	watchpoint_set(watchpoint, dwt_num);
 
 	comparator->comp = watchpoint->address;
-	target_write_u32(target, comparator->dwt_comparator_address + 0,
-		comparator->comp);
 
-	if ((cortex_m->dwt_devarch & 0x1FFFFF) != DWT_DEVARCH_ARMV8M_V2_0
-			&& (cortex_m->dwt_devarch & 0x1FFFFF) != DWT_DEVARCH_ARMV8M_V2_1) {
+	if (cortex_m_dwt_has_mask(cortex_m)) {
 		uint32_t mask = 0, temp;
 
 		/* watchpoint params were validated earlier */
@@ -2060,8 +2142,6 @@ static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *wat
 		mask--;
 
 		comparator->mask = mask;
-		target_write_u32(target, comparator->dwt_comparator_address + 4,
-			comparator->mask);
 
 		switch (watchpoint->rw) {
 		case WPT_READ:
@@ -2093,8 +2173,7 @@ static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *wat
 				(data_size << 10);
 	}
 
-	target_write_u32(target, comparator->dwt_comparator_address + 8,
-		comparator->function);
+	cortex_m_sync_comparators(target);
 
 	LOG_TARGET_DEBUG(target, "Watchpoint (ID %d) DWT%d 0x%08" PRIx32 " 0x%" PRIx32 " 0x%05" PRIx32,
 		watchpoint->unique_id, dwt_num,
@@ -2127,8 +2206,7 @@ static int cortex_m_unset_watchpoint(struct target *target, struct watchpoint *w
 	comparator = cortex_m->dwt_comparator_list + dwt_num;
 	comparator->used = false;
 	comparator->function = 0;
-	target_write_u32(target, comparator->dwt_comparator_address + 8,
-		comparator->function);
+	cortex_m_sync_comparators(target);
 
 	watchpoint->is_set = false;
 
@@ -2252,6 +2330,58 @@ static int cortex_m_read_memory(struct target *target, target_addr_t address,
 	return mem_ap_read_buf(armv7m->debug_ap, buffer, size, count, address);
 }
 
+static bool cortex_m_unaligned_v6m(target_addr_t address, uint32_t size)
+{
+	return ((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u));
+}
+
+static int cortex_m_read_memory_gather(struct target *target,
+	const struct target_memory_gather *items, unsigned int num_items)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	unsigned int i;
+
+	if (armv7m->arm.arch == ARM_ARCH_V6M) {
+		/* armv6m does not handle unaligned memory access */
+		for (i = 0; i < num_items; i++) {
+			if (cortex_m_unaligned_v6m(items[i].address, items[i].size))
+				break;
+		}
+	} else {
+		i = num_items;
+	}
+
+	if (i == num_items)
+		return mem_ap_read_buf_gather(armv7m->debug_ap, items, num_items);
+
+	/* Fail the unaligned items only, like reading the items one by one would.
+	 * The aligned items before the first unaligned one are read separately to
+	 * tell whether their error or the unaligned access comes first. */
+	struct target_memory_gather *aligned = malloc(num_items * sizeof(*aligned));
+	if (!aligned) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	unsigned int num_before = i, num_aligned = i;
+	memcpy(aligned, items, num_before * sizeof(*aligned));
+	for (; i < num_items; i++) {
+		if (!cortex_m_unaligned_v6m(items[i].address, items[i].size))
+			aligned[num_aligned++] = items[i];
+	}
+
+	int retval = ERROR_OK;
+	if (num_before)
+		retval = mem_ap_read_buf_gather(armv7m->debug_ap, aligned, num_before);
+	/* any error here comes after the unaligned access */
+	if (num_aligned > num_before)
+		mem_ap_read_buf_gather(armv7m->debug_ap, aligned + num_before,
+				num_aligned - num_before);
+	free(aligned);
+
+	return (retval != ERROR_OK) ? retval : ERROR_TARGET_UNALIGNED_ACCESS;
+}
+
 static int cortex_m_write_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
@@ -2279,8 +2409,13 @@ void cortex_m_deinit_target(struct target *target)
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 
-	if (!armv7m->is_hla_target && armv7m->debug_ap)
+	if (!armv7m->is_hla_target && armv7m->debug_ap) {
+		/* don't leave comparator updates deferred on a halted core */
+		if (target_was_examined(target) && cortex_m_queue_comparators(target) == ERROR_OK)
+			dap_run(armv7m->debug_ap->dap);
+
 		dap_put_ap(armv7m->debug_ap);
+	}
 
 	free(cortex_m->fp_comparator_list);
 
@@ -2385,6 +2520,10 @@ static int cortex_m_dwt_get_reg(struct reg *reg)
 static int cortex_m_dwt_set_reg(struct reg *reg, uint8_t *buf)
 {
 	struct dwt_reg_state *state = reg->arch_info;
+	struct cortex_m_common *cm = target_to_cm(state->target);
+
+	/* manual comparator setup bypasses the shadow */
+	cm->comparator_shadow_valid = false;
 
 	return target_write_u32(state->target, state->addr,
 			buf_get_u32(buf, 0, reg->size));
@@ -2778,6 +2917,7 @@ int cortex_m_examine(struct target *target)
 				cortex_m->fp_num_code + cortex_m->fp_num_lit,
 				sizeof(struct cortex_m_fp_comparator));
 		cortex_m->fpb_enabled = fpcr & 1;
+		cortex_m->comparator_shadow_valid = false;
 		for (unsigned int i = 0; i < cortex_m->fp_num_code + cortex_m->fp_num_lit; i++) {
 			cortex_m->fp_comparator_list[i].type =
 				(i < cortex_m->fp_num_code) ? FPCR_CODE : FPCR_LITERAL;
@@ -3200,9 +3340,11 @@ struct target_type cortexm_target = {
 	.get_gdb_reg_list = armv7m_get_gdb_reg_list,
 
 	.read_memory = cortex_m_read_memory,
+	.read_memory_gather = cortex_m_read_memory_gather,
 	.write_memory = cortex_m_write_memory,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
+	.survey_memory = armv7m_survey_memory,
 
 	.run_algorithm = armv7m_run_algorithm,
 	.start_algorithm = armv7m_start_algorithm,
@@ -196,6 +196,8 @@ struct cortex_m_fp_comparator {
 	int type;
 	uint32_t fpcr_value;
 	uint32_t fpcr_address;
+	/* value last written to the hardware */
+	uint32_t fpcr_shadow;
 };
 
 struct cortex_m_dwt_comparator {
@@ -204,6 +206,10 @@ struct cortex_m_dwt_comparator {
 	uint32_t mask;
 	uint32_t function;
 	uint32_t dwt_comparator_address;
+	/* values last written to the hardware */
+	uint32_t comp_shadow;
+	uint32_t mask_shadow;
+	uint32_t function_shadow;
 };
 
 enum cortex_m_soft_reset_config {
@@ -245,6 +251,10 @@ struct cortex_m_common {
 	struct cortex_m_dwt_comparator *dwt_comparator_list;
 	struct reg_cache *dwt_cache;
 
+	/* FPB/DWT comparator shadows match the hardware. Comparator updates
+	 * made while halted are deferred and queued with the next resume. */
+	bool comparator_shadow_valid;
+
 	enum cortex_m_soft_reset_config soft_reset_config;
 	bool vectreset_supported;
 	enum cortex_m_isrmasking_mode isrmasking_mode;
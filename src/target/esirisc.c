@@ -1613,6 +1613,8 @@ static void esirisc_deinit_target(struct target *target)
 {
 	struct esirisc_common *esirisc = target_to_esirisc(target);
 
+	esirisc_trace_deinit(target);
+
 	if (!target_was_examined(target))
 		return;
 
@@ -74,6 +74,54 @@ static const char * const esirisc_trace_trigger_strings[] = {
 	"high", "low",	/* start only */
 };
 
+struct esirisc_trace_entry {
+	uint32_t id;
+	uint32_t ext_id;
+	uint32_t eid;
+	uint32_t pc;
+	uint32_t count;
+};
+
+/*
+ * Streaming capture state. Trace data is drained into a bounded window each
+ * time the target halts; entries which straddle a drain are carried over to
+ * the next one so that host memory does not grow with the capture length.
+ */
+#define STREAM_CHUNK_SIZE	4096
+#define STREAM_CARRY_SIZE	8	/* longest entry is 44 bits */
+#define STREAM_RECORD_SIZE	8
+
+struct esirisc_trace_pc_count {
+	uint32_t pc;
+	uint32_t count;
+};
+
+struct esirisc_trace_stream {
+	struct target *target;
+	struct fileio *fileio;
+	char *counts_filename;
+
+	target_addr_t next_address;
+
+	uint8_t window[STREAM_CARRY_SIZE + STREAM_CHUNK_SIZE];
+	uint32_t window_len;
+	unsigned int window_pos;
+
+	uint8_t out[STREAM_CHUNK_SIZE];
+	uint32_t out_len;
+
+	struct esirisc_trace_pc_count *counts;
+	uint32_t counts_size;
+	uint32_t counts_used;
+
+	uint64_t bytes;
+	uint64_t entries;
+	uint64_t records;
+	uint64_t gaps;
+	bool resync;
+	int error;
+};
+
 static int esirisc_trace_clear_status(struct target *target)
 {
 	struct esirisc_common *esirisc = target_to_esirisc(target);
@@ -92,6 +140,20 @@ static int esirisc_trace_clear_status(struct target *target)
 	return ERROR_OK;
 }
 
+static int esirisc_trace_ack_status(struct target *target, uint32_t status)
+{
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_jtag *jtag_info = &esirisc->jtag_info;
+
+	int retval = esirisc_jtag_write_csr(jtag_info, CSR_TRACE, CSR_TRACE_STATUS, status);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "failed to write Trace CSR: Status");
+		return retval;
+	}
+
+	return ERROR_OK;
+}
+
 static int esirisc_trace_get_status(struct target *target, uint32_t *status)
 {
 	struct esirisc_common *esirisc = target_to_esirisc(target);
@@ -374,6 +436,67 @@ static int esirisc_trace_read_buffer(struct target *target, uint8_t *buffer)
 			buffer_cur - trace_info->buffer_start, buffer);
 }
 
+static int esirisc_trace_decode_full(struct target *target, uint8_t *buffer, uint32_t size,
+		unsigned int *pos, struct esirisc_trace_entry *entry)
+{
+	unsigned int start = *pos;
+	int retval;
+
+	memset(entry, 0, sizeof(*entry));
+
+	retval = esirisc_trace_buf_get_u32(buffer, size, pos, 2, &entry->id);
+	if (retval != ERROR_OK)
+		goto fail;
+
+	if (entry->id != ESIRISC_TRACE_ID_EXTENDED)
+		return ERROR_OK;
+
+	retval = esirisc_trace_buf_get_u32(buffer, size, pos, 4, &entry->ext_id);
+	if (retval != ERROR_OK)
+		goto fail;
+
+	switch (entry->ext_id) {
+		case ESIRISC_TRACE_EXT_ID_STOP:
+		case ESIRISC_TRACE_EXT_ID_WAIT:
+		case ESIRISC_TRACE_EXT_ID_MULTICYCLE:
+		case ESIRISC_TRACE_EXT_ID_END:
+			return ERROR_OK;
+
+		case ESIRISC_TRACE_EXT_ID_ERET:
+		case ESIRISC_TRACE_EXT_ID_PC:
+		case ESIRISC_TRACE_EXT_ID_INDIRECT:
+		case ESIRISC_TRACE_EXT_ID_END_PC:
+			retval = esirisc_trace_buf_get_pc(target, buffer, size, pos, &entry->pc);
+			if (retval != ERROR_OK)
+				goto fail;
+			return ERROR_OK;
+
+		case ESIRISC_TRACE_EXT_ID_EXCEPTION:
+			retval = esirisc_trace_buf_get_u32(buffer, size, pos, 6, &entry->eid);
+			if (retval != ERROR_OK)
+				goto fail;
+
+			retval = esirisc_trace_buf_get_pc(target, buffer, size, pos, &entry->pc);
+			if (retval != ERROR_OK)
+				goto fail;
+			return ERROR_OK;
+
+		case ESIRISC_TRACE_EXT_ID_COUNT:
+			retval = esirisc_trace_buf_get_u32(buffer, size, pos, 6, &entry->count);
+			if (retval != ERROR_OK)
+				goto fail;
+			return ERROR_OK;
+
+		default:
+			return ERROR_FAIL;
+	}
+
+fail:
+	/* rewind so that a partial entry may be decoded once more data is read */
+	*pos = start;
+	return ERROR_BUF_TOO_SMALL;
+}
+
 static int esirisc_trace_analyze_full(struct command_invocation *cmd, uint8_t *buffer, uint32_t size)
 {
 	struct target *target = get_current_target(cmd->ctx);
@@ -382,95 +505,57 @@ static int esirisc_trace_analyze_full(struct command_invocation *cmd, uint8_t *b
 
 	unsigned int pos = 0;
 	while (pos < num_bits) {
-		uint32_t id;
+		struct esirisc_trace_entry entry;
 
-		retval = esirisc_trace_buf_get_u32(buffer, size, &pos, 2, &id);
-		if (retval != ERROR_OK)
-			goto fail;
+		retval = esirisc_trace_decode_full(target, buffer, size, &pos, &entry);
+		if (retval == ERROR_BUF_TOO_SMALL)
+			break;
+		if (retval != ERROR_OK) {
+			command_print(cmd, "invalid extended trace ID: %" PRIu32, entry.ext_id);
+			return retval;
+		}
 
-		switch (id) {
-			case ESIRISC_TRACE_ID_EXECUTE:
-			case ESIRISC_TRACE_ID_STALL:
-			case ESIRISC_TRACE_ID_BRANCH:
-				command_print(cmd, "%s", esirisc_trace_id_strings[id]);
+		if (entry.id != ESIRISC_TRACE_ID_EXTENDED) {
+			command_print(cmd, "%s", esirisc_trace_id_strings[entry.id]);
+			continue;
+		}
+
+		switch (entry.ext_id) {
+			case ESIRISC_TRACE_EXT_ID_STOP:
+			case ESIRISC_TRACE_EXT_ID_WAIT:
+			case ESIRISC_TRACE_EXT_ID_MULTICYCLE:
+				command_print(cmd, "%s", esirisc_trace_ext_id_strings[entry.ext_id]);
 				break;
 
-			case ESIRISC_TRACE_ID_EXTENDED: {
-				uint32_t ext_id;
-
-				retval = esirisc_trace_buf_get_u32(buffer, size, &pos, 4, &ext_id);
-				if (retval != ERROR_OK)
-					goto fail;
-
-				switch (ext_id) {
-					case ESIRISC_TRACE_EXT_ID_STOP:
-					case ESIRISC_TRACE_EXT_ID_WAIT:
-					case ESIRISC_TRACE_EXT_ID_MULTICYCLE:
-						command_print(cmd, "%s", esirisc_trace_ext_id_strings[ext_id]);
-						break;
-
-					case ESIRISC_TRACE_EXT_ID_ERET:
-					case ESIRISC_TRACE_EXT_ID_PC:
-					case ESIRISC_TRACE_EXT_ID_INDIRECT:
-					case ESIRISC_TRACE_EXT_ID_END_PC: {
-						uint32_t pc;
-
-						retval = esirisc_trace_buf_get_pc(target, buffer, size, &pos, &pc);
-						if (retval != ERROR_OK)
-							goto fail;
-
-						command_print(cmd, "%s PC: 0x%" PRIx32,
-								esirisc_trace_ext_id_strings[ext_id], pc);
-
-						if (ext_id == ESIRISC_TRACE_EXT_ID_END_PC) {
-							command_print(cmd, "--- end of trace ---");
-							return ERROR_OK;
-						}
-						break;
-					}
-					case ESIRISC_TRACE_EXT_ID_EXCEPTION: {
-						uint32_t eid, epc;
-
-						retval = esirisc_trace_buf_get_u32(buffer, size, &pos, 6, &eid);
-						if (retval != ERROR_OK)
-							goto fail;
-
-						retval = esirisc_trace_buf_get_pc(target, buffer, size, &pos, &epc);
-						if (retval != ERROR_OK)
-							goto fail;
-
-						command_print(cmd, "%s EID: 0x%" PRIx32 ", EPC: 0x%" PRIx32,
-								esirisc_trace_ext_id_strings[ext_id], eid, epc);
-						break;
-					}
-					case ESIRISC_TRACE_EXT_ID_COUNT: {
-						uint32_t count;
-
-						retval = esirisc_trace_buf_get_u32(buffer, size, &pos, 6, &count);
-						if (retval != ERROR_OK)
-							goto fail;
-
-						command_print(cmd, "repeats %" PRIu32 " %s", count,
-								(count == 1) ? "time" : "times");
-						break;
-					}
-					case ESIRISC_TRACE_EXT_ID_END:
-						command_print(cmd, "--- end of trace ---");
-						return ERROR_OK;
-
-					default:
-						command_print(cmd, "invalid extended trace ID: %" PRIu32, ext_id);
-						return ERROR_FAIL;
+			case ESIRISC_TRACE_EXT_ID_ERET:
+			case ESIRISC_TRACE_EXT_ID_PC:
+			case ESIRISC_TRACE_EXT_ID_INDIRECT:
+			case ESIRISC_TRACE_EXT_ID_END_PC:
+				command_print(cmd, "%s PC: 0x%" PRIx32,
+						esirisc_trace_ext_id_strings[entry.ext_id], entry.pc);
+
+				if (entry.ext_id == ESIRISC_TRACE_EXT_ID_END_PC) {
+					command_print(cmd, "--- end of trace ---");
+					return ERROR_OK;
 				}
 				break;
-			}
-			default:
-				command_print(cmd, "invalid trace ID: %" PRIu32, id);
-				return ERROR_FAIL;
+
+			case ESIRISC_TRACE_EXT_ID_EXCEPTION:
+				command_print(cmd, "%s EID: 0x%" PRIx32 ", EPC: 0x%" PRIx32,
+						esirisc_trace_ext_id_strings[entry.ext_id], entry.eid, entry.pc);
+				break;
+
+			case ESIRISC_TRACE_EXT_ID_COUNT:
+				command_print(cmd, "repeats %" PRIu32 " %s", entry.count,
+						(entry.count == 1) ? "time" : "times");
+				break;
+
+			case ESIRISC_TRACE_EXT_ID_END:
+				command_print(cmd, "--- end of trace ---");
+				return ERROR_OK;
 		}
 	}
 
-fail:
 	command_print(cmd, "trace buffer too small");
 	return ERROR_BUF_TOO_SMALL;
 }
@@ -659,6 +744,448 @@ done:
 	return retval;
 }
 
+static int esirisc_trace_stream_count_pc(struct esirisc_trace_stream *stream, uint32_t pc)
+{
+	/* grow the open-addressed table once it is half full */
+	if (stream->counts_used * 2 >= stream->counts_size) {
+		uint32_t size = stream->counts_size ? stream->counts_size * 2 : 1024;
+		struct esirisc_trace_pc_count *counts = calloc(size, sizeof(*counts));
+		if (!counts) {
+			LOG_ERROR("out of memory");
+			return ERROR_FAIL;
+		}
+
+		for (uint32_t i = 0; i < stream->counts_size; i++) {
+			struct esirisc_trace_pc_count *old = &stream->counts[i];
+			if (!old->count)
+				continue;
+
+			uint32_t j = (old->pc * 2654435761u) & (size - 1);
+			while (counts[j].count)
+				j = (j + 1) & (size - 1);
+			counts[j] = *old;
+		}
+
+		free(stream->counts);
+		stream->counts = counts;
+		stream->counts_size = size;
+	}
+
+	uint32_t i = (pc * 2654435761u) & (stream->counts_size - 1);
+	while (stream->counts[i].count && stream->counts[i].pc != pc)
+		i = (i + 1) & (stream->counts_size - 1);
+
+	if (!stream->counts[i].count) {
+		stream->counts[i].pc = pc;
+		stream->counts_used++;
+	}
+	stream->counts[i].count++;
+
+	return ERROR_OK;
+}
+
+static int esirisc_trace_stream_flush(struct esirisc_trace_stream *stream)
+{
+	size_t size_written;
+	int retval;
+
+	if (!stream->out_len)
+		return ERROR_OK;
+
+	retval = fileio_write(stream->fileio, stream->out_len, stream->out, &size_written);
+	if (retval == ERROR_OK && size_written != stream->out_len)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+	if (retval != ERROR_OK)
+		LOG_TARGET_ERROR(stream->target, "failed to write trace stream file");
+
+	stream->out_len = 0;
+
+	return retval;
+}
+
+static int esirisc_trace_stream_record(struct esirisc_trace_stream *stream,
+		const struct esirisc_trace_entry *entry)
+{
+	int retval;
+
+	h_u32_to_le(stream->out + stream->out_len, entry->pc);
+	h_u32_to_le(stream->out + stream->out_len + 4, entry->ext_id | (entry->eid << 8));
+	stream->out_len += STREAM_RECORD_SIZE;
+	stream->records++;
+
+	if (stream->out_len == sizeof(stream->out)) {
+		retval = esirisc_trace_stream_flush(stream);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (stream->counts_filename)
+		return esirisc_trace_stream_count_pc(stream, entry->pc);
+
+	return ERROR_OK;
+}
+
+static int esirisc_trace_stream_decode(struct esirisc_trace_stream *stream)
+{
+	struct target *target = stream->target;
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+	const uint32_t end_of_trace = BIT_MASK(trace_info->pc_bits) << 1;
+	int retval;
+
+	while (true) {
+		struct esirisc_trace_entry entry;
+		unsigned int pos = stream->window_pos;
+
+		if (trace_info->format == ESIRISC_TRACE_FORMAT_ICACHE) {
+			memset(&entry, 0, sizeof(entry));
+
+			retval = esirisc_trace_buf_get_pc(target, stream->window, stream->window_len,
+					&stream->window_pos, &entry.pc);
+			if (retval != ERROR_OK)
+				return ERROR_OK;
+
+			stream->entries++;
+			if (entry.pc == end_of_trace)
+				continue;
+
+			entry.ext_id = ESIRISC_TRACE_EXT_ID_PC;
+		} else {
+			retval = esirisc_trace_decode_full(target, stream->window, stream->window_len,
+					&stream->window_pos, &entry);
+			if (retval == ERROR_BUF_TOO_SMALL)
+				return ERROR_OK;
+			if (retval != ERROR_OK && stream->resync) {
+				/* entries carry no sync marker; hunt for one bit by bit */
+				stream->window_pos = pos + 1;
+				continue;
+			}
+			if (retval != ERROR_OK) {
+				LOG_TARGET_ERROR(target, "invalid extended trace ID: %" PRIu32, entry.ext_id);
+				return retval;
+			}
+
+			stream->entries++;
+			if (entry.id != ESIRISC_TRACE_ID_EXTENDED)
+				continue;
+
+			switch (entry.ext_id) {
+				case ESIRISC_TRACE_EXT_ID_ERET:
+				case ESIRISC_TRACE_EXT_ID_PC:
+				case ESIRISC_TRACE_EXT_ID_INDIRECT:
+				case ESIRISC_TRACE_EXT_ID_END_PC:
+				case ESIRISC_TRACE_EXT_ID_EXCEPTION:
+					break;
+				default:
+					continue;
+			}
+		}
+
+		stream->resync = false;
+
+		retval = esirisc_trace_stream_record(stream, &entry);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+}
+
+static void esirisc_trace_stream_gap(struct esirisc_trace_stream *stream, const char *reason)
+{
+	LOG_TARGET_WARNING(stream->target, "trace %s since the previous halt, trace data lost",
+			reason);
+
+	/* the data that follows does not continue a partially decoded entry */
+	stream->window_len = 0;
+	stream->window_pos = 0;
+	stream->resync = true;
+	stream->gaps++;
+}
+
+static int esirisc_trace_stream_drain_region(struct esirisc_trace_stream *stream,
+		target_addr_t address, uint32_t size)
+{
+	int retval;
+
+	while (size > 0) {
+		uint32_t count = MIN(size, STREAM_CHUNK_SIZE);
+
+		/* keep only the bytes holding a partially decoded entry */
+		uint32_t consumed = stream->window_pos / 8;
+		memmove(stream->window, stream->window + consumed, stream->window_len - consumed);
+		stream->window_len -= consumed;
+		stream->window_pos %= 8;
+
+		retval = esirisc_trace_read_memory(stream->target, address, count,
+				stream->window + stream->window_len);
+		if (retval != ERROR_OK)
+			return retval;
+
+		stream->window_len += count;
+		stream->bytes += count;
+
+		retval = esirisc_trace_stream_decode(stream);
+		if (retval != ERROR_OK)
+			return retval;
+
+		address += count;
+		size -= count;
+	}
+
+	return ERROR_OK;
+}
+
+static int esirisc_trace_stream_drain(struct esirisc_trace_stream *stream)
+{
+	struct target *target = stream->target;
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_jtag *jtag_info = &esirisc->jtag_info;
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+	uint32_t buffer_cur, status;
+	int retval;
+
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	retval = esirisc_trace_get_status(target, &status);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = esirisc_jtag_read_csr(jtag_info, CSR_TRACE, CSR_TRACE_BUFFER_CUR, &buffer_cur);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "failed to read Trace CSR: BufferCurrent");
+		return retval;
+	}
+
+	/*
+	 * The Wrapped flag is cleared after every drain. If it is set while
+	 * BufferCurrent is not behind the last position, the buffer was lapped
+	 * and the oldest data still held starts at BufferCurrent.
+	 */
+	bool wrapped = buffer_cur < stream->next_address;
+	if ((status & STATUS_W) && !wrapped) {
+		esirisc_trace_stream_gap(stream, "buffer wrapped more than once");
+		stream->next_address = buffer_cur;
+		wrapped = true;
+	}
+
+	/*
+	 * Only data written since the previous drain is read. If the circular
+	 * buffer has wrapped, the tail of the buffer must be consumed first.
+	 */
+	if (wrapped) {
+		retval = esirisc_trace_stream_drain_region(stream, stream->next_address,
+				trace_info->buffer_end - stream->next_address);
+		if (retval != ERROR_OK)
+			return retval;
+
+		stream->next_address = trace_info->buffer_start;
+	}
+
+	retval = esirisc_trace_stream_drain_region(stream, stream->next_address,
+			buffer_cur - stream->next_address);
+	if (retval != ERROR_OK)
+		return retval;
+
+	stream->next_address = buffer_cur;
+
+	if (status & STATUS_O)
+		esirisc_trace_stream_gap(stream, "overflowed");
+
+	if (status & (STATUS_W | STATUS_O)) {
+		retval = esirisc_trace_ack_status(target, status & (STATUS_W | STATUS_O));
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return esirisc_trace_stream_flush(stream);
+}
+
+static int esirisc_trace_stream_event_callback(struct target *target,
+		enum target_event event, void *priv)
+{
+	struct esirisc_trace_stream *stream = priv;
+
+	if (target != stream->target || event != TARGET_EVENT_HALTED || stream->error != ERROR_OK)
+		return ERROR_OK;
+
+	stream->error = esirisc_trace_stream_drain(stream);
+	if (stream->error != ERROR_OK)
+		LOG_TARGET_ERROR(target, "trace stream stopped; data will no longer be collected");
+
+	return ERROR_OK;
+}
+
+static int esirisc_trace_pc_count_compare(const void *a, const void *b)
+{
+	const struct esirisc_trace_pc_count *x = a, *y = b;
+
+	if (x->pc < y->pc)
+		return -1;
+
+	return x->pc > y->pc;
+}
+
+static int esirisc_trace_stream_write_counts(struct esirisc_trace_stream *stream)
+{
+	uint32_t n = 0;
+
+	/* compact the hash table in place before sorting by PC */
+	for (uint32_t i = 0; i < stream->counts_size; i++) {
+		if (stream->counts[i].count)
+			stream->counts[n++] = stream->counts[i];
+	}
+
+	if (n)
+		qsort(stream->counts, n, sizeof(*stream->counts), esirisc_trace_pc_count_compare);
+
+	FILE *f = fopen(stream->counts_filename, "w");
+	if (!f) {
+		LOG_TARGET_ERROR(stream->target, "could not open count file: %s",
+				stream->counts_filename);
+		return ERROR_FAIL;
+	}
+
+	for (uint32_t i = 0; i < n; i++)
+		fprintf(f, "0x%08" PRIx32 " %" PRIu32 "\n", stream->counts[i].pc,
+				stream->counts[i].count);
+
+	if (fclose(f) != 0) {
+		LOG_TARGET_ERROR(stream->target, "could not write count file: %s",
+				stream->counts_filename);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void esirisc_trace_stream_free(struct esirisc_trace_stream *stream)
+{
+	target_unregister_event_callback(esirisc_trace_stream_event_callback, stream);
+
+	if (stream->fileio)
+		fileio_close(stream->fileio);
+
+	free(stream->counts_filename);
+	free(stream->counts);
+	free(stream);
+}
+
+static int esirisc_trace_stream_start(struct command_invocation *cmd,
+		const char *filename, const char *counts_filename)
+{
+	struct target *target = get_current_target(cmd->ctx);
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_jtag *jtag_info = &esirisc->jtag_info;
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+	struct esirisc_trace_stream *stream;
+	uint32_t buffer_cur;
+	int retval;
+
+	if (trace_info->stream) {
+		command_print(cmd, "trace stream already started");
+		return ERROR_FAIL;
+	}
+
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	retval = esirisc_jtag_read_csr(jtag_info, CSR_TRACE, CSR_TRACE_BUFFER_CUR, &buffer_cur);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "failed to read Trace CSR: BufferCurrent");
+		return retval;
+	}
+
+	/* only wraps and overflows during the capture are of interest */
+	retval = esirisc_trace_ack_status(target, STATUS_W | STATUS_O);
+	if (retval != ERROR_OK)
+		return retval;
+
+	stream = calloc(1, sizeof(*stream));
+	if (!stream) {
+		command_print(cmd, "out of memory");
+		return ERROR_FAIL;
+	}
+
+	stream->target = target;
+	stream->next_address = buffer_cur;
+	stream->error = ERROR_OK;
+
+	if (counts_filename) {
+		stream->counts_filename = strdup(counts_filename);
+		if (!stream->counts_filename) {
+			command_print(cmd, "out of memory");
+			free(stream);
+			return ERROR_FAIL;
+		}
+	}
+
+	retval = fileio_open(&stream->fileio, filename, FILEIO_WRITE, FILEIO_BINARY);
+	if (retval != ERROR_OK) {
+		command_print(cmd, "could not open stream file: %s", filename);
+		stream->fileio = NULL;
+		esirisc_trace_stream_free(stream);
+		return retval;
+	}
+
+	retval = target_register_event_callback(esirisc_trace_stream_event_callback, stream);
+	if (retval != ERROR_OK) {
+		esirisc_trace_stream_free(stream);
+		return retval;
+	}
+
+	trace_info->stream = stream;
+
+	command_print(cmd, "trace stream started");
+
+	return ERROR_OK;
+}
+
+static int esirisc_trace_stream_stop(struct command_invocation *cmd)
+{
+	struct target *target = get_current_target(cmd->ctx);
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+	struct esirisc_trace_stream *stream = trace_info->stream;
+	int retval;
+
+	if (!stream) {
+		command_print(cmd, "trace stream not started");
+		return ERROR_FAIL;
+	}
+
+	if (stream->error == ERROR_OK && target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	retval = stream->error;
+	if (retval == ERROR_OK)
+		retval = esirisc_trace_stream_drain(stream);
+
+	if (retval == ERROR_OK && stream->counts_filename)
+		retval = esirisc_trace_stream_write_counts(stream);
+
+	if (retval == ERROR_OK)
+		command_print(cmd, "trace stream stopped: %" PRIu64 " bytes, %" PRIu64 " entries, "
+				"%" PRIu64 " records, %" PRIu32 " unique PCs, %" PRIu64 " gaps",
+				stream->bytes, stream->entries, stream->records, stream->counts_used,
+				stream->gaps);
+
+	trace_info->stream = NULL;
+	esirisc_trace_stream_free(stream);
+
+	return retval;
+}
+
+void esirisc_trace_deinit(struct target *target)
+{
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+
+	if (trace_info->stream) {
+		esirisc_trace_stream_free(trace_info->stream);
+		trace_info->stream = NULL;
+	}
+}
+
 COMMAND_HANDLER(handle_esirisc_trace_init_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -851,6 +1378,39 @@ COMMAND_HANDLER(handle_esirisc_trace_dump_command)
 	}
 }
 
+COMMAND_HANDLER(handle_esirisc_trace_stream_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+
+	if (!esirisc->has_trace) {
+		command_print(CMD, "target does not support trace");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC < 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (strcmp(CMD_ARGV[0], "stop") == 0) {
+		if (CMD_ARGC != 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		return esirisc_trace_stream_stop(CMD);
+	}
+
+	if (strcmp(CMD_ARGV[0], "start") != 0 || CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	/* also see: handle_esirisc_trace_analyze_command() */
+	if (esirisc_trace_is_fifo(trace_info)) {
+		command_print(CMD, "stream from FIFO not supported");
+		return ERROR_FAIL;
+	}
+
+	return esirisc_trace_stream_start(CMD, CMD_ARGV[1], (CMD_ARGC == 3) ? CMD_ARGV[2] : NULL);
+}
+
 COMMAND_HANDLER(handle_esirisc_trace_buffer_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -1108,6 +1668,13 @@ static const struct command_registration esirisc_trace_exec_command_handlers[] =
 		.help = "dump collected trace data to file",
 		.usage = "[address size] filename",
 	},
+	{
+		.name = "stream",
+		.handler = handle_esirisc_trace_stream_command,
+		.mode = COMMAND_EXEC,
+		.help = "stream trace data to file, draining the buffer each time the target halts",
+		.usage = "('start' filename [count_filename])|'stop'",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
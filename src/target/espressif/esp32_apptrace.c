@@ -28,6 +28,7 @@
 #include <target/target_type.h>
 #include <target/smp.h>
 #include <server/server.h>
+#include <server/trace_ring.h>
 #include "esp_xtensa.h"
 #include "esp_xtensa_smp.h"
 #include "esp_xtensa_apptrace.h"
@@ -269,6 +270,44 @@ static int esp32_apptrace_tcp_dest_init(struct esp32_apptrace_dest *dest, const
 	return ERROR_OK;
 }
 
+#define ESP32_APPTRACE_RING_SIZE	(256 * 1024)
+
+static int esp32_apptrace_ring_sink_write(void *priv, const uint8_t *data, size_t len)
+{
+	struct esp32_apptrace_dest *dest = priv;
+
+	return dest->write(dest->priv, (uint8_t *)data, len) == ERROR_OK ? (int)len : -1;
+}
+
+static const struct trace_ring_sink esp32_apptrace_ring_sink = {
+	.name = "apptrace",
+	.write = esp32_apptrace_ring_sink_write,
+};
+
+static int esp32_apptrace_dest_attach(struct esp32_apptrace_dest *dest, unsigned int index,
+	const char *dest_path)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "apptrace.%u", index);
+	dest->ring = trace_ring_get(name, ESP32_APPTRACE_RING_SIZE);
+	if (!dest->ring)
+		return ERROR_FAIL;
+
+	dest->sub = trace_ring_subscribe(dest->ring, &esp32_apptrace_ring_sink, dest, dest_path);
+	if (!dest->sub)
+		return ERROR_FAIL;
+	/* trace data is never dropped for the destination given on the command line */
+	dest->sub->lossless = true;
+
+	return ERROR_OK;
+}
+
+int esp32_apptrace_dest_write(struct esp32_apptrace_dest *dest, uint8_t *data, int size)
+{
+	return trace_ring_write(dest->ring, data, size);
+}
+
 int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests)
 {
 	int res;
@@ -284,6 +323,8 @@ int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest
 		else
 			break;
 
+		if (res == ERROR_OK)
+			res = esp32_apptrace_dest_attach(&dest[i], i, dest_paths[i]);
 		if (res != ERROR_OK) {
 			LOG_ERROR("apptrace: Failed to init trace data destination '%s'!", dest_paths[i]);
 			return 0;
@@ -295,6 +336,12 @@ int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest
 
 int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int max_dests)
 {
+	/* the rings stay, other sinks may still be attached to them */
+	for (unsigned int i = 0; i < max_dests; i++) {
+		trace_ring_unsubscribe(dest[i].sub);
+		dest[i].sub = NULL;
+	}
+
 	for (unsigned int i = 0; i < max_dests; i++) {
 		if (dest[i].clean && dest[i].priv) {
 			int res = dest[i].clean(dest[i].priv);
@@ -889,7 +936,7 @@ static int esp32_apptrace_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 		if (ctx->tot_len + wr_chunk_len > cmd_data->max_len)
 			wr_chunk_len -= (ctx->tot_len + wr_chunk_len - cmd_data->skip_len) - cmd_data->max_len;
 		if (wr_chunk_len > 0) {
-			int res = cmd_data->data_dest.write(cmd_data->data_dest.priv, data + wr_idx, wr_chunk_len);
+			int res = esp32_apptrace_dest_write(&cmd_data->data_dest, data + wr_idx, wr_chunk_len);
 			if (res != ERROR_OK) {
 				LOG_ERROR("Failed to write %" PRId32 " bytes to dest 0!", data_len);
 				return res;
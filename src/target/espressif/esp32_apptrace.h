@@ -56,6 +56,9 @@ struct esp32_apptrace_dest {
 	int (*write)(void *priv, uint8_t *data, int size);
 	int (*clean)(void *priv);
 	bool log_progress;
+	/** data goes through the trace ring "apptrace.<n>", @a write is one of its sinks */
+	struct trace_ring *ring;
+	struct trace_ring_sub *sub;
 };
 
 struct esp32_apptrace_format {
@@ -116,6 +119,7 @@ void esp32_apptrace_cmd_args_parse(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	int argc);
 int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests);
 int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int max_dests);
+int esp32_apptrace_dest_write(struct esp32_apptrace_dest *dest, uint8_t *data, int size);
 int esp_apptrace_usr_block_write(const struct esp32_apptrace_hw *hw, struct target *target,
 	uint32_t block_id,
 	const uint8_t *data,
@@ -54,6 +54,11 @@ static struct reg_cache *lakemont_build_reg_cache
 static int submit_reg_pir(struct target *t, int num);
 static int submit_instruction_pir(struct target *t, int num);
 static int submit_pir(struct target *t, uint64_t op);
+static int transaction_status(struct target *t);
+static int read_mem_block(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, uint8_t *buf);
+static int write_mem_block(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, const uint8_t *buf);
 static int lakemont_get_core_reg(struct reg *reg);
 static int lakemont_set_core_reg(struct reg *reg, uint8_t *buf);
 
@@ -704,6 +709,170 @@ static int write_hw_reg(struct target *t, int reg, uint32_t regval, uint8_t cach
 	return ERROR_OK;
 }
 
+/* queue the scans of write_hw_reg() for a register not held in the cache */
+static int queue_write_hw_reg(struct target *t, int reg, uint32_t regval)
+{
+	uint8_t reg_buf[4];
+	buf_set_u32(reg_buf, 0, 32, regval);
+
+	if (submit_reg_pir(t, reg) != ERROR_OK)
+		return ERROR_FAIL;
+	if (submit_instruction_pir(t, SRAMACCESS) != ERROR_OK)
+		return ERROR_FAIL;
+	scan.out[0] = RDWRPDR;
+	if (irscan(t, scan.out, NULL, LMT_IRLEN) != ERROR_OK)
+		return ERROR_FAIL;
+	if (drscan(t, reg_buf, scan.out, PDR_SIZE) != ERROR_OK)
+		return ERROR_FAIL;
+	return submit_instruction_pir(t, PDR2SRAM);
+}
+
+/* queue the scans of read_hw_reg(), the value is captured into in[0..3] */
+static int queue_read_hw_reg(struct target *t, int reg, uint8_t *in)
+{
+	if (submit_reg_pir(t, reg) != ERROR_OK)
+		return ERROR_FAIL;
+	if (submit_instruction_pir(t, SRAMACCESS) != ERROR_OK)
+		return ERROR_FAIL;
+	if (submit_instruction_pir(t, SRAM2PDR) != ERROR_OK)
+		return ERROR_FAIL;
+	scan.out[0] = RDWRPDR;
+	if (irscan(t, scan.out, NULL, LMT_IRLEN) != ERROR_OK)
+		return ERROR_FAIL;
+	if (drscan(t, NULL, in, PDR_SIZE) != ERROR_OK)
+		return ERROR_FAIL;
+	jtag_add_sleep(DELAY_SUBMITPIR);
+	return ERROR_OK;
+}
+
+static int mem_instruction(struct target *t, uint32_t size, bool write)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+
+	/* if CS.D bit=1 then its a 32 bit code segment, else 16 */
+	bool use32 = (buf_get_u32(x86_32->cache->reg_list[CSAR].value, 0, 32)) & CSAR_D;
+	switch (size) {
+	case BYTE:
+		return write ? (use32 ? MEMWRB32 : MEMWRB16) : (use32 ? MEMRDB32 : MEMRDB16);
+	case WORD:
+		return write ? (use32 ? MEMWRH32 : MEMWRH16) : (use32 ? MEMRDH32 : MEMRDH16);
+	case DWORD:
+		return write ? (use32 ? MEMWRW32 : MEMWRW16) : (use32 ? MEMRDW32 : MEMRDW16);
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Read count elements of size bytes, chaining the address setup, the memory
+ * read instruction and the EDX readback of LMT_MEM_BATCH elements into one
+ * JTAG queue instead of flushing after each register access.
+ */
+static int read_mem_block(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, uint8_t *buf)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	int instr = mem_instruction(t, size, false);
+	if (instr < 0) {
+		LOG_ERROR("%s invalid read mem size", __func__);
+		return ERROR_FAIL;
+	}
+
+	uint8_t *in = malloc(LMT_MEM_BATCH * 4);
+	if (!in) {
+		LOG_ERROR("%s out of memory", __func__);
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	int flush = x86_32->flush;
+	x86_32->flush = 0;
+	while (count > 0) {
+		uint32_t n = MIN(count, LMT_MEM_BATCH);
+		for (uint32_t i = 0; i < n && retval == ERROR_OK; i++) {
+			retval = queue_write_hw_reg(t, EAX, addr + i * size);
+			if (retval == ERROR_OK)
+				retval = submit_instruction_pir(t, instr);
+			if (retval == ERROR_OK)
+				retval = queue_read_hw_reg(t, EDX, in + i * 4);
+		}
+		if (retval == ERROR_OK)
+			retval = jtag_execute_queue();
+		if (retval != ERROR_OK) {
+			LOG_ERROR("%s failed to execute queue", __func__);
+			break;
+		}
+
+		for (uint32_t i = 0; i < n; i++) {
+			uint32_t regval = buf_get_u32(in + i * 4, 0, 32);
+			for (uint32_t j = 0; j < size; j++)
+				buf[i * size + j] = (regval >> (j * 8)) & 0xff;
+		}
+
+		retval = transaction_status(t);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("%s error on mem read", __func__);
+			break;
+		}
+
+		addr += n * size;
+		buf += n * size;
+		count -= n;
+	}
+	x86_32->flush = flush;
+
+	free(in);
+	return retval;
+}
+
+static int write_mem_block(struct target *t, uint32_t size,
+			uint32_t addr, uint32_t count, const uint8_t *buf)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	int instr = mem_instruction(t, size, true);
+	if (instr < 0) {
+		LOG_ERROR("%s invalid write mem size", __func__);
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	int flush = x86_32->flush;
+	x86_32->flush = 0;
+	while (count > 0) {
+		uint32_t n = MIN(count, LMT_MEM_BATCH);
+		for (uint32_t i = 0; i < n && retval == ERROR_OK; i++) {
+			uint32_t value = 0;
+			for (uint32_t j = 0; j < size; j++)
+				value |= (uint32_t)buf[i * size + j] << (j * 8);
+
+			retval = queue_write_hw_reg(t, EAX, addr + i * size);
+			if (retval == ERROR_OK)
+				retval = queue_write_hw_reg(t, EDX, value);
+			if (retval == ERROR_OK)
+				retval = submit_instruction_pir(t, instr);
+		}
+		if (retval == ERROR_OK)
+			retval = jtag_execute_queue();
+		if (retval != ERROR_OK) {
+			LOG_ERROR("%s failed to execute queue", __func__);
+			break;
+		}
+
+		retval = transaction_status(t);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("%s error on mem write", __func__);
+			break;
+		}
+
+		addr += n * size;
+		buf += n * size;
+		count -= n;
+	}
+	x86_32->flush = flush;
+
+	return retval;
+}
+
 static bool is_paging_enabled(struct target *t)
 {
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
@@ -836,6 +1005,8 @@ int lakemont_init_arch_info(struct target *t, struct x86_32_common *x86_32)
 	x86_32->transaction_status = transaction_status;
 	x86_32->read_hw_reg = read_hw_reg;
 	x86_32->write_hw_reg = write_hw_reg;
+	x86_32->read_mem_block = read_mem_block;
+	x86_32->write_mem_block = write_mem_block;
 	x86_32->sw_bpts_supported = sw_bpts_supported;
 	x86_32->get_num_user_regs = get_num_user_regs;
 	x86_32->is_paging_enabled = is_paging_enabled;
@@ -247,6 +247,16 @@ static int mem_ap_read_memory(struct target *target, target_addr_t address,
 	return mem_ap_read_buf(mem_ap->ap, buffer, size, count, address);
 }
 
+static int mem_ap_read_memory_gather(struct target *target,
+		const struct target_memory_gather *items, unsigned int num_items)
+{
+	struct mem_ap *mem_ap = target->arch_info;
+
+	LOG_TARGET_DEBUG(target, "Reading %u scattered blocks", num_items);
+
+	return mem_ap_read_buf_gather(mem_ap->ap, items, num_items);
+}
+
 static int mem_ap_write_memory(struct target *target, target_addr_t address,
 				uint32_t size, uint32_t count,
 				const uint8_t *buffer)
@@ -285,5 +295,6 @@ struct target_type mem_ap_target = {
 	.get_gdb_reg_list = mem_ap_get_gdb_reg_list,
 
 	.read_memory = mem_ap_read_memory,
+	.read_memory_gather = mem_ap_read_memory_gather,
 	.write_memory = mem_ap_write_memory,
 };
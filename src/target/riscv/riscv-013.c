@@ -47,6 +47,7 @@ static int riscv013_on_halt(struct target *target);
 static int riscv013_on_step(struct target *target);
 static int riscv013_resume_prep(struct target *target);
 static bool riscv013_is_halted(struct target *target);
+static int riscv013_halt_summary(struct target *target, bool *halted);
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target);
 static int riscv013_write_debug_buffer(struct target *target, unsigned int index,
 		riscv_insn_t d);
@@ -57,6 +58,8 @@ static void riscv013_fill_dmi_read_u64(struct target *target, char *buf, int a);
 static int riscv013_dmi_write_u64_bits(struct target *target);
 static void riscv013_fill_dmi_nop_u64(struct target *target, char *buf);
 static int register_read(struct target *target, uint64_t *value, uint32_t number);
+static int check_halt_summary(struct target *target);
+static void invalidate_halt_summary(struct target *target);
 static int register_read_direct(struct target *target, uint64_t *value, uint32_t number);
 static int register_write_direct(struct target *target, unsigned int number,
 		uint64_t value);
@@ -64,6 +67,7 @@ static int read_memory(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment);
 static int write_memory(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer);
+static int batch_run(const struct target *target, struct riscv_batch *batch);
 
 /**
  * Since almost everything can be accomplish by scanning the dbus register, all
@@ -142,6 +146,19 @@ typedef struct {
 	/* The currently selected hartid on this DM. */
 	int current_hartid;
 	bool hasel_supported;
+	/* hawindow selects every hart in target_list. */
+	bool hawindow_all;
+
+	/* Whether haltsum0/haltsum1 can be trusted, see check_halt_summary(). */
+	yes_no_maybe_t halt_summary_supported;
+	/* Halt state of every hart, one bit per hart index, as last read by
+	 * read_halt_summary(). A hart clears its bit in halt_summary_fresh when it
+	 * uses the value, so its next poll starts a new summary. */
+	uint32_t halt_summary[RISCV_MAX_HARTS / 32];
+	uint32_t halt_summary_fresh[RISCV_MAX_HARTS / 32];
+	/* Some hart reported havereset, unavail or nonexistent in the last
+	 * summary, so every hart has to be polled individually. */
+	bool halt_summary_attention;
 
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
@@ -1722,6 +1739,9 @@ static int examine(struct target *target)
 		}
 	}
 
+	if (check_halt_summary(target) != ERROR_OK)
+		return ERROR_FAIL;
+
 	/* Without knowing anything else we can at least mess with the
 		* program buffer. */
 	r->debug_buffer_size = info->progbufsize;
@@ -1947,6 +1967,212 @@ static int cleanup_after_vector_access(struct target *target, uint64_t vtype,
 	return ERROR_OK;
 }
 
+/**
+ * Read a whole vector register with the DM autoexecuting the element loop.
+ * The program buffer moves element 0 into s0, rotates the register by one
+ * element and counts the rotations in s1. Every read of data0 fetches the
+ * previous element and starts the next iteration, so all elements come back
+ * in a single batch. If the batch is disturbed by a busy response the
+ * register is rotated back into place using the count in s1, and *done is
+ * left false so the caller can fall back to single stepping the loop.
+ */
+static int read_vector_register_batched(struct target *target, uint8_t *value,
+		unsigned int vnum, unsigned int debug_vl, bool *done)
+{
+	RISCV013_INFO(info);
+	unsigned int xlen = riscv_xlen(target);
+	int result;
+
+	*done = false;
+
+	riscv_reg_t s1;
+	if (register_read(target, &s1, GDB_REGNO_S1) != ERROR_OK)
+		return ERROR_FAIL;
+	if (register_write_direct(target, GDB_REGNO_S1, 0) != ERROR_OK)
+		return ERROR_FAIL;
+
+	struct riscv_program program;
+	riscv_program_init(&program, target);
+	riscv_program_insert(&program, vmv_x_s(S0, vnum));
+	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
+	riscv_program_addi(&program, GDB_REGNO_S1, GDB_REGNO_S1, 1);
+
+	/* s0 = element 0 */
+	result = riscv_program_exec(&program, target);
+	if (result != ERROR_OK)
+		goto restore;
+
+	if (debug_vl > 1) {
+		/* data0 = element 0, s0 = element 1 */
+		uint32_t command = access_register_command(target, GDB_REGNO_S0, xlen,
+				AC_ACCESS_REGISTER_POSTEXEC | AC_ACCESS_REGISTER_TRANSFER);
+		result = execute_abstract_command(target, command);
+		if (result != ERROR_OK)
+			goto recover;
+
+		struct riscv_batch *batch = riscv_batch_alloc(target, 2 * debug_vl + 1,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch) {
+			result = ERROR_FAIL;
+			goto recover;
+		}
+
+		dmi_write(target, DM_ABSTRACTAUTO, 1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET);
+		/* Each read of data0 triggers one more rotation. Stop triggering
+		 * once the register has been rotated all the way round; the last
+		 * element is left in s0. */
+		for (unsigned int i = 0; i < debug_vl - 1; i++) {
+			if (i == debug_vl - 2)
+				riscv_batch_add_dmi_write(batch, DM_ABSTRACTAUTO, 0);
+			if (xlen > 32)
+				riscv_batch_add_dmi_read(batch, DM_DATA1);
+			riscv_batch_add_dmi_read(batch, DM_DATA0);
+		}
+
+		result = batch_run(target, batch);
+		if (result != ERROR_OK) {
+			riscv_batch_free(batch);
+			goto recover;
+		}
+
+		uint32_t abstractcs;
+		bool dmi_busy_encountered;
+		result = dmi_op(target, &abstractcs, &dmi_busy_encountered,
+				DMI_OP_READ, DM_ABSTRACTCS, 0, false, true);
+		while (result == ERROR_OK && get_field(abstractcs, DM_ABSTRACTCS_BUSY))
+			result = dmi_read(target, &abstractcs, DM_ABSTRACTCS);
+		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+		if (result != ERROR_OK || info->cmderr != CMDERR_NONE || dmi_busy_encountered) {
+			LOG_DEBUG("Batched vector read failed, abstractcs=0x%" PRIx32, abstractcs);
+			riscv_batch_free(batch);
+			if (info->cmderr == CMDERR_BUSY || dmi_busy_encountered)
+				increase_ac_busy_delay(target);
+			result = ERROR_FAIL;
+			goto recover;
+		}
+
+		unsigned int read = 0;
+		for (unsigned int i = 0; i < debug_vl - 1; i++) {
+			uint64_t v = 0;
+			for (unsigned int j = 0; j < xlen / 32; j++, read++) {
+				if (riscv_batch_get_dmi_read_op(batch, read) != DMI_STATUS_SUCCESS) {
+					LOG_DEBUG("Batched vector read encountered DMI error.");
+					result = ERROR_FAIL;
+					break;
+				}
+				v = (v << 32) | riscv_batch_get_dmi_read_data(batch, read);
+			}
+			if (result != ERROR_OK)
+				break;
+			buf_set_u64(value, xlen * i, xlen, v);
+		}
+		riscv_batch_free(batch);
+		if (result != ERROR_OK)
+			goto recover;
+	}
+
+	uint64_t v;
+	result = register_read_direct(target, &v, GDB_REGNO_S0);
+	if (result != ERROR_OK)
+		goto restore;
+	buf_set_u64(value, xlen * (debug_vl - 1), xlen, v);
+	*done = true;
+	goto restore;
+
+recover:
+	riscv013_clear_abstract_error(target);
+	dmi_write(target, DM_ABSTRACTAUTO, 0);
+
+	/* complete the rotation so the register holds its original value */
+	uint64_t rotations;
+	if (register_read_direct(target, &rotations, GDB_REGNO_S1) != ERROR_OK ||
+			rotations > debug_vl)
+		return ERROR_FAIL;
+	for (; rotations < debug_vl; rotations++)
+		if (riscv_execute_debug_buffer(target) != ERROR_OK)
+			return ERROR_FAIL;
+	LOG_DEBUG("Falling back on element by element vector read.");
+	result = ERROR_OK;
+
+restore:
+	if (register_write_direct(target, GDB_REGNO_S1, s1) != ERROR_OK)
+		return ERROR_FAIL;
+	return result;
+}
+
+/**
+ * Write a whole vector register in one batch. The program buffer shifts s0
+ * into the top of the register and every write of data0 feeds it the next
+ * element. A busy response leaves *done false; the caller then rewrites the
+ * whole register element by element, which overwrites whatever was shifted
+ * in here.
+ */
+static int write_vector_register_batched(struct target *target, const uint8_t *value,
+		unsigned int vnum, unsigned int debug_vl, bool *done)
+{
+	RISCV013_INFO(info);
+	unsigned int xlen = riscv_xlen(target);
+
+	*done = false;
+
+	struct riscv_program program;
+	riscv_program_init(&program, target);
+	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
+	if (riscv_program_ebreak(&program) != ERROR_OK)
+		return ERROR_FAIL;
+	if (riscv_program_write(&program) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint32_t command = access_register_command(target, GDB_REGNO_S0, xlen,
+			AC_ACCESS_REGISTER_POSTEXEC | AC_ACCESS_REGISTER_TRANSFER |
+			AC_ACCESS_REGISTER_WRITE);
+	if (write_abstract_arg(target, 0, buf_get_u64(value, 0, xlen), xlen) != ERROR_OK)
+		return ERROR_FAIL;
+	int result = execute_abstract_command(target, command);
+	if (result != ERROR_OK)
+		return result;
+
+	if (debug_vl > 1) {
+		struct riscv_batch *batch = riscv_batch_alloc(target, 2 * debug_vl + 1,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch)
+			return ERROR_OK;
+
+		dmi_write(target, DM_ABSTRACTAUTO, 1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET);
+		for (unsigned int i = 1; i < debug_vl; i++) {
+			uint64_t v = buf_get_u64(value, xlen * i, xlen);
+			if (xlen > 32)
+				riscv_batch_add_dmi_write(batch, DM_DATA1, v >> 32);
+			riscv_batch_add_dmi_write(batch, DM_DATA0, v);
+		}
+		riscv_batch_add_dmi_write(batch, DM_ABSTRACTAUTO, 0);
+
+		result = batch_run(target, batch);
+		riscv_batch_free(batch);
+
+		uint32_t abstractcs = 0;
+		bool dmi_busy_encountered = false;
+		if (result == ERROR_OK)
+			result = dmi_op(target, &abstractcs, &dmi_busy_encountered,
+					DMI_OP_READ, DM_ABSTRACTCS, 0, false, true);
+		while (result == ERROR_OK && get_field(abstractcs, DM_ABSTRACTCS_BUSY))
+			result = dmi_read(target, &abstractcs, DM_ABSTRACTCS);
+		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+		if (result != ERROR_OK || info->cmderr != CMDERR_NONE || dmi_busy_encountered) {
+			LOG_DEBUG("Batched vector write failed, abstractcs=0x%" PRIx32
+					"; falling back on element by element write.", abstractcs);
+			if (info->cmderr == CMDERR_BUSY || dmi_busy_encountered)
+				increase_ac_busy_delay(target);
+			riscv013_clear_abstract_error(target);
+			dmi_write(target, DM_ABSTRACTAUTO, 0);
+			return ERROR_OK;
+		}
+	}
+
+	*done = true;
+	return ERROR_OK;
+}
+
 static int riscv013_get_register_buf(struct target *target,
 		uint8_t *value, int regno)
 {
@@ -1971,13 +2197,17 @@ static int riscv013_get_register_buf(struct target *target,
 	unsigned int vnum = regno - GDB_REGNO_V0;
 	unsigned int xlen = riscv_xlen(target);
 
+	int result = ERROR_OK;
+	bool done = false;
+	if (has_sufficient_progbuf(target, 4))
+		result = read_vector_register_batched(target, value, vnum, debug_vl, &done);
+
 	struct riscv_program program;
 	riscv_program_init(&program, target);
 	riscv_program_insert(&program, vmv_x_s(S0, vnum));
 	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
 
-	int result = ERROR_OK;
-	for (unsigned int i = 0; i < debug_vl; i++) {
+	for (unsigned int i = 0; !done && result == ERROR_OK && i < debug_vl; i++) {
 		/* Executing the program might result in an exception if there is some
 		 * issue with the vector implementation/instructions we're using. If that
 		 * happens, attempt to restore as usual. We may have clobbered the
@@ -2030,11 +2260,15 @@ static int riscv013_set_register_buf(struct target *target,
 	unsigned int vnum = regno - GDB_REGNO_V0;
 	unsigned int xlen = riscv_xlen(target);
 
+	int result = ERROR_OK;
+	bool done = false;
+	if (has_sufficient_progbuf(target, 2))
+		result = write_vector_register_batched(target, value, vnum, debug_vl, &done);
+
 	struct riscv_program program;
 	riscv_program_init(&program, target);
 	riscv_program_insert(&program, vslide1down_vx(vnum, vnum, S0, true));
-	int result = ERROR_OK;
-	for (unsigned int i = 0; i < debug_vl; i++) {
+	for (unsigned int i = 0; !done && result == ERROR_OK && i < debug_vl; i++) {
 		if (register_write_direct(target, GDB_REGNO_S0,
 					buf_get_u64(value, xlen * i, xlen)) != ERROR_OK)
 			return ERROR_FAIL;
@@ -2282,6 +2516,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->set_register_buf = &riscv013_set_register_buf;
 	generic_info->select_current_hart = &riscv013_select_current_hart;
 	generic_info->is_halted = &riscv013_is_halted;
+	generic_info->halt_summary = &riscv013_halt_summary;
 	generic_info->resume_go = &riscv013_resume_go;
 	generic_info->step_current_hart = &riscv013_step_current_hart;
 	generic_info->on_halt = &riscv013_on_halt;
@@ -2390,6 +2625,7 @@ static int deassert_reset(struct target *target)
 	RISCV_INFO(r);
 	RISCV013_INFO(info);
 	select_dmi(target);
+	invalidate_halt_summary(target);
 
 	/* Clear the reset, but make sure haltreq is still set */
 	uint32_t control = 0, control_haltreq;
@@ -4144,6 +4380,173 @@ static int riscv013_select_current_hart(struct target *target)
 	return result;
 }
 
+/* Select every hart in @dm's target list with hasel. */
+static int select_all_harts(struct target *target, dm013_info_t *dm,
+		uint32_t dmcontrol)
+{
+	if (!dm->hawindow_all) {
+		unsigned int hawindow_count = (dm->hart_count + 31) / 32;
+		uint32_t hawindow[hawindow_count];
+
+		memset(hawindow, 0, sizeof(uint32_t) * hawindow_count);
+
+		target_list_t *entry;
+		list_for_each_entry(entry, &dm->target_list, list) {
+			unsigned int index = get_info(entry->target)->index;
+			hawindow[index / 32] |= 1U << (index % 32);
+		}
+
+		for (unsigned int i = 0; i < hawindow_count; i++) {
+			if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
+				return ERROR_FAIL;
+			if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+		dm->hawindow_all = true;
+	}
+
+	dm->current_hartid = -1;
+	return dmi_write(target, DM_DMCONTROL,
+			set_hartsel(dmcontrol | DM_DMCONTROL_HASEL, 0));
+}
+
+/* Select hart @hartid without hasel, keeping the rest of @dmcontrol. */
+static int select_hart(struct target *target, dm013_info_t *dm,
+		uint32_t dmcontrol, int hartid)
+{
+	if (dm->current_hartid == hartid)
+		return ERROR_OK;
+
+	dm->current_hartid = -1;
+	if (dmi_write(target, DM_DMCONTROL, set_hartsel(dmcontrol, hartid)) != ERROR_OK)
+		return ERROR_FAIL;
+	dm->current_hartid = hartid;
+	return ERROR_OK;
+}
+
+/*
+ * Read the halt state of all harts on the DM with one haltsum0 read per 32
+ * harts, skipping the groups haltsum1 reports as all running. One dmstatus
+ * read with all harts selected through hasel also tells whether any hart
+ * reset or disappeared, which only the per-hart poll deals with.
+ */
+static int read_halt_summary(struct target *target, dm013_info_t *dm)
+{
+	unsigned int groups = (dm->hart_count + 31) / 32;
+
+	memset(dm->halt_summary_fresh, 0, sizeof(dm->halt_summary_fresh));
+
+	uint32_t dmcontrol;
+	if (dmi_read(target, &dmcontrol, DM_DMCONTROL) != ERROR_OK)
+		return ERROR_FAIL;
+	dmcontrol = set_field(dmcontrol, DM_DMCONTROL_HASEL, 0);
+
+	/* check_halt_summary() only accepts DMs with hasel */
+	if (select_all_harts(target, dm, dmcontrol) != ERROR_OK)
+		return ERROR_FAIL;
+
+	uint32_t dmstatus;
+	if (dmstatus_read(target, &dmstatus, true) != ERROR_OK)
+		return ERROR_FAIL;
+	dm->halt_summary_attention =
+		get_field(dmstatus, DM_DMSTATUS_ANYHAVERESET) ||
+		get_field(dmstatus, DM_DMSTATUS_ANYUNAVAIL) ||
+		get_field(dmstatus, DM_DMSTATUS_ANYNONEXISTENT);
+
+	/* haltsum1 covers harts 0-1023 as long as hartsel is below 1024. */
+	int hartid = dm->current_hartid >= 0 ? dm->current_hartid : 0;
+	if (select_hart(target, dm, dmcontrol, hartid) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (!dm->halt_summary_attention) {
+		uint32_t haltsum1 = 1;
+		if (groups > 1 && dmi_read(target, &haltsum1, DM_HALTSUM1) != ERROR_OK)
+			return ERROR_FAIL;
+
+		for (unsigned int i = 0; i < groups; i++) {
+			dm->halt_summary[i] = 0;
+			if (!(haltsum1 & (1U << i)))
+				continue;
+			/* haltsum0 covers the 32 harts around hartsel. */
+			if (dm->current_hartid / 32 != (int)i &&
+					select_hart(target, dm, dmcontrol, i * 32) != ERROR_OK)
+				return ERROR_FAIL;
+			if (dmi_read(target, &dm->halt_summary[i], DM_HALTSUM0) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+	}
+
+	for (unsigned int i = 0; i < groups; i++)
+		dm->halt_summary_fresh[i] = 0xffffffff;
+
+	return ERROR_OK;
+}
+
+/* The halt summary registers are optional on small DMs, so they are only
+ * trusted once they correctly reported harts we know to be halted. Called
+ * with the current hart selected and halted.
+ * Without hasel there is no single dmstatus read that shows a running hart
+ * was reset or became unavailable, and haltsum alone would hide that from
+ * the per-hart poll, so such DMs don't use the summary at all. */
+static int check_halt_summary(struct target *target)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+	if (!dm->hasel_supported)
+		dm->halt_summary_supported = YNM_NO;
+	if (dm->halt_summary_supported == YNM_NO || dm->hart_count < 2)
+		return ERROR_OK;
+
+	uint32_t haltsum0, haltsum1 = 1;
+	if (dmi_read(target, &haltsum0, DM_HALTSUM0) != ERROR_OK)
+		return ERROR_FAIL;
+	if (dm->hart_count > 32 && dmi_read(target, &haltsum1, DM_HALTSUM1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if ((haltsum0 & (1U << (info->index % 32))) &&
+			(haltsum1 & (1U << (info->index / 32)))) {
+		if (dm->halt_summary_supported == YNM_MAYBE)
+			dm->halt_summary_supported = YNM_YES;
+	} else {
+		LOG_DEBUG("haltsum0=0x%x haltsum1=0x%x miss halted hart %d, not using "
+				"halt summaries", haltsum0, haltsum1, info->index);
+		dm->halt_summary_supported = YNM_NO;
+	}
+	return ERROR_OK;
+}
+
+static void invalidate_halt_summary(struct target *target)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (dm)
+		memset(dm->halt_summary_fresh, 0, sizeof(dm->halt_summary_fresh));
+}
+
+static int riscv013_halt_summary(struct target *target, bool *halted)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+	if (dm->halt_summary_supported != YNM_YES)
+		return ERROR_NOT_IMPLEMENTED;
+
+	unsigned int i = info->index / 32;
+	uint32_t bit = 1U << (info->index % 32);
+	if (!(dm->halt_summary_fresh[i] & bit) &&
+			read_halt_summary(target, dm) != ERROR_OK)
+		return ERROR_FAIL;
+	dm->halt_summary_fresh[i] &= ~bit;
+
+	if (dm->halt_summary_attention)
+		return ERROR_NOT_IMPLEMENTED;
+
+	*halted = dm->halt_summary[i] & bit;
+	return ERROR_OK;
+}
+
 /* Select all harts that were prepped and that are selectable, clearing the
  * prepped flag on the harts that actually were selected. */
 static int select_prepped_harts(struct target *target, bool *use_hasel)
@@ -4187,6 +4590,7 @@ static int select_prepped_harts(struct target *target, bool *use_hasel)
 		return ERROR_OK;
 	}
 
+	dm->hawindow_all = false;
 	for (unsigned int i = 0; i < hawindow_count; i++) {
 		if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
 			return ERROR_FAIL;
@@ -4211,6 +4615,7 @@ static int riscv013_halt_go(struct target *target)
 
 	RISCV_INFO(r);
 	LOG_DEBUG("halting hart %d", r->current_hartid);
+	invalidate_halt_summary(target);
 
 	/* Issue the halt command, and then wait for the current hart to halt. */
 	uint32_t dmcontrol = DM_DMCONTROL_DMACTIVE | DM_DMCONTROL_HALTREQ;
@@ -4442,6 +4847,7 @@ static int riscv013_step_or_resume_current_hart(struct target *target,
 		LOG_ERROR("Hart %d is not halted!", r->current_hartid);
 		return ERROR_FAIL;
 	}
+	invalidate_halt_summary(target);
 
 	/* Issue the resume command, and then wait for the current hart to resume. */
 	uint32_t dmcontrol = DM_DMCONTROL_DMACTIVE | DM_DMCONTROL_RESUMEREQ;
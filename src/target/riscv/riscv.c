@@ -2083,6 +2083,14 @@ enum riscv_poll_hart {
 static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid)
 {
 	RISCV_INFO(r);
+
+	/* Only select the hart if the halt summary says its state changed. */
+	bool summary_halted;
+	if (r->halt_summary && r->halt_summary(target, &summary_halted) == ERROR_OK &&
+			(summary_halted ? target->state == TARGET_HALTED :
+			 target->state == TARGET_RUNNING))
+		return RPH_NO_CHANGE;
+
 	if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
 		return RPH_ERROR;
 
@@ -146,6 +146,10 @@ struct riscv_info {
 			const uint8_t *buf);
 	int (*select_current_hart)(struct target *target);
 	bool (*is_halted)(struct target *target);
+	/* Optional; tells whether this hart is halted from a summary that is read
+	 * once per poll cycle for all harts on the same Debug Module. Returns
+	 * ERROR_NOT_IMPLEMENTED if the hart has to be polled on its own. */
+	int (*halt_summary)(struct target *target, bool *halted);
 	/* Resume this target, as well as every other prepped target that can be
 	 * resumed near-simultaneously. Clear the prepped flag on any target that
 	 * was resumed. */
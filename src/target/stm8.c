@@ -11,6 +11,7 @@
 #endif
 
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include "target.h"
 #include "target_type.h"
 #include "hello.h"
@@ -132,6 +133,24 @@ static const struct {
 
 #define SWIM_CSR 0x7f80
 
+/* parameter block of contrib/loaders/flash/stm8/stm8_flash_write.s */
+#define STM8_LOADER_IAPSR 0
+#define STM8_LOADER_CR2 2
+#define STM8_LOADER_NCR2 4
+#define STM8_LOADER_CR2_VAL 6
+#define STM8_LOADER_NCR2_VAL 7
+#define STM8_LOADER_BLOCK_SIZE 8
+#define STM8_LOADER_DEST 9
+#define STM8_LOADER_BUF0 12
+#define STM8_LOADER_BUF1 14
+#define STM8_LOADER_WP 16
+#define STM8_LOADER_RP 17
+#define STM8_LOADER_DONE 18
+#define STM8_LOADER_STATUS 19
+#define STM8_LOADER_ENTRY 20
+/* operand of the ldf instruction pointing at STM8_LOADER_DEST */
+#define STM8_LOADER_DEST_PTR 0x3e
+
 #define STM8_BREAK 0x8B
 
 enum mem_type {
@@ -143,6 +162,8 @@ enum mem_type {
 
 struct stm8_algorithm {
 	int common_magic;
+	/* core registers saved by stm8_start_algorithm() */
+	uint32_t context[STM8_NUM_REGS];
 };
 
 struct stm8_core_reg {
@@ -644,6 +665,133 @@ static int stm8_unlock_eeprom(struct target *target)
 	return ERROR_OK;
 }
 
+/*
+ * Program nblocks whole blocks with the RAM loader. The loader does the
+ * block programming and EOP polling on the core, OpenOCD only streams the
+ * data into the half of the double buffer that is not being programmed.
+ */
+static int stm8_write_flash_blocks(struct target *target, uint8_t cr2,
+		uint32_t address, uint32_t blocksize, uint32_t nblocks,
+		const uint8_t *buffer)
+{
+	struct stm8_common *stm8 = target_to_stm8(target);
+	struct working_area *loader;
+	struct reg_param reg_params[1];
+	struct stm8_algorithm stm8_info;
+	uint32_t buf_addr[2];
+	uint32_t written, programmed = 0;
+	uint32_t exit_point;
+	uint8_t state[3] = { 0 };
+	int retval, retval2;
+
+	static const uint8_t stm8_flash_write_code[] = {
+#include "../../contrib/loaders/flash/stm8/stm8_flash_write.inc"
+	};
+	uint8_t code[sizeof(stm8_flash_write_code)];
+
+	if (blocksize > 0xff)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	if (target_alloc_working_area(target, sizeof(code) + 2 * blocksize,
+			&loader) != ERROR_OK)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	buf_addr[0] = loader->address + sizeof(code);
+	buf_addr[1] = buf_addr[0] + blocksize;
+	written = MIN(nblocks, 2);
+
+	memcpy(code, stm8_flash_write_code, sizeof(code));
+	h_u16_to_be(code + STM8_LOADER_IAPSR, stm8->flash_iapsr);
+	h_u16_to_be(code + STM8_LOADER_CR2, stm8->flash_cr2);
+	h_u16_to_be(code + STM8_LOADER_NCR2, stm8->flash_ncr2);
+	code[STM8_LOADER_CR2_VAL] = cr2;
+	code[STM8_LOADER_NCR2_VAL] = ~cr2;
+	code[STM8_LOADER_BLOCK_SIZE] = blocksize;
+	h_u24_to_be(code + STM8_LOADER_DEST, address);
+	h_u16_to_be(code + STM8_LOADER_BUF0, buf_addr[0]);
+	h_u16_to_be(code + STM8_LOADER_BUF1, buf_addr[1]);
+	code[STM8_LOADER_WP] = written;
+	h_u16_to_be(code + STM8_LOADER_DEST_PTR, loader->address + STM8_LOADER_DEST);
+	exit_point = loader->address + sizeof(code) - 1;
+
+	/* the first two blocks go in with the loader */
+	retval = stm8_adapter_write_memory(target, loader->address, 1,
+			sizeof(code), code);
+	if (retval == ERROR_OK)
+		retval = stm8_adapter_write_memory(target, buf_addr[0], 1,
+				written * blocksize, buffer);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, loader);
+		return retval;
+	}
+
+	stm8_info.common_magic = STM8_COMMON_MAGIC;
+
+	init_reg_param(&reg_params[0], "sp", 32, PARAM_OUT);
+	buf_set_u32(reg_params[0].value, 0, 32, loader->address);
+
+	retval = target_start_algorithm(target, 0, NULL, 1, reg_params,
+			loader->address + STM8_LOADER_ENTRY, exit_point, &stm8_info);
+	if (retval != ERROR_OK) {
+		destroy_reg_param(&reg_params[0]);
+		target_free_working_area(target, loader);
+		return retval;
+	}
+
+	int64_t then = timeval_ms();
+	while (programmed < nblocks) {
+		/* rp, done and status */
+		retval = stm8_adapter_read_memory(target,
+				loader->address + STM8_LOADER_RP, 1, 3, state);
+		if (retval != ERROR_OK || state[2])
+			break;
+
+		if ((uint8_t)programmed != state[0]) {
+			programmed += (uint8_t)(state[0] - programmed);
+			then = timeval_ms();
+		}
+
+		/* refill the half of the buffer the loader is done with */
+		if (written < nblocks && written - programmed < 2) {
+			retval = stm8_adapter_write_memory(target, buf_addr[written & 1],
+					1, blocksize, buffer + written * blocksize);
+			if (retval == ERROR_OK)
+				retval = stm8_write_u8(target,
+						loader->address + STM8_LOADER_WP, ++written);
+			if (retval != ERROR_OK)
+				break;
+			continue;
+		}
+
+		if (timeval_ms() - then > 1000) {
+			LOG_ERROR("timeout waiting for the flash loader, %" PRIu32
+					" of %" PRIu32 " blocks written", programmed, nblocks);
+			retval = ERROR_FAIL;
+			break;
+		}
+		keep_alive();
+	}
+
+	/* let the loader stop at its breakpoint */
+	retval2 = stm8_write_u8(target, loader->address + STM8_LOADER_DONE, 1);
+	if (retval2 == ERROR_OK)
+		retval2 = target_wait_algorithm(target, 0, NULL, 1, reg_params,
+				exit_point, 1000, &stm8_info);
+	if (retval == ERROR_OK)
+		retval = retval2;
+
+	if (retval == ERROR_OK && state[2]) {
+		LOG_ERROR("flash block at 0x%" PRIx32 " is write protected, IAPSR = 0x%02" PRIx8,
+				address + programmed * blocksize, state[2]);
+		retval = ERROR_FAIL;
+	}
+
+	destroy_reg_param(&reg_params[0]);
+	target_free_working_area(target, loader);
+
+	return retval;
+}
+
 static int stm8_write_flash(struct target *target, enum mem_type type,
 		uint32_t address,
 		uint32_t size, uint32_t count, uint32_t blocksize_param,
@@ -656,6 +804,7 @@ static int stm8_write_flash(struct target *target, enum mem_type type,
 	unsigned int i;
 	uint32_t blocksize = 0;
 	uint32_t bytecnt;
+	bool no_loader = false;
 	int res;
 
 	switch (type) {
@@ -683,6 +832,26 @@ static int stm8_write_flash(struct target *target, enum mem_type type,
 	bytecnt = count * size;
 
 	while (bytecnt) {
+		if ((bytecnt >= blocksize_param) && ((address & (blocksize_param-1)) == 0)
+				&& bytecnt >= 2 * blocksize_param && !no_loader && type != OPTION) {
+			/* option bytes can't be block programmed, they keep using SWIM */
+			uint32_t nblocks = bytecnt / blocksize_param;
+
+			res = stm8_write_flash_blocks(target, PRG, address,
+					blocksize_param, nblocks, buffer);
+			if (res == ERROR_OK) {
+				address += nblocks * blocksize_param;
+				buffer += nblocks * blocksize_param;
+				bytecnt -= nblocks * blocksize_param;
+				/* the loader leaves FLASH_CR2 cleared */
+				blocksize = 0;
+				continue;
+			}
+			if (res != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+				return res;
+			LOG_WARNING("no working area available, can't use the flash loader");
+			no_loader = true;
+		}
 		if ((bytecnt >= blocksize_param) && ((address & (blocksize_param-1)) == 0)) {
 			if (stm8->flash_cr2)
 				stm8_write_u8(target, stm8->flash_cr2, PRG + opt);
@@ -1780,48 +1949,13 @@ static int stm8_checksum_memory(struct target *target, target_addr_t address,
 	return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 }
 
-/* run to exit point. return error if exit point was not reached. */
-static int stm8_run_and_wait(struct target *target, uint32_t entry_point,
-		unsigned int timeout_ms, uint32_t exit_point, struct stm8_common *stm8)
-{
-	uint32_t pc;
-	int retval;
-	/* This code relies on the target specific resume() and
-	   poll()->debug_entry() sequence to write register values to the
-	   processor and the read them back */
-	retval = target_resume(target, false, entry_point, false, true);
-	if (retval != ERROR_OK)
-		return retval;
-
-	retval = target_wait_state(target, TARGET_HALTED, timeout_ms);
-	/* If the target fails to halt due to the breakpoint, force a halt */
-	if (retval != ERROR_OK || target->state != TARGET_HALTED) {
-		retval = target_halt(target);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_wait_state(target, TARGET_HALTED, 500);
-		if (retval != ERROR_OK)
-			return retval;
-		return ERROR_TARGET_TIMEOUT;
-	}
-
-	pc = buf_get_u32(stm8->core_cache->reg_list[STM8_PC].value, 0, 32);
-	if (exit_point && (pc != exit_point)) {
-		LOG_DEBUG("failed algorithm halted at 0x%" PRIx32 " ", pc);
-		return ERROR_TARGET_TIMEOUT;
-	}
-
-	return ERROR_OK;
-}
-
-static int stm8_run_algorithm(struct target *target, int num_mem_params,
+static int stm8_start_algorithm(struct target *target, int num_mem_params,
 		struct mem_param *mem_params, int num_reg_params,
 		struct reg_param *reg_params, target_addr_t entry_point,
-		target_addr_t exit_point, unsigned int timeout_ms, void *arch_info)
+		target_addr_t exit_point, void *arch_info)
 {
 	struct stm8_common *stm8 = target_to_stm8(target);
-
-	uint32_t context[STM8_NUM_REGS];
+	struct stm8_algorithm *stm8_algorithm_info = arch_info;
 	int retval = ERROR_OK;
 
 	LOG_DEBUG("Running algorithm");
@@ -1844,7 +1978,8 @@ static int stm8_run_algorithm(struct target *target, int num_mem_params,
 	for (unsigned int i = 0; i < STM8_NUM_REGS; i++) {
 		if (!stm8->core_cache->reg_list[i].valid)
 			stm8->read_core_reg(target, i);
-		context[i] = buf_get_u32(stm8->core_cache->reg_list[i].value, 0, 32);
+		stm8_algorithm_info->context[i] =
+			buf_get_u32(stm8->core_cache->reg_list[i].value, 0, 32);
 	}
 
 	for (int i = 0; i < num_mem_params; i++) {
@@ -1877,11 +2012,41 @@ static int stm8_run_algorithm(struct target *target, int num_mem_params,
 		stm8_set_core_reg(reg, reg_params[i].value);
 	}
 
-	retval = stm8_run_and_wait(target, entry_point,
-			timeout_ms, exit_point, stm8);
+	/* This code relies on the target specific resume() and
+	   poll()->debug_entry() sequence to write register values to the
+	   processor and the read them back */
+	return target_resume(target, false, entry_point, false, true);
+}
 
-	if (retval != ERROR_OK)
-		return retval;
+/* wait for the exit point. return error if exit point was not reached. */
+static int stm8_wait_algorithm(struct target *target,
+		int num_mem_params, struct mem_param *mem_params,
+		int num_reg_params, struct reg_param *reg_params,
+		target_addr_t exit_point, unsigned int timeout_ms,
+		void *arch_info)
+{
+	struct stm8_common *stm8 = target_to_stm8(target);
+	struct stm8_algorithm *stm8_algorithm_info = arch_info;
+	uint32_t pc;
+	int retval;
+
+	retval = target_wait_state(target, TARGET_HALTED, timeout_ms);
+	/* If the target fails to halt due to the breakpoint, force a halt */
+	if (retval != ERROR_OK || target->state != TARGET_HALTED) {
+		retval = target_halt(target);
+		if (retval != ERROR_OK)
+			return retval;
+		retval = target_wait_state(target, TARGET_HALTED, 500);
+		if (retval != ERROR_OK)
+			return retval;
+		return ERROR_TARGET_TIMEOUT;
+	}
+
+	pc = buf_get_u32(stm8->core_cache->reg_list[STM8_PC].value, 0, 32);
+	if (exit_point && (pc != exit_point)) {
+		LOG_DEBUG("failed algorithm halted at 0x%" PRIx32 " ", pc);
+		return ERROR_TARGET_TIMEOUT;
+	}
 
 	for (int i = 0; i < num_mem_params; i++) {
 		if (mem_params[i].direction != PARAM_OUT) {
@@ -1917,11 +2082,12 @@ static int stm8_run_algorithm(struct target *target, int num_mem_params,
 	for (unsigned int i = 0; i < STM8_NUM_REGS; i++) {
 		uint32_t regvalue;
 		regvalue = buf_get_u32(stm8->core_cache->reg_list[i].value, 0, 32);
-		if (regvalue != context[i]) {
+		if (regvalue != stm8_algorithm_info->context[i]) {
 			LOG_DEBUG("restoring register %s with value 0x%8.8" PRIx32,
-				stm8->core_cache->reg_list[i].name, context[i]);
+				stm8->core_cache->reg_list[i].name,
+				stm8_algorithm_info->context[i]);
 			buf_set_u32(stm8->core_cache->reg_list[i].value,
-					0, 32, context[i]);
+					0, 32, stm8_algorithm_info->context[i]);
 			stm8->core_cache->reg_list[i].valid = true;
 			stm8->core_cache->reg_list[i].dirty = true;
 		}
@@ -1930,6 +2096,22 @@ static int stm8_run_algorithm(struct target *target, int num_mem_params,
 	return ERROR_OK;
 }
 
+static int stm8_run_algorithm(struct target *target, int num_mem_params,
+		struct mem_param *mem_params, int num_reg_params,
+		struct reg_param *reg_params, target_addr_t entry_point,
+		target_addr_t exit_point, unsigned int timeout_ms, void *arch_info)
+{
+	int retval;
+
+	retval = stm8_start_algorithm(target, num_mem_params, mem_params,
+			num_reg_params, reg_params, entry_point, exit_point, arch_info);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return stm8_wait_algorithm(target, num_mem_params, mem_params,
+			num_reg_params, reg_params, exit_point, timeout_ms, arch_info);
+}
+
 static int stm8_jim_configure(struct target *target, struct jim_getopt_info *goi)
 {
 	struct stm8_common *stm8 = target_to_stm8(target);
@@ -2177,6 +2359,8 @@ struct target_type stm8_target = {
 	.blank_check_memory = stm8_blank_check_memory,
 
 	.run_algorithm = stm8_run_algorithm,
+	.start_algorithm = stm8_start_algorithm,
+	.wait_algorithm = stm8_wait_algorithm,
 
 	.add_breakpoint = stm8_add_breakpoint,
 	.remove_breakpoint = stm8_remove_breakpoint,
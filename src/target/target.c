@@ -1249,6 +1249,27 @@ int target_read_memory(struct target *target,
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
+int target_read_memory_gather(struct target *target,
+		const struct target_memory_gather *items, unsigned int num_items)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (target->type->read_memory_gather)
+		return target->type->read_memory_gather(target, items, num_items);
+
+	int first_err = ERROR_OK;
+	for (unsigned int i = 0; i < num_items; i++) {
+		int retval = target_read_memory(target, items[i].address,
+				items[i].size, items[i].count, items[i].buffer);
+		if (first_err == ERROR_OK)
+			first_err = retval;
+	}
+	return first_err;
+}
+
 int target_read_phys_memory(struct target *target,
 		target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer)
 {
@@ -2524,6 +2545,88 @@ int target_blank_check_memory(struct target *target,
 	return target->type->blank_check_memory(target, blocks, num_blocks, erased_value);
 }
 
+int target_survey_memory(struct target *target,
+	struct target_memory_survey_block *blocks, int num_blocks,
+	uint8_t erased_value)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (!target->type->survey_memory)
+		return ERROR_NOT_IMPLEMENTED;
+
+	return target->type->survey_memory(target, blocks, num_blocks, erased_value);
+}
+
+/* size of the blocks read from the target by target_search_memory() */
+#define TARGET_SEARCH_CHUNK		0x10000
+
+int target_search_memory(struct target *target, target_addr_t address, uint32_t size,
+	const uint8_t *pattern, uint32_t pattern_len, bool *found, target_addr_t *match)
+{
+	*found = false;
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (pattern_len == 0 || pattern_len > size) {
+		*found = pattern_len == 0;
+		*match = address;
+		return ERROR_OK;
+	}
+
+	/* the tail of the previous chunk is kept in front of the next one,
+	 * so that matches straddling a chunk boundary are found */
+	uint32_t keep_max = pattern_len - 1;
+	uint8_t *buffer = malloc(TARGET_SEARCH_CHUNK + keep_max);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	target_addr_t base = address;
+	uint32_t kept = 0;
+	int retval = ERROR_OK;
+
+	while (size > 0) {
+		uint32_t count = MIN(size, TARGET_SEARCH_CHUNK);
+		retval = target_read_buffer(target, address, count, buffer + kept);
+		if (retval != ERROR_OK)
+			break;
+
+		uint32_t avail = kept + count;
+		if (avail >= pattern_len) {
+			const uint8_t *p = buffer;
+			const uint8_t *end = buffer + avail - pattern_len + 1;
+			while ((p = memchr(p, pattern[0], end - p))) {
+				if (!memcmp(p + 1, pattern + 1, pattern_len - 1)) {
+					*found = true;
+					*match = base + (p - buffer);
+					break;
+				}
+				p++;
+			}
+			if (*found)
+				break;
+		}
+
+		kept = MIN(avail, keep_max);
+		memmove(buffer, buffer + avail - kept, kept);
+		base += avail - kept;
+		address += count;
+		size -= count;
+
+		keep_alive();
+	}
+
+	free(buffer);
+	return retval;
+}
+
 int target_read_u64(struct target *target, target_addr_t address, uint64_t *value)
 {
 	uint8_t value_buf[8];
@@ -3761,6 +3864,37 @@ enum verify_mode {
 	IMAGE_CHECKSUM_ONLY = 2
 };
 
+/*
+ * Compute the CRC of all image sections with as few algorithm runs as the
+ * target allows. Returns NULL if the target has no survey algorithm, in
+ * which case sections are checksummed one by one.
+ */
+static struct target_memory_survey_block *target_survey_image(struct target *target,
+		struct image *image)
+{
+	struct target_memory_survey_block *blocks;
+
+	blocks = calloc(image->num_sections, sizeof(*blocks));
+	if (!blocks)
+		return NULL;
+
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		blocks[i].address = image->sections[i].base_address;
+		blocks[i].size = image->sections[i].size;
+	}
+
+	for (unsigned int i = 0; i < image->num_sections; ) {
+		int retval = target_survey_memory(target, blocks + i, image->num_sections - i, 0xff);
+		if (retval < 1) {
+			free(blocks);
+			return NULL;
+		}
+		i += retval;
+	}
+
+	return blocks;
+}
+
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
 	uint8_t *buffer;
@@ -3801,6 +3935,10 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	if (retval != ERROR_OK)
 		return retval;
 
+	struct target_memory_survey_block *survey = NULL;
+	if (verify >= IMAGE_VERIFY)
+		survey = target_survey_image(target, &image);
+
 	image_size = 0x0;
 	int diffs = 0;
 	retval = ERROR_OK;
@@ -3826,10 +3964,15 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 				break;
 			}
 
-			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
-				break;
+			if (survey && survey[i].size == buf_cnt) {
+				mem_checksum = survey[i].crc;
+			} else {
+				retval = target_checksum_memory(target, image.sections[i].base_address,
+						buf_cnt, &mem_checksum);
+				if (retval != ERROR_OK) {
+					free(buffer);
+					break;
+				}
 			}
 			if ((checksum != mem_checksum) && (verify == IMAGE_CHECKSUM_ONLY)) {
 				LOG_ERROR("checksum mismatch");
@@ -3895,6 +4038,7 @@ done:
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
 	}
 
+	free(survey);
 	image_close(&image);
 
 	return retval;
@@ -6512,6 +6656,289 @@ nextw:
 	return retval;
 }
 
+/* transfer sizes swept by "bench mem" */
+static const uint32_t bench_mem_sizes[] = { 4, 64, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024 };
+
+/* repeat each transfer until this many bytes moved, within the limits below */
+#define BENCH_MEM_TARGET_BYTES	(256 * 1024)
+#define BENCH_MEM_MIN_REPS		3
+#define BENCH_MEM_MAX_REPS		64
+
+/* a baseline entry slower than this fraction of the stored figure is a regression */
+#define BENCH_MEM_REGRESSION	0.9
+
+struct bench_mem_result {
+	char key[48];
+	float kbps;
+};
+
+static int bench_mem_compare_float(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int bench_mem_run(struct command_invocation *cmd, struct target *target, bool write,
+		bool phys, target_addr_t address, uint32_t width, uint32_t align, uint32_t size,
+		uint8_t *buffer, struct bench_mem_result *result)
+{
+	uint32_t count = size / width;
+	unsigned int reps = BENCH_MEM_TARGET_BYTES / size;
+	float latency[BENCH_MEM_MAX_REPS];
+	float total = 0;
+	int retval;
+
+	reps = MAX(reps, BENCH_MEM_MIN_REPS);
+	reps = MIN(reps, BENCH_MEM_MAX_REPS);
+
+	snprintf(result->key, sizeof(result->key), "%s%s/w%" PRIu32 "/a%" PRIu32 "/%" PRIu32,
+			phys ? "phys_" : "", write ? "write" : "read", width, align, size);
+
+	unsigned int flushes = jtag_get_flush_queue_count();
+
+	for (unsigned int i = 0; i < reps; i++) {
+		struct duration bench;
+
+		duration_start(&bench);
+		if (write && phys)
+			retval = target_write_phys_memory(target, address + align, width, count, buffer);
+		else if (write)
+			retval = target_write_memory(target, address + align, width, count, buffer);
+		else if (phys)
+			retval = target_read_phys_memory(target, address + align, width, count, buffer);
+		else
+			retval = target_read_memory(target, address + align, width, count, buffer);
+		duration_measure(&bench);
+
+		if (retval == ERROR_TARGET_UNALIGNED_ACCESS ||
+				retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+			command_print_sameline(cmd, "%-24s unsupported %s", result->key,
+					(retval == ERROR_TARGET_UNALIGNED_ACCESS) ? "alignment" : "width");
+			return retval;
+		}
+		if (retval != ERROR_OK) {
+			command_print(cmd, "%-24s failed", result->key);
+			return retval;
+		}
+
+		latency[i] = duration_elapsed(&bench);
+		total += latency[i];
+
+		keep_alive();
+		if (openocd_is_shutdown_pending())
+			return ERROR_SERVER_INTERRUPTED;
+	}
+
+	flushes = jtag_get_flush_queue_count() - flushes;
+
+	qsort(latency, reps, sizeof(latency[0]), bench_mem_compare_float);
+
+	result->kbps = total > 0 ? (size / 1024.0) * reps / total : 0;
+
+	command_print_sameline(cmd, "%-24s %10.1f KiB/s  p50 %9.1f us  p90 %9.1f us  p99 %9.1f us",
+			result->key, result->kbps, latency[reps / 2] * 1e6, latency[reps * 9 / 10] * 1e6,
+			latency[reps * 99 / 100] * 1e6);
+
+	/* other transports don't go through the JTAG queue */
+	if (transport_is_jtag())
+		command_print_sameline(cmd, "  %6.1f flushes", (float)flushes / reps);
+	else
+		command_print_sameline(cmd, "  %6s flushes", "n/a");
+
+	return ERROR_OK;
+}
+
+static int bench_mem_load_baseline(const char *filename, struct bench_mem_result **baseline,
+		unsigned int *num)
+{
+	char line[128];
+	struct bench_mem_result entry;
+
+	FILE *f = fopen(filename, "r");
+	if (!f) {
+		LOG_ERROR("cannot open baseline file %s", filename);
+		return ERROR_FAIL;
+	}
+
+	*baseline = NULL;
+	*num = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%47s %f", entry.key, &entry.kbps) != 2)
+			continue;
+
+		struct bench_mem_result *tmp = realloc(*baseline, (*num + 1) * sizeof(entry));
+		if (!tmp) {
+			LOG_ERROR("Out of memory");
+			fclose(f);
+			return ERROR_FAIL;
+		}
+		*baseline = tmp;
+		(*baseline)[(*num)++] = entry;
+	}
+
+	fclose(f);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_bench_mem_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct working_area *wa = NULL;
+	struct bench_mem_result *results = NULL, *baseline = NULL;
+	unsigned int num_results = 0, num_baseline = 0, regressions = 0;
+	const char *save_file = NULL, *compare_file = NULL;
+	target_addr_t address = 0;
+	uint32_t region_size = 0, buffer_size;
+	bool phys = false, have_region = false;
+	uint8_t *buffer = NULL;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < CMD_ARGC; i++) {
+		if (!strcmp(CMD_ARGV[i], "phys")) {
+			phys = true;
+		} else if (!strcmp(CMD_ARGV[i], "save") && i + 1 < CMD_ARGC) {
+			save_file = CMD_ARGV[++i];
+		} else if (!strcmp(CMD_ARGV[i], "compare") && i + 1 < CMD_ARGC) {
+			compare_file = CMD_ARGV[++i];
+		} else if (!have_region && i + 1 < CMD_ARGC) {
+			COMMAND_PARSE_ADDRESS(CMD_ARGV[i], address);
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[++i], region_size);
+			have_region = true;
+		} else {
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+	}
+
+	if (target->state != TARGET_HALTED) {
+		command_print(CMD, "Error: [%s] not halted", target_name(target));
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if (compare_file) {
+		retval = bench_mem_load_baseline(compare_file, &baseline, &num_baseline);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (!have_region) {
+		if (phys) {
+			command_print(CMD, "physical accesses need an explicit address and size");
+			retval = ERROR_COMMAND_ARGUMENT_INVALID;
+			goto out;
+		}
+
+		/* without an explicit region, only the working area is safe to overwrite */
+		region_size = target_get_working_area_avail(target);
+		retval = target_alloc_working_area(target, region_size, &wa);
+		if (retval != ERROR_OK) {
+			command_print(CMD, "Not enough working area, specify an address and size");
+			goto out;
+		}
+		address = wa->address;
+	}
+
+	/* the largest transfer plus the unaligned offset */
+	buffer_size = MIN(region_size, bench_mem_sizes[ARRAY_SIZE(bench_mem_sizes) - 1] + 1);
+
+	buffer = malloc(buffer_size);
+	results = calloc(ARRAY_SIZE(bench_mem_sizes) * 2 * 4 * 2, sizeof(*results));
+	if (!buffer || !results) {
+		command_print(CMD, "Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	for (uint32_t i = 0; i < buffer_size; i++)
+		buffer[i] = rand();
+
+	for (int write = 0; write <= 1; write++) {
+		for (uint32_t width = 1; width <= 8; width *= 2) {
+			for (uint32_t align = 0; align < 2 && align < width; align++) {
+				for (unsigned int s = 0; s < ARRAY_SIZE(bench_mem_sizes); s++) {
+					uint32_t size = bench_mem_sizes[s];
+
+					if (size < width || size + align > region_size)
+						continue;
+
+					struct bench_mem_result *result = &results[num_results];
+					retval = bench_mem_run(CMD, target, write, phys, address, width, align,
+							size, buffer, result);
+					if (retval == ERROR_TARGET_UNALIGNED_ACCESS ||
+							retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+						/* an unsupported width or alignment skips its remaining sizes */
+						command_print(CMD, "%s", "");
+						retval = ERROR_OK;
+						break;
+					}
+					if (retval != ERROR_OK)
+						goto out;
+					num_results++;
+
+					const struct bench_mem_result *ref = NULL;
+					for (unsigned int b = 0; b < num_baseline; b++) {
+						if (!strcmp(baseline[b].key, result->key)) {
+							ref = &baseline[b];
+							break;
+						}
+					}
+
+					if (ref && ref->kbps > 0) {
+						bool regression = result->kbps < ref->kbps * BENCH_MEM_REGRESSION;
+						regressions += regression;
+						command_print(CMD, "  (baseline %.1f KiB/s, %+.1f%%%s)", ref->kbps,
+								(result->kbps / ref->kbps - 1) * 100,
+								regression ? ", REGRESSION" : "");
+					} else {
+						command_print(CMD, "%s", "");
+					}
+				}
+			}
+		}
+	}
+
+	if (save_file) {
+		FILE *f = fopen(save_file, "w");
+		if (!f) {
+			command_print(CMD, "cannot write baseline file %s", save_file);
+			retval = ERROR_FAIL;
+			goto out;
+		}
+		for (unsigned int i = 0; i < num_results; i++)
+			fprintf(f, "%s %.1f\n", results[i].key, results[i].kbps);
+		fclose(f);
+	}
+
+	if (compare_file) {
+		command_print(CMD, "%u regressions against %s", regressions, compare_file);
+		if (regressions)
+			retval = ERROR_FAIL;
+	}
+
+out:
+	free(baseline);
+	free(results);
+	free(buffer);
+	if (wa)
+		target_free_working_area(target, wa);
+
+	return retval;
+}
+
+static const struct command_registration bench_command_handlers[] = {
+	{
+		.name = "mem",
+		.handler = handle_bench_mem_command,
+		.mode = COMMAND_EXEC,
+		.help = "measure memory access throughput and latency over access widths, "
+			"alignments and transfer sizes",
+		.usage = "['phys'] [address size] ['save' filename] ['compare' filename]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration target_exec_command_handlers[] = {
 	{
 		.name = "fast_load_image",
@@ -6777,6 +7204,13 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.help = "Test the target's memory access functions",
 		.usage = "size",
 	},
+	{
+		.name = "bench",
+		.mode = COMMAND_EXEC,
+		.help = "performance measurement commands",
+		.usage = "",
+		.chain = bench_command_handlers,
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
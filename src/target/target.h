@@ -343,6 +343,25 @@ struct target_memory_check_block {
 	uint32_t result;
 };
 
+/* CRC and erase state of a region, see target_survey_memory() */
+struct target_memory_survey_block {
+	target_addr_t address;
+	uint32_t size;
+	uint32_t crc;
+	/* offset of the first non-erased byte, equal to size if erased */
+	uint32_t blank_offset;
+};
+
+/* One block of a scattered read, see target_read_memory_gather() */
+struct target_memory_gather {
+	target_addr_t address;
+	/* access size in bytes and number of accesses, as target_read_memory() */
+	uint32_t size;
+	uint32_t count;
+	/* receives size * count bytes in target byte order */
+	uint8_t *buffer;
+};
+
 int target_register_commands(struct command_context *cmd_ctx);
 int target_examine(void);
 
@@ -604,6 +623,16 @@ int target_read_memory(struct target *target,
 		target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer);
 int target_read_phys_memory(struct target *target,
 		target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer);
+/**
+ * Read a list of scattered blocks, as target_read_memory() would one by one.
+ * Targets with a queued transport read them all in a single queue run, which
+ * is much faster for many small reads such as RTOS thread control blocks.
+ *
+ * Blocks that can be read are filled in even if another one fails.
+ * @returns the first error encountered.
+ */
+int target_read_memory_gather(struct target *target,
+		const struct target_memory_gather *items, unsigned int num_items);
 /**
  * Write @a count items of @a size bytes to the memory of @a target at
  * the @a address given. @a address must be aligned to @a size
@@ -659,6 +688,24 @@ int target_checksum_memory(struct target *target,
 int target_blank_check_memory(struct target *target,
 		struct target_memory_check_block *blocks, int num_blocks,
 		uint8_t erased_value);
+/**
+ * Compute both the CRC (as target_checksum_memory()) and the erase state of
+ * an array of regions in as few algorithm runs as possible.
+ *
+ * @returns the number of blocks surveyed, which may be less than
+ * @a num_blocks if working area is short, or an error code.
+ * ERROR_NOT_IMPLEMENTED if the target has no survey algorithm.
+ */
+int target_survey_memory(struct target *target,
+		struct target_memory_survey_block *blocks, int num_blocks,
+		uint8_t erased_value);
+/**
+ * Search @a size bytes of target memory starting at @a address for the
+ * first occurrence of @a pattern. On success @a found tells whether the
+ * pattern was present and @a match holds the address of the first byte.
+ */
+int target_search_memory(struct target *target, target_addr_t address, uint32_t size,
+		const uint8_t *pattern, uint32_t pattern_len, bool *found, target_addr_t *match);
 int target_wait_state(struct target *target, enum target_state state, unsigned int ms);
 
 /**
@@ -117,6 +117,13 @@ struct target_type {
 	 */
 	int (*read_memory)(struct target *target, target_addr_t address,
 			uint32_t size, uint32_t count, uint8_t *buffer);
+	/**
+	 * Scattered memory read callback. Optional, the default reads the
+	 * items one by one with read_memory. Do @b not call this function
+	 * directly, use target_read_memory_gather() instead.
+	 */
+	int (*read_memory_gather)(struct target *target,
+			const struct target_memory_gather *items, unsigned int num_items);
 	/**
 	 * Target memory write callback.  Do @b not call this function
 	 * directly, use target_write_memory() instead.
@@ -137,6 +144,9 @@ struct target_type {
 	int (*blank_check_memory)(struct target *target,
 			struct target_memory_check_block *blocks, int num_blocks,
 			uint8_t erased_value);
+	int (*survey_memory)(struct target *target,
+			struct target_memory_survey_block *blocks, int num_blocks,
+			uint8_t erased_value);
 
 	/*
 	 * target break-/watchpoint control
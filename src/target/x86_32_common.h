@@ -231,6 +231,11 @@ struct x86_32_common {
 	int (*read_hw_reg)(struct target *t, int reg, uint32_t *regval, uint8_t cache);
 	int (*write_hw_reg)(struct target *t, int reg,
 				uint32_t regval, uint8_t cache);
+	/* optional, access count elements with a single queue of scans */
+	int (*read_mem_block)(struct target *t, uint32_t size,
+				uint32_t addr, uint32_t count, uint8_t *buf);
+	int (*write_mem_block)(struct target *t, uint32_t size,
+				uint32_t addr, uint32_t count, const uint8_t *buf);
 
 	/* register cache to processor synchronization */
 	int (*read_hw_reg_to_cache)(struct target *target, int num);